@@ -34,6 +34,8 @@ public:
 
   FiltrationMode filtration_mode = FiltrationMode::LowerStar;
   bool apply_filtration_mode = false;
+  // stencil of the gradient volume, fixed at startup since it names the gradient caches
+  GradientOperator gradient_operator = GradientOperator::Central;
 
   bool apply_highlight_update = false;
   PersistencePair selected_pair; 
@@ -43,6 +45,23 @@ public:
   float max_gradient = 0.0f;
   float density_threshold = 0.0f;
 
+  // rendering restricted to one merge tree branch and the branches merging into it, -1 = whole volume
+  int segmented_branch = -1;
+  bool apply_segmented_branch = false;
+
+  // time series playback, series_steps stays 0 without a series
+  int series_steps = 0;
+  int series_step = 0;
+  bool apply_series_step = false;
+  bool series_playing = false;
+  float series_fps = 30.0f;
+  int series_ready = 0; // decoded steps in the ring
+
+  // progressive loading, the ray marcher only samples the loaded slices
+  uint32_t loaded_slices = ~0u;
+  float load_progress = 1.0f;
+  bool persistence_pending = false;
+
   static constexpr uint32_t TF2D_BINS = 256;
 
   vk::Extent2D get_render_extent() const { return render_extent; }
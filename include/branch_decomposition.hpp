@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "merge_tree.hpp"
+
+// a branch runs from a leaf up to the saddle where it merges into an older branch, at every
+// node the child whose leaf lies farthest from the node value continues (elder rule)
+struct Branch
+{
+    uint32_t leaf;
+    uint32_t saddle; // NO_NODE for the branch that reaches the root
+    uint32_t parent; // branch it merges into, NO_NODE for the root branch
+    uint32_t birth; // value of the leaf
+    uint32_t death; // value of the saddle, or of the root
+};
+
+// node values are MergeTree::birth; the LCA index is a sparse table over the depth first order,
+// O(n log n) to build and O(1) per query
+class BranchDecomposition
+{
+public:
+    BranchDecomposition() = default;
+    explicit BranchDecomposition(const MergeTree& tree);
+
+    const std::vector<Branch>& get_branches() const { return branches; }
+    uint32_t branch_of(uint32_t node) const { return node_branch[node]; }
+
+    // lowest common ancestor, NO_NODE if the nodes lie in different trees of the forest
+    uint32_t lca(uint32_t a, uint32_t b) const;
+
+    // node where the components of two branches merge, NO_NODE if they never do
+    uint32_t merge_node(uint32_t branch_a, uint32_t branch_b) const;
+
+    // branch closest to a persistence pair in birth and death (max norm), NO_NODE without branches
+    uint32_t find_branch(const PersistencePair& pair) const;
+
+private:
+    std::vector<Branch> branches;
+    std::vector<uint32_t> node_branch;
+    std::vector<uint32_t> tree_root;
+    std::vector<uint32_t> depth;
+    std::vector<uint32_t> order_index; // position of every node in the depth first order
+    // level k holds for every position i the shallowest parent of the nodes at i .. i + 2^k - 1
+    std::vector<std::vector<uint32_t>> sparse;
+    std::vector<uint32_t> branch_lookup; // branches sorted by birth and death
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+#include "glm/vec3.hpp"
+#include "branch_decomposition.hpp"
+#include "join_tree.hpp"
+#include "volume.hpp"
+
+// voxels of one branch: count, inclusive bounding box and value range
+struct BranchRegion
+{
+    uint64_t voxel_count = 0;
+    glm::uvec3 min{std::numeric_limits<uint32_t>::max()};
+    glm::uvec3 max{0};
+    uint8_t min_value = 255;
+    uint8_t max_value = 0;
+};
+
+// branch label per voxel, 16 bit while the branch ids fit
+struct BranchSegmentation
+{
+    glm::uvec3 resolution{0};
+    std::vector<uint16_t> labels16;
+    std::vector<uint32_t> labels32;
+    std::vector<BranchRegion> regions; // indexed by branch id
+
+    bool empty() const { return regions.empty(); }
+    uint32_t label(size_t voxel) const { return labels32.empty() ? labels16[voxel] : labels32[voxel]; }
+};
+
+// a voxel belongs to the branch of the arc it lies on; one parallel pass over the volume writes the
+// labels and gathers the regions
+BranchSegmentation segment_branches(const Volume& volume, const AugmentedMergeTree& tree, const BranchDecomposition& branches);
+
+// 1 for the voxels of the selected branches and of every branch merging into them, i.e. the whole
+// component a selected feature spans just before it dies
+std::vector<uint8_t> branch_mask(const BranchSegmentation& segmentation, const BranchDecomposition& branches, std::span<const uint32_t> selected);
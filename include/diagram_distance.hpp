@@ -0,0 +1,32 @@
+#pragma once
+
+#include <limits>
+
+#include "persistence_diagram.hpp"
+
+// distances between two persistence diagrams with the L-infinity ground metric, every point may also be
+// matched to its projection onto the diagonal at cost |death - birth| / 2
+// both work on the distinct points of the aggregated diagrams and their multiplicities, points on the
+// diagonal are ignored since they never change the distance
+
+// exact bottleneck distance, all candidate values are multiples of 0.5, every candidate of the binary
+// search is checked with a layered (Hopcroft-Karp style) flow whose edges are found with a kd-tree
+double bottleneck_distance(const PersistenceDiagram& a, const PersistenceDiagram& b);
+
+// count copies of point a matched to point b, DIAGONAL_POINT stands for the diagonal projection
+constexpr uint32_t DIAGONAL_POINT = std::numeric_limits<uint32_t>::max();
+struct DiagramMatch
+{
+    uint32_t a;
+    uint32_t b;
+    uint32_t count;
+};
+
+// an optimal bottleneck matching, sorted by a then b, the bottleneck distance is stored in distance
+std::vector<DiagramMatch> bottleneck_matching(const PersistenceDiagram& a, const PersistenceDiagram& b, double& distance);
+
+// q-Wasserstein distance (sum of matched distances^q)^(1/q), computed as a transportation problem with
+// an epsilon-scaled auction (epsilon relaxation) where all diagonal projections of one side are a single
+// node; stops as soon as the primal cost is within relative_error of the dual bound
+// returns -1 for q < 1
+double wasserstein_distance(const PersistenceDiagram& a, const PersistenceDiagram& b, double q = 2.0, double relative_error = 0.01);
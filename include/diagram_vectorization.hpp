@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "persistence_diagram.hpp"
+
+// fixed size vectors of a persistence diagram for downstream learning
+// every point is the interval [min(birth, death), max(birth, death)) weighted by its multiplicity,
+// so lower and upper star diagrams are handled the same way
+struct VectorizationSettings
+{
+    float max_value = 255.0f; // all summaries cover the filtration values [0, max_value]
+    uint32_t betti_levels = 256; // evenly spaced samples, one per value for uint8 volumes
+    uint32_t landscape_count = 5; // lambda_1 .. lambda_k
+    uint32_t landscape_samples = 256;
+    uint32_t image_resolution = 32; // pixels per axis, birth along x and persistence along y
+    float image_sigma = 4.0f; // gaussian standard deviation in filtration units
+};
+
+struct DiagramFeatures
+{
+    std::vector<float> betti; // betti_levels
+    std::vector<float> landscapes; // landscape_count rows of landscape_samples
+    std::vector<float> image; // image_resolution rows of image_resolution, row 0 is persistence 0
+};
+
+// number of intervals alive at every level, difference array and prefix sum
+std::vector<float> betti_curve(const PersistenceDiagram& diagram, std::span<const uint32_t> points, const VectorizationSettings& settings);
+// the k largest tent functions min(t - birth, death - t) at every sample, parallel over the samples
+std::vector<float> persistence_landscapes(const PersistenceDiagram& diagram, std::span<const uint32_t> points, const VectorizationSettings& settings);
+// gaussians over (birth, persistence) weighted linearly by persistence, parallel over the image rows
+std::vector<float> persistence_image(const PersistenceDiagram& diagram, std::span<const uint32_t> points, const VectorizationSettings& settings);
+
+// all three summaries of the given points, or of the whole diagram
+DiagramFeatures vectorize_diagram(const PersistenceDiagram& diagram, std::span<const uint32_t> points, const VectorizationSettings& settings);
+DiagramFeatures vectorize_diagram(const PersistenceDiagram& diagram, const VectorizationSettings& settings);
+
+// little endian batch file: "PDVF", uint32 version, uint32 count, uint32 betti_levels, landscape_count,
+// landscape_samples, image_resolution, float max_value, image_sigma, then for every diagram the betti
+// curve, the landscapes and the image as float32
+[[nodiscard]] int write_features(const std::string& path, const std::vector<DiagramFeatures>& batch, const VectorizationSettings& settings);
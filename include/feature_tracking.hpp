@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "persistence_diagram.hpp"
+#include "volume.hpp"
+
+constexpr uint32_t NO_TRACK = std::numeric_limits<uint32_t>::max();
+
+struct TrackingSettings
+{
+    FiltrationMode mode = FiltrationMode::LowerStar;
+    uint32_t workers = 2; // timesteps loaded and reduced concurrently
+    uint32_t max_in_flight = 4; // reduced diagrams waiting for the matching, bounds the memory
+    double max_distance = std::numeric_limits<double>::infinity(); // matches further apart end a track and start a new one
+    uint32_t min_persistence = 1; // points closer to the diagonal are not tracked
+};
+
+// a track only stores a step when its point or the number of features following it changes
+struct TrackStep
+{
+    uint32_t timestep;
+    PersistencePair point;
+    uint32_t count;
+};
+
+struct FeatureTrack
+{
+    uint32_t id;
+    uint32_t parent = NO_TRACK; // the track this one split off from
+    uint32_t last_timestep; // inclusive
+    std::vector<TrackStep> steps;
+};
+
+// matches every diagram against its predecessor and extends the tracks
+// identical points keep their tracks without any matching, only the remaining (changed) pairs go
+// through a bottleneck matching, so a step costs a linear merge plus the matching of the changes
+class FeatureTracker
+{
+public:
+    explicit FeatureTracker(double max_distance = std::numeric_limits<double>::infinity()) : max_distance(max_distance) {}
+
+    void add(PersistenceDiagram diagram);
+
+    const std::vector<FeatureTrack>& get_tracks() const { return tracks; }
+    uint32_t get_timesteps() const { return timesteps; }
+    // per transition: bottleneck distance of the changed pairs and their number
+    const std::vector<double>& get_step_distances() const { return step_distances; }
+    const std::vector<uint64_t>& get_changed_pairs() const { return changed_pairs; }
+
+private:
+    struct Active
+    {
+        uint32_t track;
+        uint32_t point;
+        uint32_t count;
+    };
+
+    double max_distance;
+    uint32_t timesteps = 0;
+    PersistenceDiagram previous;
+    std::vector<Active> active; // tracks alive at the last timestep, sorted by point
+    std::vector<FeatureTrack> tracks;
+    std::vector<double> step_distances;
+    std::vector<uint64_t> changed_pairs;
+
+    uint32_t start_track(uint32_t parent, uint32_t point, uint32_t count, const PersistenceDiagram& diagram);
+};
+
+// loads and reduces the volumes with a pool of workers while the diagrams are matched in order
+[[nodiscard]] int track_features(const std::vector<std::string>& files, const TrackingSettings& settings, FeatureTracker& tracker);
+
+// one row per track step: track, parent, timestep, birth, death, count, last timestep of the track
+[[nodiscard]] int write_tracks_csv(const std::string& path, const FeatureTracker& tracker);
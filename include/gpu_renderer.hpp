@@ -5,6 +5,15 @@
 
 std::vector<PersistencePair> calculate_persistence_pairs(const Volume& volume, std::vector<int>& filtration_values, FiltrationMode mode = FiltrationMode::LowerStar);
 
-int gpu_render(const Volume& volume);
+class VolumeSeries;
+class ProgressiveVolumeLoader;
+
+// with a series the persistence comes from volume and the renderer plays the series back. with a loader
+// volume is still being filled, slices are shown as they arrive and persistence follows the last one.
+// gradient_operator is the stencil of every gradient volume the renderer computes
+int gpu_render(const Volume& volume, VolumeSeries* series = nullptr, ProgressiveVolumeLoader* loader = nullptr, GradientOperator gradient_operator = GradientOperator::Central);
+
+// path prefix of every cache file belonging to the volume, e.g. "cache/tooth_103x94x161"
+std::string volume_cache_prefix(const Volume& volume);
 
 Volume create_test_volume_gradient();
\ No newline at end of file
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "merge_tree.hpp"
+#include "volume.hpp"
+
+// join tree: components of the sublevel sets, the leaves are minima (lower star filtration)
+// split tree: components of the superlevel sets, the leaves are maxima (upper star filtration)
+enum class MergeTreeType
+{
+    Join,
+    Split
+};
+
+inline MergeTreeType merge_tree_type(FiltrationMode mode)
+{
+    return mode == FiltrationMode::LowerStar ? MergeTreeType::Join : MergeTreeType::Split;
+}
+
+// augmented merge tree of a volume with 6-connectivity, equal values are ordered by voxel index
+struct AugmentedMergeTree
+{
+    MergeTreeType type = MergeTreeType::Join;
+    // critical nodes in sweep order: leaves, saddles and the root at the last voxel of the sweep
+    std::vector<uint32_t> node_voxel;
+    std::vector<uint8_t> node_value;
+    std::vector<uint32_t> node_parent; // NO_NODE for the root
+    // for every voxel the node at the lower end of the arc it lies on
+    std::vector<uint32_t> voxel_arc;
+
+    size_t size() const { return node_voxel.size(); }
+};
+
+// union-find sweep of the voxels in value order, O(n) counting sorts plus near linear union-find
+// the z slabs are swept in parallel, only the slab boundaries and the local critical points take part
+// in the sequential sweep that glues the slabs; slabs = 0 uses one slab per thread. other layouts than
+// Linear are converted first
+AugmentedMergeTree compute_merge_tree(const Volume& volume, MergeTreeType type, uint32_t slabs = 0);
+
+inline AugmentedMergeTree compute_join_tree(const Volume& volume) { return compute_merge_tree(volume, MergeTreeType::Join); }
+inline AugmentedMergeTree compute_split_tree(const Volume& volume) { return compute_merge_tree(volume, MergeTreeType::Split); }
+
+// node i becomes MergeTree node i with birth = its value and death = the value of its parent, the
+// root spans its own value only
+MergeTree to_merge_tree(const AugmentedMergeTree& tree);
+
+// cache key of compute_merge_tree, a hash of the resolution, the tree type and the voxels
+uint64_t augmented_merge_tree_key(const Volume& volume, MergeTreeType type);
+
+// flat binary cache of the node arrays and the arc labels; load checks every id against the node and voxel
+// counts, a file with another key fails
+[[nodiscard]] int save_augmented_merge_tree(const AugmentedMergeTree& tree, const std::string& path, uint64_t key);
+[[nodiscard]] int load_augmented_merge_tree(const std::string& path, AugmentedMergeTree& tree, uint64_t key);
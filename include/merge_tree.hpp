@@ -1,57 +1,91 @@
 #pragma once
 #include <vector>
-#include <unordered_map>
 #include <cstdint>
+#include <limits>
+#include <span>
+#include <string>
 #include "persistence.hpp"
 
-struct MergeTreeNode 
-{
-    uint32_t id;
-    uint32_t birth;
-    uint32_t death;
-    int depth;
-    MergeTreeNode* parent;
-    std::vector<MergeTreeNode*> children;
-
-    MergeTreeNode(uint32_t id, uint32_t birth, uint32_t death) : id(id), birth(birth), death(death), depth(0), parent(nullptr) {}
-};
+constexpr uint32_t NO_NODE = std::numeric_limits<uint32_t>::max();
 
-class MergeTree 
+// nodes are dense ids in creation order, every per node attribute is one contiguous array
+// the children of a node form a singly linked list through first_child and next_sibling
+class MergeTree
 {
 public:
-    MergeTree();
-    ~MergeTree();
+    MergeTree() = default;
+
+    void reserve(size_t count);
+
+    // returns the id of the new node, ids are assigned in order starting at 0
+    uint32_t add_node(uint32_t birth, uint32_t death);
 
-    void add_node(uint32_t id, uint32_t birth, uint32_t death);
+    // representative of the component of id, iterative with path compression
+    // the union-find links are kept apart from the tree edges, finds never reshape the tree
+    uint32_t find(uint32_t id);
 
-    // standard find with path compression
-    MergeTreeNode* find(uint32_t id);
-    
-    // standard union (which flattens the tree)
+    // attaches the representative with the larger birth below the other one
     void union_nodes(uint32_t id1, uint32_t id2);
 
-    // attaches death node directly to birth node without path compression
+    // attaches death node directly to birth node, moving it away from a previous parent
     void chain_union(uint32_t birth_id, uint32_t death_id);
 
-    MergeTreeNode* get_root() const;
+    // NO_NODE for an empty tree
+    uint32_t get_root() const { return root; }
 
-    const std::unordered_map<uint32_t, MergeTreeNode*>& get_all_nodes() const;
+    // overrides the smallest birth root, e.g. for split trees
+    void set_root(uint32_t id);
 
-    std::vector<uint32_t> find_nodes_by_depth(int targetDepth) const;
+    size_t size() const { return birth_.size(); }
+    bool empty() const { return birth_.empty(); }
+    uint32_t parent(uint32_t id) const { return parent_[id]; }
+    uint32_t first_child(uint32_t id) const { return first_child_[id]; }
+    uint32_t next_sibling(uint32_t id) const { return next_sibling_[id]; }
+    uint32_t birth(uint32_t id) const { return birth_[id]; }
+    uint32_t death(uint32_t id) const { return death_[id]; }
+    uint32_t persistence(uint32_t id) const { return birth_[id] > death_[id] ? birth_[id] - death_[id] : death_[id] - birth_[id]; }
 
-    void set_target_level(int level);
-    void set_persistence_threshold(int threshold);
+    // levels and persistence cuts, valid after build_index (the builders call it once the tree is final)
+    void build_index();
+    // distance to the root of the node's tree
+    int depth(uint32_t id) const { return depth_[id]; }
+    int get_max_level() const { return int(level_start.size()) - 2; }
+    uint32_t get_max_persistence() const { return persistence_cuts.empty() ? 0 : uint32_t(persistence_cuts.size()) - 2; }
 
-    MergeTree(MergeTree&& other) noexcept;
-    MergeTree& operator=(MergeTree&& other) noexcept;
+    // nodes on a level with at least min_persistence, by decreasing persistence, O(log n) plus the output
+    std::span<const uint32_t> nodes_at_level(int level, uint32_t min_persistence = 0) const;
+    // nodes on all levels with at least min_persistence, by decreasing persistence, O(1) plus the output
+    std::span<const uint32_t> nodes_with_persistence(uint32_t min_persistence) const;
+
+    // every array in one flat binary file, key identifies the input the tree was built from
+    [[nodiscard]] int save(const std::string& path, uint64_t key) const;
+    // reads the arrays straight into the tree and checks every node id, the index comes with them; a file
+    // with another key fails
+    [[nodiscard]] int load(const std::string& path, uint64_t key);
 
 private:
-    std::unordered_map<uint32_t, MergeTreeNode*> nodes;
-    MergeTreeNode* root;
-    int target_level = 0;
-    int persistence_threshold = 0;
+    std::vector<uint32_t> parent_;
+    std::vector<uint32_t> first_child_;
+    std::vector<uint32_t> next_sibling_;
+    std::vector<uint32_t> birth_;
+    std::vector<uint32_t> death_;
+    std::vector<int> depth_;
+    std::vector<uint32_t> representative;
+    uint32_t root = NO_NODE;
+
+    // nodes grouped by level, every level sorted by decreasing persistence; persistence_cuts[p] is the
+    // number of nodes with persistence >= p in persistence_order, values are 8 bit so it stays small
+    std::vector<uint32_t> level_start;
+    std::vector<uint32_t> level_nodes;
+    std::vector<uint32_t> persistence_order;
+    std::vector<uint32_t> persistence_cuts;
 
-    void update_visualization();
+    void link(uint32_t parent, uint32_t child);
 };
 
+// chains the pairs in birth order, a pair joins the component whose last death is closest within tol
+// O(n log n) in the number of pairs
 MergeTree build_merge_tree_with_tolerance(const std::vector<PersistencePair>& persistence_pairs, uint32_t tol);
+
+// cache key of build_merge_tree_with_tolerance, a hash of the pairs and the tolerance
+uint64_t merge_tree_key(const std::vector<PersistencePair>& persistence_pairs, uint32_t tol);
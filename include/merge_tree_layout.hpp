@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "branch_decomposition.hpp"
+
+// branch layout of a merge tree: a branch is a vertical segment from its birth to its death value in
+// its own column, joined to the branch it merges into at the death value. the children of a branch
+// alternate left and right of it by decreasing persistence, so every subtree covers one contiguous
+// column range and the most persistent features sit next to their parents
+struct MergeTreeLayout
+{
+    std::vector<uint32_t> column; // per branch
+    std::vector<uint32_t> range_begin; // first column of the branch's subtree
+    std::vector<uint32_t> range_end; // one past the last column of the branch's subtree
+    // children of branch b are children[child_start[b] .. child_start[b + 1]), by decreasing persistence
+    std::vector<uint32_t> child_start;
+    std::vector<uint32_t> children;
+    std::vector<uint32_t> roots; // branches that never merge, left to right
+    uint32_t columns = 0;
+
+    bool empty() const { return column.empty(); }
+};
+
+// O(n log n) in the number of branches, the sort of the siblings dominates
+MergeTreeLayout layout_merge_tree(const BranchDecomposition& branches);
@@ -8,6 +8,15 @@
 
 struct Volume;
 
+enum class ReductionEngine
+{
+    Standard, // unsorted columns, additions by find/erase followed by a sort
+    SortedMerge, // sorted columns, additions by a linear symmetric difference
+    Heap // lazy additions into a max-heap, the pivot is popped from the heap
+};
+
+const char* reduction_engine_name(ReductionEngine engine);
+
 struct PersistencePair 
 {
     uint32_t birth = 0;
@@ -30,15 +39,24 @@ public:
     uint32_t get_num_cols() const;
     std::vector<uint32_t> get_col(uint32_t col_idx) const;
 
-    std::vector<PersistencePair> reduce();
+    // all engines reduce left to right and therefore return the same pairs in the same order
+    std::vector<PersistencePair> reduce(ReductionEngine engine = ReductionEngine::Standard);
+
+    // number of column additions performed by the last call to reduce
+    uint64_t get_column_additions() const;
 
 private:
     uint32_t num_cols_;
     std::vector<std::vector<uint32_t>> matrix_;
     std::vector<uint32_t> dims_;
+    uint64_t column_additions_ = 0;
 
     void add_to(uint32_t source_col, uint32_t target_col);
+    void add_to_sorted(uint32_t source_col, uint32_t target_col, std::vector<uint32_t>& scratch);
     void finalize(uint32_t col_idx);
+    std::vector<PersistencePair> reduce_standard();
+    std::vector<PersistencePair> reduce_sorted_merge();
+    std::vector<PersistencePair> reduce_heap();
 };
 
 std::pair<BoundaryMatrix, std::vector<int>> create_boundary_matrix(const Volume& volume, FiltrationMode mode = FiltrationMode::LowerStar);
\ No newline at end of file
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <span>
+#include <memory>
+
+#include "persistence.hpp"
+
+// persistence diagram in display values where every distinct (birth, death) point is stored once
+// with uint8 volumes there are at most 256 * 256 points, independent of the number of pairs
+struct AggregatedDiagram
+{
+    std::vector<PersistencePair> points; // sorted by birth, then death
+    std::vector<uint32_t> multiplicity; // number of pairs per point, parallel to points
+    size_t total_pairs = 0;
+
+    size_t size() const { return points.size(); }
+    bool empty() const { return points.empty(); }
+};
+
+// map raw (index) pairs through the filtration values and collapse identical points
+AggregatedDiagram aggregate_pairs(const std::vector<PersistencePair>& raw_pairs, const std::vector<int>& filtration_values);
+
+// collapse identical points of pairs that are already in display values
+AggregatedDiagram aggregate_pairs(const std::vector<PersistencePair>& pairs);
+
+// immutable aggregated diagram with a persistence sorted and a birth sorted permutation and a
+// uniform grid over (birth, death), queries return indices into points()
+class PersistenceDiagram
+{
+public:
+    PersistenceDiagram() = default;
+    explicit PersistenceDiagram(AggregatedDiagram diagram);
+    explicit PersistenceDiagram(const std::vector<PersistencePair>& pairs);
+
+    const std::vector<PersistencePair>& points() const { return data.points; }
+    const std::vector<uint32_t>& multiplicity() const { return data.multiplicity; }
+    const PersistencePair& operator[](size_t idx) const { return data.points[idx]; }
+    size_t total_pairs() const { return data.total_pairs; }
+    size_t size() const { return data.points.size(); }
+    bool empty() const { return data.points.empty(); }
+
+    // death - birth, 0 for points below the diagonal
+    static uint32_t persistence(const PersistencePair& p) { return p.death > p.birth ? p.death - p.birth : 0; }
+    uint32_t max_persistence() const;
+    // index of the most persistent point, size() for an empty diagram
+    size_t most_persistent() const;
+
+    // points with persistence >= min_persistence, ascending by persistence, O(log n)
+    std::span<const uint32_t> persistence_at_least(uint32_t min_persistence) const;
+    // points whose euclidean distance to the diagonal is >= min_distance, ascending by persistence, O(log n)
+    std::span<const uint32_t> diagonal_distance_at_least(float min_distance) const;
+    // points with birth in [lo, hi], ascending by birth, O(log n)
+    std::span<const uint32_t> birth_between(uint32_t lo, uint32_t hi) const;
+    // points inside the closed rectangle, ascending by index, O(visited cells + k log k)
+    std::vector<uint32_t> range(uint32_t birth_lo, uint32_t birth_hi, uint32_t death_lo, uint32_t death_hi) const;
+
+private:
+    AggregatedDiagram data;
+    std::vector<uint32_t> by_persistence;
+    std::vector<uint32_t> persistence_keys; // persistence of by_persistence[i], for binary searches
+    std::vector<uint32_t> by_birth;
+    std::vector<uint32_t> birth_keys;
+
+    // grid index in CSR layout, cell (i, j) covers births and deaths starting at origin + (i, j) * cell_size
+    static constexpr uint32_t MAX_GRID_DIM = 64;
+    uint32_t origin_birth = 0;
+    uint32_t origin_death = 0;
+    uint32_t cell_size = 1;
+    uint32_t grid_dim = 0;
+    std::vector<uint32_t> cell_start;
+    std::vector<uint32_t> cell_points;
+
+    void build_index();
+};
+
+// raw pairs of one field together with their filtration values and the display diagram, computed
+// once and shared read-only between all consumers, hand out spans instead of copies
+class PairStore
+{
+public:
+    // takes ownership of the raw pairs and filtration values and aggregates the display diagram
+    static std::shared_ptr<const PairStore> create(std::vector<PersistencePair>&& raw_pairs, std::vector<int>&& filtration_values);
+
+    std::span<const PersistencePair> raw_pairs() const { return raw; }
+    std::span<const int> filtration_values() const { return filtration; }
+    std::span<const PersistencePair> display_pairs() const { return diagram.points(); }
+    const PersistenceDiagram& display_diagram() const { return diagram; }
+
+private:
+    std::vector<PersistencePair> raw;
+    std::vector<int> filtration;
+    PersistenceDiagram diagram;
+};
@@ -30,6 +30,7 @@ private:
     TF_BUFFER = 3,
     UNIFORM_BUFFER = 4,
     GRADIENT_VOLUME_BUFFER = 5,
+    SEGMENT_MASK_BUFFER = 6,
     BUFFER_COUNT
   };
 
@@ -52,6 +53,8 @@ private:
     uint32_t display_mode = 0;
     float max_gradient = 0.0f;
     float density_threshold = 0.0f;
+    uint32_t use_segment_mask = 0;
+    uint32_t loaded_slices = ~0u;
   } pc;
 
   void create_pipeline(const AppState& app_state, glm::uvec3 volume_resolution);
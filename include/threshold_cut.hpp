@@ -5,7 +5,9 @@
 #include <glm/vec4.hpp>
 #include <vector>
 #include "persistence.hpp"
+#include "persistence_diagram.hpp"
 
-std::vector<PersistencePair> threshold_cut(const std::vector<PersistencePair>& pairs, uint32_t threshold);
-std::vector<PersistencePair> diagonal_distance_cut(const std::vector<PersistencePair>& pairs, float minDistance);
-std::vector<PersistencePair> filter_non_degenerate(const std::vector<PersistencePair>& pairs, uint32_t minPersistence = 1); 
\ No newline at end of file
+// all cuts are index queries on the diagram, the result is ascending by persistence
+std::vector<PersistencePair> threshold_cut(const PersistenceDiagram& diagram, uint32_t threshold);
+std::vector<PersistencePair> diagonal_distance_cut(const PersistenceDiagram& diagram, float minDistance);
+std::vector<PersistencePair> filter_non_degenerate(const PersistenceDiagram& diagram, uint32_t minPersistence = 1);
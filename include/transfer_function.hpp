@@ -3,6 +3,8 @@
 #include <vector>
 #include "glm/vec4.hpp"
 #include "persistence.hpp"
+#include "persistence_diagram.hpp"
+#include "branch_segmentation.hpp"
 #include "volume.hpp"
 #include <cmath>
 
@@ -35,5 +37,8 @@ class TransferFunction
 {
 public:
     std::pair<uint32_t, uint32_t> compute_min_max_scalar(const Volume& volume);
-    void update(const std::vector<PersistencePair>& pairs, const Volume& volume, std::vector<glm::vec4>& tf_data);
+    void update(const PersistenceDiagram& diagram, const Volume& volume, std::vector<glm::vec4>& tf_data);
+    // one color per merge tree branch over the values its voxels span (the arcs of the segmentation), or
+    // over birth..death without a segmentation; persistent branches are painted last and most opaque
+    void update(const BranchDecomposition& branches, const BranchSegmentation& segmentation, const Volume& volume, std::vector<glm::vec4>& tf_data);
 };
\ No newline at end of file
@@ -5,10 +5,16 @@
 #include "vk/vulkan_main_context.hpp"
 #include "vk/vulkan_command_context.hpp"
 #include "merge_tree.hpp"
+#include "branch_decomposition.hpp"
+#include "branch_segmentation.hpp"
+#include "merge_tree_layout.hpp"
 #include "transfer_function.hpp"
+#include "persistence_diagram.hpp"
+#include "diagram_vectorization.hpp"
 #include <functional>
 #include "imgui.h"
 #include <vector>
+#include <unordered_map>
 #include "colormaps.hpp"
 
 namespace ve
@@ -57,15 +63,19 @@ public:
   void draw(vk::CommandBuffer& cb, AppState& app_state);
   void set_transfer_function(TransferFunction* transfer_function);
   void set_volume(const Volume* volume);
-  void set_persistence_pairs(const std::vector<PersistencePair>* pairs);
+  void set_persistence_diagram(const PersistenceDiagram* diagram);
   void set_persistence_texture(ImTextureID tex);
   void set_on_pair_selected(const std::function<void(const PersistencePair&)>& callback);
   void set_on_range_applied(std::function<void(const std::vector<PersistencePair>&)> cb);
   void set_on_multi_selected(const std::function<void(const std::vector<PersistencePair>&)>& cb);
   void set_on_brush_selected(const std::function<void(const std::vector<PersistencePair>&, const ImVec4&)>& cb);
-  void set_gradient_persistence_pairs(const std::vector<PersistencePair>* gp);
+  void set_gradient_persistence_diagram(const PersistenceDiagram* diagram);
   void set_merge_tree(MergeTree* mt);
+  void set_branch_decomposition(const BranchDecomposition* branches);
+  void set_branch_segmentation(const BranchSegmentation* segmentation);
   void set_on_merge_mode_changed(const std::function<void(int)>& cb);
+  void set_on_merge_tree_source_changed(const std::function<void(int source, uint32_t tolerance)>& cb);
+  void set_on_tf_source_changed(const std::function<void(int source)>& cb);
   void set_on_brush_selected_gradient(const std::function<void(const std::vector<std::pair<PersistencePair, float>>&, int)>& cb);
   void set_on_highlight_selected(const std::function<void(const std::vector<std::pair<PersistencePair,float>>&,int)>& cb);
   void clear_selection();
@@ -82,9 +92,9 @@ public:
   void set_on_reproject(const std::function<void()>& cb);
   void set_on_persistence_reprojected(const std::function<void(int featureIdx)> &user_cb);
   void set_on_persistence_multi_reprojected(const std::function<void(const std::vector<int>& featureIdxs)> &user_cb);
-  void set_persistence_pairs(const std::vector<PersistencePair>* pairs,std::vector<std::vector<size_t>>&& voxel_indices);
   std::vector<std::pair<int,int>> persistence_bins;
   void set_on_evaluation(const std::function<void(float,float,float,float)>& cb);
+  void set_on_diagram_distance(const std::function<void(float q)>& cb);
   void set_on_tf2d_overlay_mode_changed(OverlayModeChangedFn fn) {
     on_tf2d_overlay_mode_changed = std::move(fn);
   }
@@ -93,10 +103,16 @@ public:
   float last_precision = 0.0f;
   float last_recall = 0.0f;
   bool  last_metrics_valid = false;
+  // distances between the scalar and the gradient diagram
+  float last_bottleneck = 0.0f;
+  float last_wasserstein = 0.0f;
+  float last_distance_ms = 0.0f;
+  bool  last_distance_valid = false;
   bool pd_preview_active = false;
   std::vector<std::pair<int,int>> pd_preview_bins;
   std::vector<ImVec2> persistence_voxels;
   std::function<void(float J_arc, float J_box, float precision, float recall)> on_evaluation;
+  std::function<void(float q)> on_diagram_distance;
   std::vector<ImU32> persistence_bin_colors;
   std::unordered_map<int,std::array<int,2>> primary_clamp_per_point;
   std::unordered_map<int,std::array<int,2>> secondary_clamp_per_point;
@@ -119,11 +135,13 @@ private:
   const VulkanMainContext& vmc;
   vk::DescriptorPool imgui_pool;
   MergeTree* merge_tree = nullptr;
+  const BranchDecomposition* branch_decomposition = nullptr;
+  const BranchSegmentation* branch_segmentation = nullptr;
   TransferFunction* transfer_function = nullptr;
   const Volume* volume = nullptr;
   ImTextureID persistence_texture_ID = (ImTextureID)0;
-  bool cache_dirty = true;
   bool show_dots = true;
+  bool scale_by_multiplicity = true;
   bool range_active = false;
   int max_points_to_show = 0;
   float normalization_factor = 255.0f;
@@ -176,16 +194,20 @@ private:
   float tf2d_rect_opacity = 0.4f; 
   std::vector<std::array<int,4>> feature_boxes;
   std::vector<ImU32> feature_colors;
-  const std::vector<PersistencePair>* persistence_pairs = nullptr;
+  const PersistenceDiagram* persistence_diagram = nullptr;
   std::vector<std::vector<size_t>> persistence_voxel_indices;
-  std::vector<double> xs, ys;
-  std::vector<float > pers;
   std::vector<ImVec2> dot_pos;
   std::vector<int> multi_selected_idxs;
   std::vector<ImU32> multi_selected_cols;
-  const std::vector<PersistencePair>* gradient_pairs = nullptr;
-  std::vector<std::pair<ImVec2,ImVec2>> mt_edges;
-  std::vector<std::pair<ImVec2, uint32_t>> mt_nodes; 
+  const PersistenceDiagram* gradient_diagram = nullptr;
+  // betti curve, landscapes and persistence image of the currently filtered points
+  VectorizationSettings summary_settings;
+  DiagramFeatures summary_features;
+  std::vector<float> summary_image_flipped; // heatmap rows top to bottom
+  std::vector<uint32_t> summary_points;
+  const PersistenceDiagram* summary_diagram = nullptr;
+  bool summary_dirty = true;
+  MergeTreeLayout mt_layout;
   std::vector<std::pair<PersistencePair,float>> last_highlight_hits;
   std::vector<std::vector<int>> brush_clusters;
   std::vector<ImVec4> brush_cluster_colors;
@@ -194,6 +216,8 @@ private:
   std::vector<ImVec4> selected_custom_colors_per_point;
   std::vector<std::pair<int,int>> painted_bins;
   std::function<void(int)> on_merge_mode_changed;
+  std::function<void(int source, uint32_t tolerance)> on_merge_tree_source_changed;
+  std::function<void(int source)> on_tf_source_changed;
   std::function<void(const std::vector<PersistencePair>&)> on_multi_selected;
   std::function<void(const std::vector<PersistencePair>&, const ImVec4&)> on_brush_selected;
   std::function<void(const std::vector<std::pair<PersistencePair, float>>& hits, int ramp)> on_brush_selected_gradient;
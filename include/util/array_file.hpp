@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// flat binary cache files: a header (8 byte magic, 64 bit key, array count) followed by the arrays, each a
+// 64 bit element count and the elements padded to 8 bytes, so every array starts aligned in the file
+constexpr size_t ARRAY_FILE_ALIGNMENT = 8;
+
+class ArrayFileWriter
+{
+public:
+  // writes next to path, finish renames the file into place so a crash never leaves a torn file behind
+  ArrayFileWriter(const std::string& path, const char (&magic)[8], uint64_t key, uint32_t array_count);
+
+  template<class T>
+  void write(const std::vector<T>& array) { write_bytes(array.data(), array.size(), sizeof(T)); }
+
+  [[nodiscard]] int finish();
+
+private:
+  std::string path;
+  std::string tmp_path;
+  std::ofstream out;
+  uint32_t arrays_left;
+
+  void write_bytes(const void* data, uint64_t count, size_t element_size);
+};
+
+class ArrayFileReader
+{
+public:
+  // 0 on success, 1 for a missing or foreign file, 2 for a file written for another key
+  [[nodiscard]] int open(const std::string& path, const char (&magic)[8], uint64_t key, uint32_t array_count);
+
+  // reads the next array straight into array, false if the count does not fit the rest of the file
+  template<class T>
+  [[nodiscard]] bool read(std::vector<T>& array)
+  {
+    uint64_t count = 0;
+    if (!read_count(count, sizeof(T))) return false;
+    array.resize(count);
+    return read_elements(array.data(), count * sizeof(T));
+  }
+
+private:
+  std::ifstream in;
+  uint64_t remaining = 0;
+
+  bool read_count(uint64_t& count, size_t element_size);
+  bool read_elements(void* data, uint64_t bytes);
+};
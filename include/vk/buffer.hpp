@@ -88,9 +88,10 @@ public:
     }
   }
 
-  void update_data_bytes(const void* data, std::size_t byte_count)
+  // writes byte_count bytes at offset, the rest of the buffer is left as is
+  void update_data_bytes(const void* data, std::size_t byte_count, std::size_t offset = 0)
   {
-    VE_ASSERT(byte_count <= byte_size, "Data is larger than buffer!");
+    VE_ASSERT(offset + byte_count <= byte_size, "Data is larger than buffer!");
 
     if (device_local)
     {
@@ -104,7 +105,7 @@ public:
 
       vk::BufferCopy copy_region{};
       copy_region.srcOffset = 0;
-      copy_region.dstOffset = 0;
+      copy_region.dstOffset = offset;
       copy_region.size = byte_count;
       cb.copyBuffer(staging_buffer, buffer, copy_region);
       vcc.submit_transfer(cb, true);
@@ -115,7 +116,7 @@ public:
     {
       void* mapped_mem;
       vmaMapMemory(vmc.va, vmaa, &mapped_mem);
-      memcpy(mapped_mem, data, byte_count);
+      memcpy(static_cast<char*>(mapped_mem) + offset, data, byte_count);
       vmaUnmapMemory(vmc.va, vmaa);
     }
   }
@@ -1,4 +1,7 @@
 #pragma once
+#include <cstdint>
+#include <filesystem>
+#include <memory>
 #include <string>
 #include <vector>
 #include "glm/vec3.hpp"
@@ -10,16 +13,109 @@ enum class FiltrationMode
     UpperStar // use the minimum
 };
 
+enum class VolumeEncoding
+{
+  Raw,
+  Gzip // independent gzip blocks, inflated in parallel on load
+};
+
+enum class VolumeStorage
+{
+  Owned, // read into memory owned by the volume
+  Mapped // private mapping of the raw file
+};
+
+// order of the voxels in Volume::data, see VoxelAddressing in volume_layout.hpp
+enum class VoxelLayout
+{
+  Linear, // x fastest, then y, then z
+  Bricked, // 16^3 bricks, neighbours in z lie 256 bytes apart inside a brick
+  Morton // z-order curve
+};
+
+// stencil of compute_gradient_volume, see volume_gradient.hpp
+enum class GradientOperator
+{
+  Central, // central differences along each axis
+  Sobel, // derivative smoothed with (1, 2, 1) across the other two axes
+  Scharr // derivative smoothed with (3, 10, 3), closer to rotation invariant
+};
+
+// voxel bytes, either owned or borrowed from an external owner such as a file mapping. borrowed bytes
+// are read straight from the page cache and shared with every other process mapping the file; a copy
+// of the data is always owned
+struct VolumeStats;
+
+class VolumeData
+{
+public:
+  VolumeData() = default;
+  VolumeData(const VolumeData& other) : owned(other.begin(), other.end()) { bytes = owned.data(); count = owned.size(); }
+  VolumeData(VolumeData&& other) noexcept { *this = std::move(other); }
+  VolumeData& operator=(const VolumeData& other);
+  VolumeData& operator=(VolumeData&& other) noexcept;
+
+  // borrows size bytes at data, owner keeps them alive
+  void adopt(uint8_t* data, size_t size, std::shared_ptr<void> owner);
+  bool is_borrowed() const { return external != nullptr; }
+
+  // both drop borrowed bytes, resize keeps the leading voxels
+  void resize(size_t size);
+  void assign(size_t size, uint8_t value);
+
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  uint8_t* data() { return bytes; }
+  const uint8_t* data() const { return bytes; }
+  uint8_t& operator[](size_t i) { return bytes[i]; }
+  const uint8_t& operator[](size_t i) const { return bytes[i]; }
+  uint8_t* begin() { return bytes; }
+  uint8_t* end() { return bytes + count; }
+  const uint8_t* begin() const { return bytes; }
+  const uint8_t* end() const { return bytes + count; }
+  const uint8_t* cbegin() const { return bytes; }
+  const uint8_t* cend() const { return bytes + count; }
+
+private:
+  std::vector<uint8_t> owned;
+  std::shared_ptr<void> external;
+  uint8_t* bytes = nullptr;
+  size_t count = 0;
+};
+
 struct Volume
 {
   std::string name;
   glm::uvec3 resolution;
-  std::vector<uint8_t> data;
+  VolumeData data;
+  VoxelLayout layout = VoxelLayout::Linear;
+  // filled by volume_stats, copies share it
+  mutable std::shared_ptr<const VolumeStats> stats;
+};
+
+// the fields of a detached uint8 NRRD header this loader understands
+struct NrrdHeader
+{
+  glm::uvec3 resolution = glm::uvec3(0);
+  uint32_t timesteps = 1; // fourth size of a time series
+  VolumeEncoding encoding = VolumeEncoding::Raw;
+  std::filesystem::path data_file; // relative to the working directory
 };
 
-[[nodiscard]] int load_volume_from_file(const std::string& path, Volume& volume);
-Volume compute_gradient_volume(const Volume& volume);
+[[nodiscard]] int read_nrrd_header(const std::string& header_path, NrrdHeader& header);
+// a mapped volume opens without reading the file, pages are faulted in on first access. any other layout
+// than Linear is copied into owned memory after loading
+[[nodiscard]] int load_volume_from_file(const std::string& path, Volume& volume, VolumeStorage storage = VolumeStorage::Mapped, VoxelLayout layout = VoxelLayout::Linear);
+// the data file is always written in linear order; detached NRRD header plus a data file next to it, <stem>.raw or <stem>.raw.gz
+[[nodiscard]] int save_volume_to_file(const std::string& header_path, const Volume& volume, VolumeEncoding encoding = VolumeEncoding::Gzip);
+// header of a uint8 volume whose data file lies in the header's directory
+[[nodiscard]] int write_nrrd_header(const std::string& header_path, glm::uvec3 resolution, VolumeEncoding encoding, const std::string& data_file);
+// gradient magnitude scaled to 0..255 by its maximum, one-sided differences at the border; keeps the layout
+Volume compute_gradient_volume(const Volume& volume, GradientOperator op = GradientOperator::Central);
 Volume create_simple_volume();
 Volume create_disjoint_components_volume();
 Volume create_tiny_disjoint_volume();
-Volume create_gradient_volume();
\ No newline at end of file
+Volume create_gradient_volume();
+
+// nearest neighbour upsampling by an integer factor along every axis, keeps the layout
+Volume scale_volume(const Volume& volume, uint32_t factor);
@@ -0,0 +1,19 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+// gzip data files of NRRD volumes. the writer emits one independent gzip member per block and keeps the
+// member size in an extra field (like BGZF), so every gzip reader still sees one valid stream while ours
+// finds the members without inflating them and decodes them in parallel
+
+constexpr size_t GZIP_BLOCK_SIZE = size_t(4) << 20;
+
+// appends the members for size bytes at data to out, the blocks are compressed in parallel. returns 1 and
+// leaves out untouched if zlib fails on any block
+[[nodiscard]] int gzip_blocks(const uint8_t* data, size_t size, std::vector<uint8_t>& out, int level = 6, size_t block_size = GZIP_BLOCK_SIZE);
+
+// inflates a gzip or zlib file that holds exactly size bytes into out. files written by gzip_blocks are
+// inflated in parallel, any other stream sequentially in chunks straight into out
+[[nodiscard]] int inflate_file(const std::filesystem::path& path, uint8_t* out, size_t size);
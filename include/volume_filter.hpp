@@ -0,0 +1,35 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include "volume.hpp"
+
+enum class FilterType
+{
+    None,
+    Gaussian,
+    Median, // fixed 3x3x3 neighbourhood
+    Bilateral
+};
+
+struct FilterSettings
+{
+    FilterType type = FilterType::None;
+    uint32_t radius = 1; // kernel size is 2 * radius + 1
+    float sigma = 1.0f; // spatial standard deviation in voxels
+    float range_sigma = 25.0f; // intensity standard deviation, bilateral only
+};
+
+// all filters clamp to the border and keep the resolution of the input volume
+Volume gaussian_filter(const Volume& volume, uint32_t radius, float sigma);
+Volume median_filter(const Volume& volume);
+Volume bilateral_filter(const Volume& volume, uint32_t radius, float sigma, float range_sigma);
+
+// runs the filter selected in settings, returns an unmodified copy for FilterType::None. the single
+// filters expect a linear volume, apply_filter converts other layouts and keeps the layout of the input
+Volume apply_filter(const Volume& volume, const FilterSettings& settings);
+
+// parse "none", "gaussian", "median" or "bilateral"; returns false for unknown names
+bool parse_filter_type(const std::string& name, FilterType& type);
+
+// short identifier of the filter settings, e.g. "gaussian_r2_s1.50"; empty for FilterType::None
+std::string filter_tag(const FilterSettings& settings);
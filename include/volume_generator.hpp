@@ -0,0 +1,43 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include "volume.hpp"
+
+enum class NoiseType
+{
+    None,
+    Gaussian, // independent per voxel
+    Perlin // smooth gradient noise
+};
+
+// all sizes are relative to the smallest volume dimension, so a setting produces
+// the same scene at every resolution
+struct GeneratorSettings
+{
+    glm::uvec3 resolution = glm::uvec3(128);
+    uint8_t background = 32;
+    uint32_t components = 4; // cubes placed at random, disjoint if possible
+    float component_size = 0.15f; // mean half edge length of a component
+    float size_jitter = 0.3f; // relative variation of the component size
+    uint32_t nested_levels = 0; // concentric cubes inside every component, each one brighter
+    uint32_t tori = 0; // rings in the xy-plane with a radial intensity falloff like donut.nhdr
+    float torus_radius = 0.2f; // distance from the torus center to the tube center
+    float tube_radius = 0.06f;
+    NoiseType noise = NoiseType::None;
+    float noise_level = 0.0f; // standard deviation (gaussian) or amplitude (perlin) in intensity units
+    float noise_scale = 8.0f; // perlin lattice cells along the smallest dimension
+    uint32_t seed = 42;
+};
+
+// the scene is derived from the seed only, slices can be generated independently and in any order
+Volume generate_volume(const GeneratorSettings& settings);
+
+// generate the volume in slabs of slab_depth slices and stream them to a detached NRRD header
+// (header_path) plus a .raw or .raw.gz file next to it, memory use is bounded by one slab
+[[nodiscard]] int write_generated_volume(const GeneratorSettings& settings, const std::string& header_path, uint32_t slab_depth = 32, VolumeEncoding encoding = VolumeEncoding::Raw);
+
+// parse "none", "gaussian" or "perlin"; returns false for unknown names
+bool parse_noise_type(const std::string& name, NoiseType& type);
+
+// short identifier of the settings, e.g. "gen_256_c4_n2_t1_perlin8_s42"
+std::string generator_tag(const GeneratorSettings& settings);
@@ -0,0 +1,10 @@
+#pragma once
+#include <string>
+#include "volume.hpp"
+
+// compute_gradient_volume (declared in volume.hpp) runs tiles of x-rows in parallel, reads the voxels
+// through VoxelAddressing and keeps only a few rows of floats per thread
+
+// parse "central", "sobel" or "scharr"; returns false for unknown names
+bool parse_gradient_operator(const std::string& name, GradientOperator& op);
+std::string gradient_operator_name(GradientOperator op);
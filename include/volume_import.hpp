@@ -0,0 +1,11 @@
+#pragma once
+#include <string>
+#include "volume.hpp"
+
+// volumes read through VTK: .vti, .mha/.mhd and directories of DICOM slices. single component uint8
+// scalars are adopted without a copy, the volume shares ownership of the reader's array; any other
+// scalar type is rescaled from its value range into uint8 in one parallel pass
+[[nodiscard]] int import_volume(const std::string& path, Volume& volume);
+
+// true for the extensions above and for directories; paths are tried as given, then below data/volume
+bool is_importable_volume(const std::string& path);
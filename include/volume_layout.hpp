@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "volume.hpp"
+
+// edge length of a brick in VoxelLayout::Bricked
+constexpr uint32_t BRICK_SIZE = 16;
+
+// storage offset of voxel (x, y, z) for any layout. every layout is separable into one offset per axis,
+// so kernels index through three small tables and stay layout-agnostic:
+//   Linear:  x + y * X + z * X * Y
+//   Bricked: brick index * 16^3 + offset inside the brick, both x-fastest; resolution padded to bricks
+//   Morton:  bits of x, y and z interleaved, an axis whose bits run out drops out of the interleaving;
+//            every axis padded to the next power of two
+class VoxelAddressing
+{
+public:
+    VoxelAddressing(VoxelLayout layout, glm::uvec3 resolution);
+    explicit VoxelAddressing(const Volume& volume) : VoxelAddressing(volume.layout, volume.resolution) {}
+
+    size_t operator()(uint32_t x, uint32_t y, uint32_t z) const { return x_offset[x] + y_offset[y] + z_offset[z]; }
+
+    // bytes of the data, padding included; padding voxels are zero
+    size_t storage_size() const { return storage; }
+
+private:
+    std::vector<size_t> x_offset, y_offset, z_offset;
+    size_t storage = 0;
+};
+
+// copy of the volume in another layout
+Volume relayout_volume(const Volume& volume, VoxelLayout layout);
+
+// parse "linear", "bricked" or "morton"; returns false for unknown names
+bool parse_voxel_layout(const std::string& name, VoxelLayout& layout);
+std::string voxel_layout_name(VoxelLayout layout);
@@ -0,0 +1,40 @@
+#pragma once
+#include <atomic>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include "volume.hpp"
+
+// reads a NRRD volume in z-chunks on a background thread into owned memory. the slices below
+// loaded_slices() are final and may be read while the rest is still loading; gzip data is inflated in
+// one piece and completes at once. cancel stops the reads after the current chunk
+class ProgressiveVolumeLoader
+{
+public:
+    ProgressiveVolumeLoader() = default;
+    ProgressiveVolumeLoader(const ProgressiveVolumeLoader&) = delete;
+    ProgressiveVolumeLoader& operator=(const ProgressiveVolumeLoader&) = delete;
+    ~ProgressiveVolumeLoader();
+
+    // parses the header and allocates the volume, the data follows in the background
+    [[nodiscard]] int start(const std::string& header_filename, uint32_t chunk_slices = 16);
+    void cancel() { cancelled.store(true, std::memory_order_release); }
+    void wait();
+
+    // complete once done() returns true, the stats must not be touched before
+    const Volume& get_volume() const { return volume; }
+    uint32_t loaded_slices() const { return loaded.load(std::memory_order_acquire); }
+    float progress() const { return volume.resolution.z ? float(loaded_slices()) / float(volume.resolution.z) : 0.0f; }
+    bool done() const { return volume.resolution.z != 0 && loaded_slices() == volume.resolution.z; }
+    bool failed() const { return error.load(std::memory_order_acquire); }
+
+private:
+    Volume volume;
+    NrrdHeader header;
+    std::thread thread;
+    std::atomic<uint32_t> loaded{0};
+    std::atomic<bool> error{false};
+    std::atomic<bool> cancelled{false};
+
+    void read_chunks(uint32_t chunk_slices);
+};
@@ -0,0 +1,81 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "volume.hpp"
+
+// one decoded timestep, the gradient is computed on the decode thread as well
+struct SeriesStep
+{
+    uint32_t index = 0;
+    Volume volume;
+    Volume gradient;
+};
+
+// time-varying volume played back from a ring of decoded timesteps. every request refills the ring with
+// the requested step and the ones following it (wrapping around at the end), I/O threads read and decode
+// them nearest first while the caller renders, skipping steps that failed to decode. steps handed out
+// stay valid after they left the ring
+class VolumeSeries
+{
+public:
+    VolumeSeries() = default;
+    VolumeSeries(const VolumeSeries&) = delete;
+    VolumeSeries& operator=(const VolumeSeries&) = delete;
+    ~VolumeSeries() { close(); }
+
+    // one header per timestep, or one header whose fourth size counts the timesteps (raw encoding only);
+    // names are relative to data/volume like load_volume_from_file. the gradients use gradient_operator
+    [[nodiscard]] int open(const std::vector<std::string>& header_filenames, uint32_t ring_size = 8, uint32_t io_threads = 2,
+                           GradientOperator gradient_operator = GradientOperator::Central);
+    void close();
+
+    uint32_t size() const { return uint32_t(sources.size()); }
+    glm::uvec3 get_resolution() const { return resolution; }
+    const std::string& get_name() const { return name; }
+
+    // nullptr while step t is still decoding, never blocks
+    std::shared_ptr<const SeriesStep> try_get(uint32_t t);
+    // waits until step t is decoded
+    std::shared_ptr<const SeriesStep> get(uint32_t t);
+    // decoded steps in the ring
+    uint32_t ready_count();
+    // true once step t failed to decode, it is reported once and never requested again
+    bool failed(uint32_t t);
+
+private:
+    struct Source
+    {
+        std::filesystem::path data_file;
+        VolumeEncoding encoding = VolumeEncoding::Raw;
+        size_t offset = 0; // of the step in a 4D data file
+    };
+    struct Slot
+    {
+        int64_t step = -1; // assigned step, -1 for a free slot
+        std::shared_ptr<const SeriesStep> data; // null until decoded
+    };
+
+    std::string name;
+    glm::uvec3 resolution = glm::uvec3(0);
+    GradientOperator gradient_operator = GradientOperator::Central;
+    std::vector<Source> sources;
+    std::vector<Slot> slots;
+    std::deque<uint32_t> queue; // steps to decode, nearest first
+    std::vector<uint32_t> in_flight;
+    std::vector<bool> failed_steps;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable work_available, step_ready;
+    bool stopping = false;
+
+    void request(uint32_t t); // mutex held
+    Slot* find_slot(uint32_t t); // mutex held
+    void decode_loop();
+    [[nodiscard]] int decode(uint32_t t, SeriesStep& step) const;
+};
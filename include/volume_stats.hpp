@@ -0,0 +1,23 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "volume.hpp"
+
+// scalar statistics of a volume, all derived from one histogram pass
+struct VolumeStats
+{
+    uint8_t min = 0;
+    uint8_t max = 0;
+    double mean = 0.0;
+    double variance = 0.0;
+    uint64_t nonzero = 0;
+    std::array<uint64_t, 256> histogram{};
+};
+
+// parallel histogram of size voxels, the other fields follow from the 256 bins. padding zero voxels
+// of bricked or Morton storage are taken out of the counts
+VolumeStats compute_volume_stats(const uint8_t* data, size_t size, size_t padding = 0);
+
+// computed on first use and cached on the volume, reset volume.stats after writing into its data
+const VolumeStats& volume_stats(const Volume& volume);
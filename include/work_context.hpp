@@ -1,8 +1,14 @@
 #pragma once
 
 #include <vector>
+#include <memory>
+#include <string>
 #include "app_state.hpp"
 #include "persistence.hpp"
+#include "persistence_diagram.hpp"
+#include "join_tree.hpp"
+#include "branch_decomposition.hpp"
+#include "branch_segmentation.hpp"
 #include "threshold_cut.hpp"
 #include "ray_marcher.hpp"
 #include "transfer_function.hpp"
@@ -14,6 +20,8 @@
 #include "vk/renderer.hpp"
 #include "vk/synchronization.hpp"
 #include "volume.hpp"
+#include "volume_series.hpp"
+#include "volume_loader.hpp"
 #include "gpu_renderer.hpp"
 #include "util/texture_loader.hpp"
 #include "vk/device_timer.hpp"
@@ -22,18 +30,61 @@
 
 namespace ve {
 
+// what a merge tree is built from, read on the render thread so the build itself can run on any thread
+struct MergeTreeSettings
+{
+  int source = 0; // 0 = volume sweep, 1 = pair tolerance
+  uint32_t tolerance = 5;
+  FiltrationMode filtration_mode = FiltrationMode::LowerStar;
+  std::string cache_prefix; // of the volume the tree is built from
+
+  bool operator==(const MergeTreeSettings&) const = default;
+};
+
+// a merge tree and everything derived from it
+struct MergeTreeBuild
+{
+  MergeTree tree;
+  AugmentedMergeTree augmented; // empty for the pair tolerance tree
+  BranchDecomposition decomposition;
+  BranchSegmentation segmentation; // empty for the pair tolerance tree, it has no voxels
+};
+
+// everything complete_volume swaps in once a progressive load finished, built off the render thread
+struct VolumeCompletion
+{
+  std::shared_ptr<const PairStore> scalar_pairs;
+  std::shared_ptr<const PairStore> gradient_pairs;
+  Volume gradient_volume;
+  std::vector<std::vector<int>> grads_by_scalar;
+  MergeTreeSettings merge_tree_settings;
+  MergeTreeBuild merge_tree;
+};
+
 class WorkContext
 {
 public:
-  WorkContext(const VulkanMainContext& vmc, VulkanCommandContext& vcc, std::vector<PersistencePair> raw_pairs, std::vector<int> raw_filt, std::vector<PersistencePair> raw_grad_pairs, std::vector<int> raw_grad_filt);
-  void construct(AppState& app_state, const Volume& volume);
+  WorkContext(const VulkanMainContext& vmc, VulkanCommandContext& vcc, std::shared_ptr<const PairStore> scalar_pairs, std::shared_ptr<const PairStore> gradient_pairs);
+  // an incomplete volume opens with empty space and empty diagrams until complete_volume
+  void construct(AppState& app_state, const Volume& volume, bool volume_complete = true);
+  // uploads the slices of the loading volume as they arrive
+  void set_volume_loader(const ProgressiveVolumeLoader* loader, AppState& app_state);
+  // settings of the scalar merge tree as the ui has them now
+  MergeTreeSettings merge_tree_settings(int mode) const;
+  // fills the histograms and the merge tree of a completion whose pairs and gradient are set, thread safe
+  static void prepare_completion(const Volume& volume, VolumeCompletion& completion);
+  static MergeTreeBuild build_merge_tree(const Volume& volume, const std::vector<PersistencePair>& pairs, const MergeTreeSettings& settings);
+  // the loader is done and the completion was prepared, only swaps it in
+  void complete_volume(AppState& app_state, VolumeCompletion&& completion);
+  // plays the series back in place of the volume, persistence and histograms stay those of the volume
+  void set_volume_series(VolumeSeries* series, AppState& app_state);
   void destruct();
   void reload_shaders();
   void draw_frame(AppState& app_state);
   vk::Extent2D recreate_swapchain(bool vsync);
-  void set_persistence_pairs(std::vector<PersistencePair> pairs, const Volume& volume);
+  void set_persistence_diagram(std::shared_ptr<const PairStore> pairs, const Volume& volume);
   void load_persistence_diagram_texture(const std::string &filePath);
-  void set_gradient_persistence_pairs(const std::vector<PersistencePair>& pairs);
+  void set_gradient_persistence_diagram(std::shared_ptr<const PairStore> pairs);
   void volume_highlight_persistence_pairs(const std::vector<std::pair<PersistencePair, float>>& pairs, int ramp_index);
   void highlight_diff(const PersistencePair &base, const PersistencePair &mask);
   void highlight_intersection(const PersistencePair &a, const PersistencePair &b);
@@ -56,9 +107,26 @@ private:
   UI ui;
   TransferFunction transfer_function;
   MergeTree merge_tree;
+  AugmentedMergeTree augmented_merge_tree;
+  BranchDecomposition branch_decomposition;
+  BranchSegmentation branch_segmentation; // empty for the pair tolerance tree, it has no voxels
+  std::vector<uint8_t> segment_mask;
+  bool segment_mask_dirty = false;
+  bool segmentation_changed = false;
+  FiltrationMode filtration_mode = FiltrationMode::LowerStar;
+  int merge_tree_source = 0; // 0 = volume sweep, 1 = pair tolerance
+  uint32_t merge_tree_tolerance = 5; // death values this close join one component
+  int tf_source = 0; // 0 = persistence diagram, 1 = merge tree branches
   uint32_t global_max_persistence = 1;
   const Volume* scalar_volume = nullptr;
   Volume gradient_volume;
+  VolumeSeries* volume_series = nullptr;
+  const ProgressiveVolumeLoader* volume_loader = nullptr;
+  uint32_t uploaded_slices = 0;
+  std::shared_ptr<const SeriesStep> series_current; // kept alive while its buffers are on the GPU
+  int series_pending = -1; // step to show as soon as it is decoded
+  bool series_upload = false;
+  Timer<float> series_clock;
   Timer<float> timer;
   using ms = std::milli;
   std::vector<std::pair<int,int>> click_bins;
@@ -70,19 +138,27 @@ private:
   std::vector<std::vector<int>> grads_by_scalar;
   std::unordered_set<uint32_t> brush_seen;
   std::vector<glm::vec4> tf_data;
-  std::vector<PersistencePair> persistence_pairs;
   std::vector<Synchronization> syncs;
   std::vector<DeviceTimer> device_timers;
-  std::vector<PersistencePair> gradient_persistence_pairs;
-  std::vector<PersistencePair> raw_persistence_pairs;
-  std::vector<int> scalar_filtration;
-  std::vector<PersistencePair> raw_gradient_pairs;
-  std::vector<int> gradient_filtration;
+  // shared with gpu_render, the ui only keeps pointers to the display diagrams inside
+  std::shared_ptr<const PairStore> scalar_store;
+  std::shared_ptr<const PairStore> gradient_store;
+  const PersistenceDiagram& scalar_diagram() const { return scalar_store->display_diagram(); }
+  const PersistenceDiagram& gradient_diagram() const { return gradient_store->display_diagram(); }
   std::vector<std::pair<PersistencePair, glm::vec4>> custom_colors;
   void render(uint32_t image_idx, AppState& app_state, uint32_t read_only_image);
   void apply_custom_color_to_volume(const std::vector<PersistencePair>& pairs, const ImVec4& color);
   void reset_custom_colors();
-  void export_persistence_pairs_to_csv(const std::vector<PersistencePair>& scalar_pairs, const std::vector<PersistencePair>& gradient_pairs, const std::string& scalar_filename  = "scalar_pairs.csv", const std::string& gradient_filename = "gradient_pairs.csv") const;
+  void rebuild_merge_tree(int mode);
+  void apply_merge_tree(MergeTreeBuild&& build, int mode);
+  void update_transfer_function(int mode);
+  void highlight_merge_tree_level(int level, uint32_t min_persistence);
+  bool update_segment_mask(int branch);
+  void advance_series(AppState& app_state);
+  void upload_slices(uint32_t end);
+  static std::vector<std::vector<int>> collect_grads_by_scalar(const Volume& volume, const Volume& gradient);
+  void export_volume_data() const;
+  void export_persistence_pairs_to_csv(const PersistenceDiagram& scalar_pairs, const PersistenceDiagram& gradient_pairs, const std::string& scalar_filename  = "scalar_pairs.csv", const std::string& gradient_filename = "gradient_pairs.csv") const;
   std::pair<uint32_t, uint32_t> clamp_and_sort_range(const PersistencePair& p);
 };
 } // namespace ve
@@ -0,0 +1,261 @@
+// benchmarks every reduction engine on the synthetic volumes and the files in data/volume,
+// checks that all engines produce identical diagrams and prints the results as JSON
+#include "volume.hpp"
+#include "persistence.hpp"
+#include "volume_layout.hpp"
+#include "volume_gradient.hpp"
+#include "util/timer.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct Dataset
+{
+    std::string name;
+    Volume volume;
+};
+
+struct EngineResult
+{
+    ReductionEngine engine;
+    double wall_ms = 0.0;
+    uint64_t peak_rss_kb = 0;
+    uint64_t baseline_rss_kb = 0;
+    uint64_t column_additions = 0;
+    size_t num_pairs = 0;
+    bool matches_reference = true;
+};
+
+// read a field like VmHWM or VmRSS (in kB) from /proc/self/status, 0 if unavailable
+uint64_t read_status_kb(const std::string& field)
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.rfind(field + ":", 0) == 0)
+        {
+            std::stringstream ss(line.substr(field.size() + 1));
+            uint64_t kb = 0;
+            ss >> kb;
+            return kb;
+        }
+    }
+    return 0;
+}
+
+// reset the peak resident set size so every engine gets its own high water mark
+void reset_peak_rss()
+{
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    if (clear_refs.is_open()) clear_refs << "5";
+}
+
+std::vector<uint32_t> parse_list(const std::string& arg)
+{
+    std::vector<uint32_t> values;
+    std::stringstream ss(arg);
+    std::string item;
+    while (std::getline(ss, item, ',')) values.push_back(uint32_t(std::stoul(item)));
+    return values;
+}
+
+bool parse_engine(const std::string& name, ReductionEngine& engine)
+{
+    for (ReductionEngine e : {ReductionEngine::Standard, ReductionEngine::SortedMerge, ReductionEngine::Heap})
+    {
+        if (name == reduction_engine_name(e))
+        {
+            engine = e;
+            return true;
+        }
+    }
+    return false;
+}
+
+void print_usage()
+{
+    std::cout << "Usage: AutoTF_PH_benchmark [options]\n"
+              << "  --engines a,b,...   engines to run (standard, sorted_merge, heap), default all\n"
+              << "  --scales 1,2,...    upsampling factors for the synthetic volumes, default 1,2\n"
+              << "  --max-voxels N      skip datasets with more voxels, default 300000\n"
+              << "  --mode lower|upper  filtration mode, default lower\n"
+              << "  --layout NAME       voxel layout (linear, bricked, morton), default linear\n"
+              << "  --no-files          do not benchmark the headers in data/volume\n"
+              << "  --out FILE          write the JSON report to FILE instead of stdout\n";
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<ReductionEngine> engines = {ReductionEngine::Standard, ReductionEngine::SortedMerge, ReductionEngine::Heap};
+    std::vector<uint32_t> scales = {1, 2};
+    size_t max_voxels = 300000;
+    FiltrationMode mode = FiltrationMode::LowerStar;
+    VoxelLayout layout = VoxelLayout::Linear;
+    bool use_files = true;
+    std::string out_path;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--engines" && i + 1 < argc)
+        {
+            engines.clear();
+            std::stringstream ss(argv[++i]);
+            std::string name;
+            while (std::getline(ss, name, ','))
+            {
+                ReductionEngine engine;
+                if (!parse_engine(name, engine))
+                {
+                    std::cerr << "Unknown engine: " << name << std::endl;
+                    return 1;
+                }
+                engines.push_back(engine);
+            }
+        }
+        else if (arg == "--scales" && i + 1 < argc) scales = parse_list(argv[++i]);
+        else if (arg == "--max-voxels" && i + 1 < argc) max_voxels = std::stoull(argv[++i]);
+        else if (arg == "--mode" && i + 1 < argc) mode = std::string(argv[++i]) == "upper" ? FiltrationMode::UpperStar : FiltrationMode::LowerStar;
+        else if (arg == "--layout" && i + 1 < argc)
+        {
+            if (!parse_voxel_layout(argv[++i], layout))
+            {
+                std::cerr << "Unknown layout: " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--no-files") use_files = false;
+        else if (arg == "--out" && i + 1 < argc) out_path = argv[++i];
+        else
+        {
+            print_usage();
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    std::vector<Dataset> datasets;
+    const std::vector<std::pair<std::string, Volume>> synthetic = {
+        {"simple", create_simple_volume()},
+        {"disjoint_components", create_disjoint_components_volume()},
+        {"gradient", create_gradient_volume()}};
+    for (const auto& [name, volume] : synthetic)
+    {
+        for (uint32_t scale : scales)
+        {
+            if (scale == 0) continue;
+            datasets.push_back({name + "_x" + std::to_string(scale), relayout_volume(scale == 1 ? volume : scale_volume(volume, scale), layout)});
+        }
+    }
+    if (use_files && std::filesystem::exists("data/volume"))
+    {
+        // keep stdout machine readable, the loader logs to std::cout
+        std::streambuf* cout_buf = std::cout.rdbuf(std::cerr.rdbuf());
+        for (const auto& entry : std::filesystem::directory_iterator("data/volume"))
+        {
+            if (entry.path().extension() != ".nhdr") continue;
+            Dataset dataset;
+            dataset.name = entry.path().stem().string();
+            if (load_volume_from_file(entry.path().filename().string(), dataset.volume, VolumeStorage::Mapped, layout) != 0)
+            {
+                std::cerr << "Skipping " << entry.path() << ": failed to load" << std::endl;
+                continue;
+            }
+            datasets.push_back(std::move(dataset));
+        }
+        std::cout.rdbuf(cout_buf);
+    }
+
+    std::ostringstream json;
+    json << "{\n  \"filtration\": \"" << (mode == FiltrationMode::LowerStar ? "lower_star" : "upper_star") << "\",\n  \"layout\": \"" << voxel_layout_name(layout) << "\",\n  \"datasets\": [";
+    bool all_agree = true;
+    using ms = std::milli;
+
+    for (size_t d = 0; d < datasets.size(); ++d)
+    {
+        const Dataset& dataset = datasets[d];
+        const glm::uvec3 res = dataset.volume.resolution;
+        json << (d == 0 ? "\n" : ",\n") << "    {\"name\": \"" << dataset.name << "\", \"resolution\": [" << res.x << ", " << res.y << ", " << res.z << "]";
+        const size_t voxels = size_t(res.x) * res.y * res.z;
+        if (voxels > max_voxels)
+        {
+            json << ", \"skipped\": \"more than " << max_voxels << " voxels\"}";
+            std::cerr << "Skipping " << dataset.name << " (" << voxels << " voxels)" << std::endl;
+            continue;
+        }
+
+        Timer<double> timer;
+        json << ", \"gradient_ms\": {";
+        for (GradientOperator op : {GradientOperator::Central, GradientOperator::Sobel, GradientOperator::Scharr})
+        {
+            timer.restart();
+            const Volume gradient = compute_gradient_volume(dataset.volume, op);
+            json << (op == GradientOperator::Central ? "" : ", ") << "\"" << gradient_operator_name(op) << "\": " << timer.restart<ms>();
+        }
+        json << "}";
+
+        timer.restart();
+        auto [boundary_matrix, filtration_values] = create_boundary_matrix(dataset.volume, mode);
+        const double build_ms = timer.restart<ms>();
+        json << ", \"columns\": " << boundary_matrix.get_num_cols() << ", \"boundary_matrix_ms\": " << build_ms << ", \"engines\": [";
+
+        std::vector<PersistencePair> reference;
+        for (size_t e = 0; e < engines.size(); ++e)
+        {
+            // every engine reduces its own copy, the copy is not part of the measurement
+            BoundaryMatrix matrix = boundary_matrix;
+            EngineResult result;
+            result.engine = engines[e];
+            reset_peak_rss();
+            result.baseline_rss_kb = read_status_kb("VmRSS");
+            timer.restart();
+            std::vector<PersistencePair> pairs = matrix.reduce(result.engine);
+            result.wall_ms = timer.restart<ms>();
+            result.peak_rss_kb = read_status_kb("VmHWM");
+            result.column_additions = matrix.get_column_additions();
+            result.num_pairs = pairs.size();
+
+            if (e == 0)
+            {
+                reference = std::move(pairs);
+            }
+            else
+            {
+                result.matches_reference = pairs.size() == reference.size() && std::equal(pairs.begin(), pairs.end(), reference.begin(), [](const PersistencePair& a, const PersistencePair& b)
+                {
+                    return a.birth == b.birth && a.death == b.death;
+                });
+                all_agree = all_agree && result.matches_reference;
+            }
+            std::cerr << dataset.name << " " << reduction_engine_name(result.engine) << ": " << result.wall_ms << " ms" << (result.matches_reference ? "" : " MISMATCH") << std::endl;
+
+            json << (e == 0 ? "\n" : ",\n") << "      {\"engine\": \"" << reduction_engine_name(result.engine) << "\", \"wall_ms\": " << result.wall_ms
+                 << ", \"peak_rss_kb\": " << result.peak_rss_kb << ", \"baseline_rss_kb\": " << result.baseline_rss_kb
+                 << ", \"column_additions\": " << result.column_additions << ", \"pairs\": " << result.num_pairs
+                 << ", \"matches_reference\": " << (result.matches_reference ? "true" : "false") << "}";
+        }
+        json << "\n    ]}";
+    }
+    json << "\n  ],\n  \"reference_engine\": \"" << (engines.empty() ? "" : reduction_engine_name(engines.front())) << "\",\n  \"all_agree\": " << (all_agree ? "true" : "false") << "\n}\n";
+
+    if (out_path.empty())
+    {
+        std::cout << json.str();
+    }
+    else
+    {
+        std::ofstream out(out_path);
+        if (!out.is_open())
+        {
+            std::cerr << "Failed to open " << out_path << " for writing" << std::endl;
+            return 1;
+        }
+        out << json.str();
+    }
+    return all_agree ? 0 : 2;
+}
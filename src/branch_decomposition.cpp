@@ -0,0 +1,146 @@
+#include "branch_decomposition.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <iterator>
+#include <limits>
+
+BranchDecomposition::BranchDecomposition(const MergeTree& tree)
+{
+    const uint32_t n = uint32_t(tree.size());
+    node_branch.assign(n, NO_NODE);
+    tree_root.resize(n);
+    depth.resize(n);
+    order_index.resize(n);
+
+    // iterative depth first order over every tree of the forest
+    std::vector<uint32_t> order, stack;
+    order.reserve(n);
+    for (uint32_t root = 0; root < n; ++root)
+    {
+        if (tree.parent(root) != NO_NODE) continue;
+        depth[root] = 0;
+        stack.push_back(root);
+        while (!stack.empty())
+        {
+            const uint32_t node = stack.back();
+            stack.pop_back();
+            tree_root[node] = root;
+            order_index[node] = uint32_t(order.size());
+            order.push_back(node);
+            for (uint32_t child = tree.first_child(node); child != NO_NODE; child = tree.next_sibling(child))
+            {
+                depth[child] = depth[node] + 1;
+                stack.push_back(child);
+            }
+        }
+    }
+
+    // children come after their parents, so the reversed order sees every subtree before its root
+    std::vector<uint32_t> elder_leaf(n);
+    auto distance = [&](uint32_t leaf, uint32_t node)
+    {
+        const uint32_t a = tree.birth(leaf), b = tree.birth(node);
+        return a > b ? a - b : b - a;
+    };
+    for (uint32_t i = n; i-- > 0;)
+    {
+        const uint32_t node = order[i];
+        uint32_t best = node;
+        for (uint32_t child = tree.first_child(node); child != NO_NODE; child = tree.next_sibling(child))
+        {
+            const uint32_t leaf = elder_leaf[child];
+            if (best == node || distance(leaf, node) > distance(best, node) || (distance(leaf, node) == distance(best, node) && leaf < best)) best = leaf;
+        }
+        elder_leaf[node] = best;
+    }
+
+    // a branch per leaf, its top is the highest node with the leaf as elder leaf
+    for (uint32_t node : order)
+    {
+        const uint32_t leaf = elder_leaf[node];
+        if (node_branch[leaf] == NO_NODE)
+        {
+            const uint32_t saddle = tree.parent(node);
+            node_branch[leaf] = uint32_t(branches.size());
+            branches.push_back({leaf, saddle, saddle == NO_NODE ? NO_NODE : node_branch[elder_leaf[saddle]], tree.birth(leaf), tree.birth(saddle == NO_NODE ? node : saddle)});
+        }
+        node_branch[node] = node_branch[leaf];
+    }
+
+    branch_lookup.resize(branches.size());
+    for (uint32_t b = 0; b < branches.size(); ++b) branch_lookup[b] = b;
+    std::sort(branch_lookup.begin(), branch_lookup.end(), [&](uint32_t x, uint32_t y)
+    {
+        const Branch& a = branches[x];
+        const Branch& b = branches[y];
+        return a.birth != b.birth ? a.birth < b.birth : (a.death != b.death ? a.death < b.death : x < y);
+    });
+
+    // the lca of two nodes is the shallowest parent of the nodes after the first one in the order, up to
+    // and including the second one; position 0 is never queried. the roots of a forest stand in for their
+    // missing parent, a query never spans two trees so no range holds them
+    if (n < 2) return;
+    sparse.emplace_back(n);
+    for (uint32_t i = 1; i < n; ++i) sparse[0][i] = tree.parent(order[i]) == NO_NODE ? order[i] : tree.parent(order[i]);
+    for (uint32_t k = 1; (2u << (k - 1)) < n; ++k)
+    {
+        const std::vector<uint32_t>& prev = sparse[k - 1];
+        std::vector<uint32_t> level(n - (1u << k) + 1);
+        const uint32_t half = 1u << (k - 1);
+        for (uint32_t i = 1; i < level.size(); ++i)
+        {
+            const uint32_t a = prev[i], b = prev[i + half];
+            level[i] = depth[a] <= depth[b] ? a : b;
+        }
+        sparse.push_back(std::move(level));
+    }
+}
+
+uint32_t BranchDecomposition::lca(uint32_t a, uint32_t b) const
+{
+    if (a == b) return a;
+    if (tree_root[a] != tree_root[b]) return NO_NODE;
+    uint32_t l = order_index[a], r = order_index[b];
+    if (l > r) std::swap(l, r);
+    ++l;
+    const uint32_t k = uint32_t(std::bit_width(r - l + 1)) - 1;
+    const uint32_t x = sparse[k][l], y = sparse[k][r + 1 - (1u << k)];
+    return depth[x] <= depth[y] ? x : y;
+}
+
+uint32_t BranchDecomposition::merge_node(uint32_t branch_a, uint32_t branch_b) const
+{
+    if (branch_a >= branches.size() || branch_b >= branches.size()) return NO_NODE;
+    return lca(branches[branch_a].leaf, branches[branch_b].leaf);
+}
+
+uint32_t BranchDecomposition::find_branch(const PersistencePair& pair) const
+{
+    auto distance = [&](uint32_t b)
+    {
+        const Branch& branch = branches[b];
+        const uint32_t db = branch.birth > pair.birth ? branch.birth - pair.birth : pair.birth - branch.birth;
+        const uint32_t dd = branch.death > pair.death ? branch.death - pair.death : pair.death - branch.death;
+        return std::max(db, dd);
+    };
+    auto it = std::lower_bound(branch_lookup.begin(), branch_lookup.end(), pair, [&](uint32_t b, const PersistencePair& p)
+    {
+        return branches[b].birth != p.birth ? branches[b].birth < p.birth : branches[b].death < p.death;
+    });
+
+    // walk outwards in birth order until the birth alone is farther away than the best match
+    uint32_t best = NO_NODE, best_distance = std::numeric_limits<uint32_t>::max();
+    auto consider = [&](uint32_t b)
+    {
+        const uint32_t d = distance(b);
+        if (d < best_distance || (d == best_distance && b < best))
+        {
+            best = b;
+            best_distance = d;
+        }
+    };
+    for (auto right = it; right != branch_lookup.end() && branches[*right].birth - pair.birth <= best_distance; ++right) consider(*right);
+    for (auto left = it; left != branch_lookup.begin() && pair.birth - branches[*std::prev(left)].birth <= best_distance; --left) consider(*std::prev(left));
+    return best;
+}
@@ -0,0 +1,92 @@
+#include "branch_segmentation.hpp"
+#include "volume_layout.hpp"
+
+#include <algorithm>
+
+#include "glm/common.hpp"
+
+BranchSegmentation segment_branches(const Volume& volume, const AugmentedMergeTree& tree, const BranchDecomposition& branches)
+{
+    // labels follow the linear voxel ids of the tree
+    if (volume.layout != VoxelLayout::Linear) return segment_branches(relayout_volume(volume, VoxelLayout::Linear), tree, branches);
+    BranchSegmentation segmentation;
+    const size_t n = volume.data.size();
+    const uint32_t branch_count = uint32_t(branches.get_branches().size());
+    if (tree.voxel_arc.size() != n || branch_count == 0) return segmentation;
+
+    const uint32_t X = volume.resolution.x, Y = volume.resolution.y, Z = volume.resolution.z;
+    const size_t slice = size_t(X) * Y;
+    const bool narrow = branch_count <= std::numeric_limits<uint16_t>::max();
+    segmentation.resolution = volume.resolution;
+    if (narrow) segmentation.labels16.resize(n);
+    else segmentation.labels32.resize(n);
+    segmentation.regions.resize(branch_count);
+
+    #pragma omp parallel
+    {
+        std::vector<BranchRegion> local(branch_count);
+        #pragma omp for schedule(static)
+        for (int z = 0; z < int(Z); ++z)
+        {
+            for (uint32_t y = 0; y < Y; ++y)
+            {
+                const size_t row = z * slice + size_t(y) * X;
+                for (uint32_t x = 0; x < X; ++x)
+                {
+                    const size_t v = row + x;
+                    const uint32_t branch = branches.branch_of(tree.voxel_arc[v]);
+                    if (narrow) segmentation.labels16[v] = uint16_t(branch);
+                    else segmentation.labels32[v] = branch;
+
+                    BranchRegion& region = local[branch];
+                    region.voxel_count++;
+                    region.min = glm::min(region.min, glm::uvec3(x, y, z));
+                    region.max = glm::max(region.max, glm::uvec3(x, y, z));
+                    region.min_value = std::min(region.min_value, volume.data[v]);
+                    region.max_value = std::max(region.max_value, volume.data[v]);
+                }
+            }
+        }
+        #pragma omp critical
+        for (uint32_t b = 0; b < branch_count; ++b)
+        {
+            if (local[b].voxel_count == 0) continue;
+            BranchRegion& region = segmentation.regions[b];
+            region.voxel_count += local[b].voxel_count;
+            region.min = glm::min(region.min, local[b].min);
+            region.max = glm::max(region.max, local[b].max);
+            region.min_value = std::min(region.min_value, local[b].min_value);
+            region.max_value = std::max(region.max_value, local[b].max_value);
+        }
+    }
+    return segmentation;
+}
+
+std::vector<uint8_t> branch_mask(const BranchSegmentation& segmentation, const BranchDecomposition& branches, std::span<const uint32_t> selected)
+{
+    const std::vector<Branch>& all = branches.get_branches();
+    std::vector<uint8_t> in_selection(all.size(), 0);
+    for (uint32_t b : selected)
+    {
+        if (b < all.size()) in_selection[b] = 1;
+    }
+    // a branch gets its id after the branch it merges into
+    for (uint32_t b = 0; b < all.size(); ++b)
+    {
+        if (all[b].parent != NO_NODE && in_selection[all[b].parent]) in_selection[b] = 1;
+    }
+
+    const size_t n = size_t(segmentation.resolution.x) * segmentation.resolution.y * segmentation.resolution.z;
+    std::vector<uint8_t> mask(n);
+    if (segmentation.labels32.empty())
+    {
+        #pragma omp parallel for simd
+        for (size_t v = 0; v < n; ++v) mask[v] = in_selection[segmentation.labels16[v]];
+    }
+    else
+    {
+        #pragma omp parallel for simd
+        for (size_t v = 0; v < n; ++v) mask[v] = in_selection[segmentation.labels32[v]];
+    }
+    return mask;
+}
@@ -0,0 +1,159 @@
+// compares the persistence diagrams of volumes in data/volume, either the scalar and the gradient
+// diagram of one volume or the scalar diagrams of two volumes, writes fixed size feature vectors and
+// tracks features through a series of timesteps
+#include "volume.hpp"
+#include "volume_gradient.hpp"
+#include "persistence.hpp"
+#include "persistence_diagram.hpp"
+#include "diagram_distance.hpp"
+#include "diagram_vectorization.hpp"
+#include "feature_tracking.hpp"
+#include "util/timer.hpp"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+void print_usage()
+{
+    std::cout << "Usage: AutoTF_PH_compare [options] --distance A [B] | --features OUT A [B ...] | --track OUT T0 T1 ...\n"
+              << "  --distance A [B]   bottleneck and Wasserstein distance between the scalar and the gradient\n"
+              << "                     diagram of A, or between the scalar diagrams of A and B\n"
+              << "  --features OUT A [B ...]\n"
+              << "                     betti curve, landscapes and persistence image of the scalar diagram of\n"
+              << "                     every volume, written to OUT as one binary batch\n"
+              << "  --landscapes N     number of landscapes, default 5\n"
+              << "  --image N          persistence image resolution, default 32\n"
+              << "  --sigma F          persistence image gaussian in filtration units, default 4\n"
+              << "  --track OUT T0 T1 ...\n"
+              << "                     matches the scalar diagrams of consecutive timesteps and writes the feature\n"
+              << "                     tracks to OUT as CSV\n"
+              << "  --workers N        timesteps reduced concurrently while tracking, default 2\n"
+              << "  --max-distance F   matches further apart split into a death and a birth, default unlimited\n"
+              << "  --min-persistence N  points closer to the diagonal are not tracked, default 1\n"
+              << "  --gradient NAME    gradient operator (central, sobel, scharr), default central\n"
+              << "  --mode lower|upper filtration, default lower\n"
+              << "  --q F              Wasserstein exponent >= 1, default 2\n"
+              << "  --error F          relative error of the Wasserstein distance, default 0.01\n";
+}
+
+PersistenceDiagram compute_diagram(const Volume& volume, FiltrationMode mode)
+{
+    auto [boundary_matrix, filtration_values] = create_boundary_matrix(volume, mode);
+    const std::vector<PersistencePair> pairs = boundary_matrix.reduce();
+    return PersistenceDiagram(aggregate_pairs(pairs, filtration_values));
+}
+
+int main(int argc, char* argv[])
+{
+    FiltrationMode mode = FiltrationMode::LowerStar;
+    GradientOperator gradient_operator = GradientOperator::Central;
+    double q = 2.0;
+    double relative_error = 0.01;
+    std::vector<std::string> files;
+    std::string features_path;
+    std::string track_path;
+    TrackingSettings tracking;
+    VectorizationSettings vectorization;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--distance" && has_value)
+        {
+            files.push_back(argv[++i]);
+            if (i + 1 < argc && argv[i + 1][0] != '-') files.push_back(argv[++i]);
+        }
+        else if (arg == "--features" && i + 2 < argc)
+        {
+            features_path = argv[++i];
+            while (i + 1 < argc && argv[i + 1][0] != '-') files.push_back(argv[++i]);
+        }
+        else if (arg == "--track" && i + 2 < argc)
+        {
+            track_path = argv[++i];
+            while (i + 1 < argc && argv[i + 1][0] != '-') files.push_back(argv[++i]);
+        }
+        else if (arg == "--workers" && has_value) tracking.workers = std::stoul(argv[++i]);
+        else if (arg == "--max-distance" && has_value) tracking.max_distance = std::stod(argv[++i]);
+        else if (arg == "--min-persistence" && has_value) tracking.min_persistence = std::stoul(argv[++i]);
+        else if (arg == "--landscapes" && has_value) vectorization.landscape_count = std::stoul(argv[++i]);
+        else if (arg == "--image" && has_value) vectorization.image_resolution = std::stoul(argv[++i]);
+        else if (arg == "--sigma" && has_value) vectorization.image_sigma = std::stof(argv[++i]);
+        else if (arg == "--mode" && has_value) mode = std::string(argv[++i]) == "upper" ? FiltrationMode::UpperStar : FiltrationMode::LowerStar;
+        else if (arg == "--gradient" && has_value)
+        {
+            if (!parse_gradient_operator(argv[++i], gradient_operator))
+            {
+                std::cerr << "Unknown gradient operator: " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--q" && has_value) q = std::stod(argv[++i]);
+        else if (arg == "--error" && has_value) relative_error = std::stod(argv[++i]);
+        else
+        {
+            print_usage();
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+    if (files.empty() || q < 1.0)
+    {
+        print_usage();
+        return 1;
+    }
+
+    // timesteps are loaded by the tracking workers, one after another
+    if (!track_path.empty())
+    {
+        tracking.mode = mode;
+        FeatureTracker tracker(tracking.max_distance);
+        if (track_features(files, tracking, tracker) != 0) return 1;
+        std::cout << tracker.get_tracks().size() << " tracks over " << tracker.get_timesteps() << " timesteps" << std::endl;
+        if (write_tracks_csv(track_path, tracker) != 0) return 1;
+        std::cout << "Wrote " << track_path << std::endl;
+        return 0;
+    }
+
+    using ms = std::milli;
+    Timer<float> timer;
+    std::vector<Volume> volumes(files.size());
+    for (size_t f = 0; f < files.size(); ++f)
+    {
+        if (load_volume_from_file(files[f], volumes[f]) != 0)
+        {
+            std::cerr << "Failed to load " << files[f] << std::endl;
+            return 1;
+        }
+    }
+
+    if (!features_path.empty())
+    {
+        std::vector<DiagramFeatures> batch;
+        batch.reserve(volumes.size());
+        for (const Volume& volume : volumes) batch.push_back(vectorize_diagram(compute_diagram(volume, mode), vectorization));
+        std::cout << CLR_GREEN << "[TIMING] reduce and vectorize " << batch.size() << " diagrams: " << timer.restart<ms>() << " ms" << CLR_RESET << std::endl;
+        if (write_features(features_path, batch, vectorization) != 0) return 1;
+        std::cout << "Wrote " << features_path << std::endl;
+        return 0;
+    }
+
+    // a single volume is compared against its own gradient magnitude
+    if (volumes.size() == 1) volumes.push_back(compute_gradient_volume(volumes[0], gradient_operator));
+
+    const PersistenceDiagram a = compute_diagram(volumes[0], mode);
+    const PersistenceDiagram b = compute_diagram(volumes[1], mode);
+    std::cout << CLR_GREEN << "[TIMING] load and reduce: " << timer.restart<ms>() << " ms" << CLR_RESET << std::endl;
+    std::cout << "A: " << a.total_pairs() << " pairs, " << a.size() << " points" << std::endl;
+    std::cout << "B: " << b.total_pairs() << " pairs, " << b.size() << " points" << std::endl;
+
+    const double bottleneck = bottleneck_distance(a, b);
+    std::cout << CLR_GREEN << "[TIMING] bottleneck distance: " << timer.restart<ms>() << " ms" << CLR_RESET << std::endl;
+    const double wasserstein = wasserstein_distance(a, b, q, relative_error);
+    std::cout << CLR_GREEN << "[TIMING] wasserstein distance: " << timer.restart<ms>() << " ms" << CLR_RESET << std::endl;
+
+    std::cout << "bottleneck: " << bottleneck << std::endl;
+    std::cout << "wasserstein (q = " << q << "): " << wasserstein << std::endl;
+    return 0;
+}
@@ -0,0 +1,671 @@
+#include "diagram_distance.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+namespace
+{
+constexpr double INF = std::numeric_limits<double>::infinity();
+constexpr int32_t NONE = -1;
+
+struct Point
+{
+    double birth;
+    double death;
+};
+
+double linf(const Point& a, const Point& b)
+{
+    return std::max(std::abs(a.birth - b.birth), std::abs(a.death - b.death));
+}
+
+double diagonal_distance(const Point& p)
+{
+    return std::abs(p.death - p.birth) * 0.5;
+}
+
+// the off-diagonal points of a diagram with their multiplicities
+struct Points
+{
+    std::vector<Point> points;
+    std::vector<uint64_t> multiplicity;
+    std::vector<uint32_t> index; // point index in the diagram
+    uint64_t total = 0;
+};
+
+Points off_diagonal(const PersistenceDiagram& diagram)
+{
+    Points result;
+    for (size_t i = 0; i < diagram.size(); ++i)
+    {
+        const PersistencePair& p = diagram[i];
+        if (p.birth == p.death) continue;
+        result.points.push_back({double(p.birth), double(p.death)});
+        result.multiplicity.push_back(diagram.multiplicity()[i]);
+        result.index.push_back(uint32_t(i));
+        result.total += diagram.multiplicity()[i];
+    }
+    return result;
+}
+
+// static 2d kd-tree with one weight per point, the subtree minimum of the weights allows to skip
+// subtrees of removed (infinite weight) or too expensive points
+class KdTree
+{
+public:
+    struct Box
+    {
+        double min_birth, max_birth, min_death, max_death;
+    };
+
+    explicit KdTree(const std::vector<Point>& points) : points(points)
+    {
+        const size_t n = points.size();
+        node_point.resize(n);
+        std::iota(node_point.begin(), node_point.end(), 0u);
+        node_of.resize(n);
+        parent.assign(n, NONE);
+        left.assign(n, NONE);
+        right.assign(n, NONE);
+        box.resize(n);
+        weight.assign(n, 0.0);
+        subtree_min.assign(n, 0.0);
+        root = build(0, int32_t(n), NONE, 0);
+    }
+
+    double get_weight(uint32_t id) const { return weight[node_of[id]]; }
+
+    void set_weight(uint32_t id, double w)
+    {
+        int32_t k = int32_t(node_of[id]);
+        weight[k] = w;
+        for (; k != NONE; k = parent[k]) update(k);
+    }
+
+    // assign all weights at once and rebuild the subtree minima bottom up
+    template<class F>
+    void assign_weights(F f)
+    {
+        for (size_t k = 0; k < node_point.size(); ++k) weight[k] = f(node_point[k]);
+        if (root != NONE) rebuild(root);
+    }
+
+    // any point within L-infinity distance radius of c whose weight is <= max_weight, NONE if there is none
+    int32_t find(const Point& c, double radius, double max_weight) const
+    {
+        return root == NONE ? NONE : find(root, c, radius, max_weight);
+    }
+
+    // the point with the smallest value(point) + weight, bound(box) has to be a lower bound of value
+    // for all points inside of the box
+    template<class Bound, class Value>
+    void best(const Bound& bound, const Value& value, int32_t& best_id, double& best_value) const
+    {
+        best_id = NONE;
+        best_value = INF;
+        if (root != NONE) best(root, bound, value, best_id, best_value);
+    }
+
+    static double box_distance(const Box& b, const Point& c)
+    {
+        const double db = std::max({0.0, b.min_birth - c.birth, c.birth - b.max_birth});
+        const double dd = std::max({0.0, b.min_death - c.death, c.death - b.max_death});
+        return std::max(db, dd);
+    }
+
+private:
+    const std::vector<Point>& points;
+    std::vector<uint32_t> node_point; // point stored in node k
+    std::vector<uint32_t> node_of; // node of a point
+    std::vector<int32_t> parent, left, right;
+    std::vector<Box> box; // bounding box of the subtree
+    std::vector<double> weight;
+    std::vector<double> subtree_min;
+    int32_t root = NONE;
+
+    // nodes are stored in place, the node of the range [lo, hi) is its median
+    int32_t build(int32_t lo, int32_t hi, int32_t up, int depth)
+    {
+        if (lo >= hi) return NONE;
+        const int32_t mid = lo + (hi - lo) / 2;
+        std::nth_element(node_point.begin() + lo, node_point.begin() + mid, node_point.begin() + hi, [&](uint32_t a, uint32_t b)
+        {
+            return depth % 2 == 0 ? points[a].birth < points[b].birth : points[a].death < points[b].death;
+        });
+        node_of[node_point[mid]] = uint32_t(mid);
+        parent[mid] = up;
+        left[mid] = build(lo, mid, mid, depth + 1);
+        right[mid] = build(mid + 1, hi, mid, depth + 1);
+
+        const Point& p = points[node_point[mid]];
+        Box b = {p.birth, p.birth, p.death, p.death};
+        for (int32_t child : {left[mid], right[mid]})
+        {
+            if (child == NONE) continue;
+            b.min_birth = std::min(b.min_birth, box[child].min_birth);
+            b.max_birth = std::max(b.max_birth, box[child].max_birth);
+            b.min_death = std::min(b.min_death, box[child].min_death);
+            b.max_death = std::max(b.max_death, box[child].max_death);
+        }
+        box[mid] = b;
+        return mid;
+    }
+
+    void update(int32_t k)
+    {
+        double m = weight[k];
+        if (left[k] != NONE) m = std::min(m, subtree_min[left[k]]);
+        if (right[k] != NONE) m = std::min(m, subtree_min[right[k]]);
+        subtree_min[k] = m;
+    }
+
+    void rebuild(int32_t k)
+    {
+        if (left[k] != NONE) rebuild(left[k]);
+        if (right[k] != NONE) rebuild(right[k]);
+        update(k);
+    }
+
+    double box_distance(int32_t k, const Point& c) const
+    {
+        return box_distance(box[k], c);
+    }
+
+    int32_t find(int32_t k, const Point& c, double radius, double max_weight) const
+    {
+        if (subtree_min[k] > max_weight || box_distance(k, c) > radius) return NONE;
+        const uint32_t id = node_point[k];
+        if (weight[k] <= max_weight && linf(points[id], c) <= radius) return int32_t(id);
+        for (int32_t child : {left[k], right[k]})
+        {
+            if (child == NONE) continue;
+            const int32_t hit = find(child, c, radius, max_weight);
+            if (hit != NONE) return hit;
+        }
+        return NONE;
+    }
+
+    template<class Bound, class Value>
+    void best(int32_t k, const Bound& bound, const Value& value, int32_t& best_id, double& best_value) const
+    {
+        if (bound(box[k]) + subtree_min[k] >= best_value) return;
+        const uint32_t id = node_point[k];
+        const double v = value(points[id]) + weight[k];
+        if (v < best_value)
+        {
+            best_id = int32_t(id);
+            best_value = v;
+        }
+
+        // more promising child first, the other one is often pruned then
+        int32_t first = left[k], other = right[k];
+        if (first != NONE && other != NONE && bound(box[other]) + subtree_min[other] < bound(box[first]) + subtree_min[first]) std::swap(first, other);
+        if (first != NONE) best(first, bound, value, best_id, best_value);
+        if (other != NONE) best(other, bound, value, best_id, best_value);
+    }
+};
+
+// decides whether all points can be matched with distances <= radius, as a flow problem:
+// left nodes are the points of a (supply = multiplicity) and one node for the projections of b,
+// right nodes are the points of b (capacity = multiplicity) and one node for the projections of a
+// the flow is maximized in phases like Hopcroft-Karp, a BFS assigns layers and a DFS finds a blocking
+// flow; both remove right nodes from the kd-tree once they are exhausted so every phase is O(n log n)
+class BottleneckMatcher
+{
+public:
+    BottleneckMatcher(const Points& a, const Points& b) : a(a), b(b), tree(b.points), na(uint32_t(a.points.size())), nb(uint32_t(b.points.size())) {}
+
+    bool feasible(double max_distance)
+    {
+        radius = max_distance + 1e-9;
+        excess.assign(a.multiplicity.begin(), a.multiplicity.end());
+        excess.push_back(b.total);
+        residual.assign(b.multiplicity.begin(), b.multiplicity.end());
+        residual.push_back(a.total);
+        flow.clear();
+        partners.assign(nb + 1, {});
+        diagonal_right.clear();
+        for (uint32_t r = 0; r < nb; ++r)
+        {
+            if (diagonal_distance(b.points[r]) <= radius) diagonal_right.push_back(r);
+        }
+
+        uint64_t routed = 0;
+        while (build_layers())
+        {
+            // only right nodes of the layer graph are alive, the sink layer keeps nodes with free capacity
+            tree.assign_weights([&](uint32_t r) { return usable(r) ? -double(right_layer[r]) : INF; });
+            right_diagonal_alive = usable(nb);
+            diagonal_cursor = 0;
+            left_dead.assign(na + 1, 0);
+            for (uint32_t l = 0; l <= na; ++l)
+            {
+                if (left_layer[l] != 0 || excess[l] == 0) continue;
+                const uint64_t d = push(l, excess[l]);
+                excess[l] -= d;
+                routed += d;
+            }
+        }
+        return routed == a.total + b.total;
+    }
+
+    // the flow of the last feasible() call as matched diagram points
+    std::vector<DiagramMatch> matching() const
+    {
+        std::vector<DiagramMatch> result;
+        for (const auto& [key, count] : flow)
+        {
+            const uint32_t l = uint32_t(key >> 32), r = uint32_t(key);
+            if (count == 0 || (l == na && r == nb)) continue;
+            result.push_back({l == na ? DIAGONAL_POINT : a.index[l], r == nb ? DIAGONAL_POINT : b.index[r], uint32_t(count)});
+        }
+        std::sort(result.begin(), result.end(), [](const DiagramMatch& x, const DiagramMatch& y)
+        {
+            return x.a != y.a ? x.a < y.a : x.b < y.b;
+        });
+        return result;
+    }
+
+private:
+    const Points& a;
+    const Points& b;
+    KdTree tree;
+    uint32_t na, nb; // the diagonal nodes have the indices na (left) and nb (right)
+    double radius = 0.0;
+    std::vector<uint64_t> excess; // supply of a left node that is not routed yet
+    std::vector<uint64_t> residual; // free capacity of a right node
+    std::unordered_map<uint64_t, uint64_t> flow;
+    std::vector<std::vector<uint32_t>> partners; // left nodes that sent flow into a right node, may contain stale entries
+    std::vector<int32_t> left_layer, right_layer;
+    std::vector<char> left_dead;
+    std::vector<uint32_t> diagonal_right; // points of b within radius of the diagonal
+    size_t diagonal_cursor = 0;
+    bool right_diagonal_alive = false;
+    int32_t sink_layer = 0;
+
+    uint64_t get_flow(uint32_t l, uint32_t r) const
+    {
+        auto it = flow.find((uint64_t(l) << 32) | r);
+        return it == flow.end() ? 0 : it->second;
+    }
+
+    void add_flow(uint32_t l, uint32_t r, int64_t d)
+    {
+        uint64_t& f = flow[(uint64_t(l) << 32) | r];
+        if (f == 0 && d > 0) partners[r].push_back(l);
+        f += d;
+    }
+
+    bool reaches_diagonal(uint32_t l) const
+    {
+        return l == na || diagonal_distance(a.points[l]) <= radius;
+    }
+
+    bool usable(uint32_t r) const
+    {
+        return right_layer[r] != NONE && right_layer[r] <= sink_layer && (right_layer[r] < sink_layer || residual[r] > 0);
+    }
+
+    bool build_layers()
+    {
+        left_layer.assign(na + 1, NONE);
+        right_layer.assign(nb + 1, NONE);
+        tree.assign_weights([](uint32_t) { return 0.0; });
+        std::deque<uint32_t> queue;
+        for (uint32_t l = 0; l <= na; ++l)
+        {
+            if (excess[l] == 0) continue;
+            left_layer[l] = 0;
+            queue.push_back(l);
+        }
+
+        sink_layer = std::numeric_limits<int32_t>::max();
+        auto visit = [&](uint32_t r, int32_t layer)
+        {
+            right_layer[r] = layer;
+            if (r < nb) tree.set_weight(r, INF);
+            if (residual[r] > 0)
+            {
+                sink_layer = std::min(sink_layer, layer);
+                return;
+            }
+            for (uint32_t l : partners[r])
+            {
+                if (left_layer[l] != NONE || get_flow(l, r) == 0) continue;
+                left_layer[l] = layer + 1;
+                queue.push_back(l);
+            }
+        };
+        while (!queue.empty())
+        {
+            const uint32_t l = queue.front();
+            queue.pop_front();
+            const int32_t layer = left_layer[l] + 1;
+            if (layer > sink_layer) break;
+
+            if (right_layer[nb] == NONE && reaches_diagonal(l)) visit(nb, layer);
+            if (l == na)
+            {
+                for (uint32_t r : diagonal_right)
+                {
+                    if (right_layer[r] == NONE) visit(r, layer);
+                }
+            }
+            else
+            {
+                for (int32_t r = tree.find(a.points[l], radius, 0.0); r != NONE; r = tree.find(a.points[l], radius, 0.0)) visit(uint32_t(r), layer);
+            }
+        }
+        return sink_layer != std::numeric_limits<int32_t>::max();
+    }
+
+    int32_t next_right(uint32_t l, int32_t layer)
+    {
+        if (right_diagonal_alive && right_layer[nb] == layer && reaches_diagonal(l)) return int32_t(nb);
+        if (l != na) return tree.find(a.points[l], radius, -double(layer));
+        for (; diagonal_cursor < diagonal_right.size(); ++diagonal_cursor)
+        {
+            const uint32_t r = diagonal_right[diagonal_cursor];
+            if (tree.get_weight(r) == -double(layer)) return int32_t(r);
+        }
+        return NONE;
+    }
+
+    void kill_right(uint32_t r)
+    {
+        if (r == nb) right_diagonal_alive = false;
+        else tree.set_weight(r, INF);
+    }
+
+    // routes up to amount units from left node l along the layers, returns the routed amount
+    uint64_t push(uint32_t l, uint64_t amount)
+    {
+        const int32_t layer = left_layer[l] + 1;
+        uint64_t pushed = 0;
+        while (pushed < amount)
+        {
+            const int32_t r = next_right(l, layer);
+            if (r == NONE)
+            {
+                left_dead[l] = 1;
+                break;
+            }
+            const uint64_t want = amount - pushed;
+            if (layer == sink_layer)
+            {
+                const uint64_t d = std::min(want, residual[r]);
+                add_flow(l, uint32_t(r), int64_t(d));
+                residual[r] -= d;
+                pushed += d;
+                if (residual[r] == 0) kill_right(uint32_t(r));
+                continue;
+            }
+
+            // r is full, make room by rerouting the flow of its partners in the next layer
+            uint64_t moved = 0;
+            for (size_t k = 0; k < partners[r].size() && moved < want; ++k)
+            {
+                const uint32_t next = partners[r][k];
+                if (left_layer[next] != layer + 1 || left_dead[next]) continue;
+                const uint64_t f = get_flow(next, uint32_t(r));
+                if (f == 0) continue;
+                const uint64_t d = push(next, std::min(f, want - moved));
+                if (d == 0) continue;
+                add_flow(next, uint32_t(r), -int64_t(d));
+                add_flow(l, uint32_t(r), int64_t(d));
+                moved += d;
+            }
+            pushed += moved;
+            if (moved < want) kill_right(uint32_t(r));
+        }
+        return pushed;
+    }
+};
+
+// lower bound of the distance to the diagonal for all points inside of a box
+double diagonal_distance(const KdTree::Box& b)
+{
+    return std::max({0.0, b.min_death - b.max_birth, b.min_birth - b.max_death}) * 0.5;
+}
+
+// min cost transportation between both diagrams where every distinct point is one node with its
+// multiplicity: sources are the points of a and one diagonal node standing for the projections of b,
+// sinks are the points of b and one diagonal node for the projections of a (the projections are all
+// connected at cost 0, so one node per side gives the same optimum as one projection per point)
+// Solved with the auction algorithm in its epsilon-relaxation form for transportation problems, so
+// identical pairs never bid one by one: a source with surplus bids for its best sink and sends all of
+// its units there, a sink that received more than its multiplicity lowers its price and hands units
+// back to the source it values least
+class Auction
+{
+public:
+    Auction(const Points& a, const Points& b, double q) : a(a), b(b), q(q), na(uint32_t(a.points.size())), nb(uint32_t(b.points.size())), tree(b.points)
+    {
+        supply = a.multiplicity;
+        supply.push_back(b.total);
+        demand = b.multiplicity;
+        demand.push_back(a.total);
+        source_price.assign(na + 1, 0.0);
+        sink_price.assign(nb + 1, 0.0);
+        tree.assign_weights([](uint32_t) { return 0.0; });
+    }
+
+    double run(double relative_error)
+    {
+        double max_cost = 0.0;
+        for (const Point& p : a.points) max_cost = std::max(max_cost, cost(diagonal_distance(p)));
+        for (const Point& p : b.points) max_cost = std::max(max_cost, cost(diagonal_distance(p)));
+        if (max_cost == 0.0) return 0.0;
+
+        // every phase ends with an epsilon-optimal flow, the sink prices give a lower bound on the optimum
+        const double tolerance = std::pow(1.0 + relative_error, q) - 1.0;
+        epsilon = max_cost;
+        for (;;)
+        {
+            solve_phase();
+
+            long double primal = 0.0L, dual = 0.0L;
+            for (const auto& [key, x] : flow) primal += (long double)x * arc_cost(uint32_t(key >> 32), uint32_t(key));
+            for (uint32_t j = 0; j <= nb; ++j) dual += (long double)demand[j] * sink_price[j];
+            for (uint32_t i = 0; i <= na; ++i) dual += (long double)supply[i] * best_sink(i).second;
+
+            if (primal <= dual * (1.0L + tolerance) + 1e-9L * max_cost || epsilon < max_cost * 1e-12)
+            {
+                return std::pow(double(std::max(primal, 0.0L)), 1.0 / q);
+            }
+            epsilon /= 5.0;
+        }
+    }
+
+private:
+    const Points& a;
+    const Points& b;
+    double q;
+    uint32_t na, nb; // the diagonal nodes have the indices na (source) and nb (sink)
+    KdTree tree; // sinks j < nb, weight = -price
+    std::vector<uint64_t> supply, demand;
+    std::vector<double> source_price, sink_price;
+    std::vector<uint64_t> source_excess;
+    std::vector<int64_t> sink_excess; // received minus multiplicity
+    std::unordered_map<uint64_t, uint64_t> flow; // key source << 32 | sink
+    std::vector<std::vector<std::pair<double, uint32_t>>> holders; // per sink a lazy max-heap of price + cost of its sources
+    double epsilon = 0.0;
+
+    double cost(double distance) const
+    {
+        return q == 1.0 ? distance : q == 2.0 ? distance * distance : std::pow(distance, q);
+    }
+
+    double arc_cost(uint32_t i, uint32_t j) const
+    {
+        if (i < na) return cost(j < nb ? linf(a.points[i], b.points[j]) : diagonal_distance(a.points[i]));
+        return j < nb ? cost(diagonal_distance(b.points[j])) : 0.0;
+    }
+
+    void set_sink_price(uint32_t j, double price)
+    {
+        sink_price[j] = price;
+        if (j < nb) tree.set_weight(j, -price);
+    }
+
+    // the sink minimizing cost - price for a source and that minimum
+    std::pair<uint32_t, double> best_sink(uint32_t i) const
+    {
+        int32_t best;
+        double value;
+        if (i < na)
+        {
+            const Point& p = a.points[i];
+            tree.best([&](const KdTree::Box& box) { return cost(KdTree::box_distance(box, p)); }, [&](const Point& o) { return cost(linf(p, o)); }, best, value);
+        }
+        else
+        {
+            tree.best([&](const KdTree::Box& box) { return cost(diagonal_distance(box)); }, [&](const Point& o) { return cost(diagonal_distance(o)); }, best, value);
+        }
+        const double diagonal = arc_cost(i, nb) - sink_price[nb];
+        if (best == NONE || diagonal < value) return {nb, diagonal};
+        return {uint32_t(best), value};
+    }
+
+    void solve_phase()
+    {
+        flow.clear();
+        holders.assign(nb + 1, {});
+        source_excess = supply;
+        sink_excess.resize(nb + 1);
+        for (uint32_t j = 0; j <= nb; ++j) sink_excess[j] = -int64_t(demand[j]);
+
+        // nodes 0 .. na are sources, the sinks follow
+        std::deque<uint32_t> queue;
+        std::vector<char> queued(na + nb + 2, 0);
+        for (uint32_t i = 0; i <= na; ++i)
+        {
+            // start without any flow, the source prices make every arc epsilon-optimal
+            source_price[i] = -best_sink(i).second;
+            if (supply[i] == 0) continue;
+            queue.push_back(i);
+            queued[i] = 1;
+        }
+        auto activate = [&](uint32_t node)
+        {
+            if (queued[node]) return;
+            queue.push_back(node);
+            queued[node] = 1;
+        };
+
+        while (!queue.empty())
+        {
+            const uint32_t node = queue.front();
+            queue.pop_front();
+            queued[node] = 0;
+
+            if (node <= na)
+            {
+                // bid: lower the source price until its best sink is admissible and send all units there
+                const uint32_t i = node;
+                if (source_excess[i] == 0) continue;
+                const auto [j, value] = best_sink(i);
+                if (value + source_price[i] >= 0.0) source_price[i] = -value - epsilon;
+
+                flow[(uint64_t(i) << 32) | j] += source_excess[i];
+                holders[j].emplace_back(source_price[i] + arc_cost(i, j), i);
+                std::push_heap(holders[j].begin(), holders[j].end());
+                sink_excess[j] += int64_t(source_excess[i]);
+                source_excess[i] = 0;
+                if (sink_excess[j] > 0) activate(na + 1 + j);
+                continue;
+            }
+
+            // a sink with too many units returns them to the source it values least; source prices only
+            // decrease during a phase, so stale heap entries overestimate and are refreshed when on top
+            const uint32_t j = node - na - 1;
+            auto& heap = holders[j];
+            while (sink_excess[j] > 0)
+            {
+                std::pop_heap(heap.begin(), heap.end());
+                const uint32_t i = heap.back().second;
+                auto it = flow.find((uint64_t(i) << 32) | j);
+                if (it == flow.end() || it->second == 0)
+                {
+                    heap.pop_back();
+                    continue;
+                }
+                const double value = source_price[i] + arc_cost(i, j);
+                if (value < heap.back().first)
+                {
+                    heap.back().first = value;
+                    std::push_heap(heap.begin(), heap.end());
+                    continue;
+                }
+                std::push_heap(heap.begin(), heap.end());
+                if (sink_price[j] >= value) set_sink_price(j, value - epsilon);
+
+                const uint64_t amount = std::min(uint64_t(sink_excess[j]), it->second);
+                it->second -= amount;
+                if (it->second == 0) flow.erase(it);
+                sink_excess[j] -= int64_t(amount);
+                if (source_excess[i] == 0) activate(i);
+                source_excess[i] += amount;
+            }
+        }
+    }
+};
+
+// smallest feasible radius, distances between integer points are multiples of 0.5 so the search
+// runs over k with radius k / 2; matching every point to the diagonal is always possible and gives
+// the upper bound; leaves the matcher with the flow of the returned radius
+double bottleneck_search(BottleneckMatcher& matcher, const Points& pa, const Points& pb)
+{
+    uint32_t hi = 0;
+    for (const Points* points : {&pa, &pb})
+    {
+        for (const Point& p : points->points) hi = std::max(hi, uint32_t(2.0 * diagonal_distance(p) + 0.5));
+    }
+    uint32_t lo = 0;
+    bool hi_is_current = false;
+    while (lo < hi)
+    {
+        const uint32_t mid = lo + (hi - lo) / 2;
+        hi_is_current = matcher.feasible(0.5 * mid);
+        if (hi_is_current) hi = mid;
+        else lo = mid + 1;
+    }
+    if (!hi_is_current) matcher.feasible(0.5 * hi);
+    return 0.5 * hi;
+}
+} // namespace
+
+double bottleneck_distance(const PersistenceDiagram& a, const PersistenceDiagram& b)
+{
+    const Points pa = off_diagonal(a);
+    const Points pb = off_diagonal(b);
+    BottleneckMatcher matcher(pa, pb);
+    return bottleneck_search(matcher, pa, pb);
+}
+
+std::vector<DiagramMatch> bottleneck_matching(const PersistenceDiagram& a, const PersistenceDiagram& b, double& distance)
+{
+    const Points pa = off_diagonal(a);
+    const Points pb = off_diagonal(b);
+    BottleneckMatcher matcher(pa, pb);
+    distance = bottleneck_search(matcher, pa, pb);
+    return matcher.matching();
+}
+
+double wasserstein_distance(const PersistenceDiagram& a, const PersistenceDiagram& b, double q, double relative_error)
+{
+    if (q < 1.0)
+    {
+        std::cerr << "Wasserstein distance needs q >= 1, got " << q << std::endl;
+        return -1.0;
+    }
+    const Points pa = off_diagonal(a);
+    const Points pb = off_diagonal(b);
+    Auction auction(pa, pb, q);
+    return auction.run(relative_error);
+}
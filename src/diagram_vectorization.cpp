@@ -0,0 +1,228 @@
+#include "diagram_vectorization.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace
+{
+struct Interval
+{
+    float lo;
+    float hi;
+    float weight; // multiplicity
+};
+
+std::vector<Interval> intervals(const PersistenceDiagram& diagram, std::span<const uint32_t> points)
+{
+    std::vector<Interval> result;
+    result.reserve(points.size());
+    for (uint32_t i : points)
+    {
+        const PersistencePair& p = diagram[i];
+        if (p.birth == p.death) continue;
+        result.push_back({float(std::min(p.birth, p.death)), float(std::max(p.birth, p.death)), float(diagram.multiplicity()[i])});
+    }
+    return result;
+}
+
+inline float sample_step(float max_value, uint32_t samples)
+{
+    return samples > 1 ? max_value / float(samples - 1) : 1.0f;
+}
+
+// gaussian of one point along one image axis, truncated at 3 sigma
+struct AxisKernel
+{
+    uint32_t first = 0;
+    uint32_t last = 0; // exclusive
+    uint32_t offset = 0; // into the shared weight array
+};
+
+AxisKernel axis_kernel(float center, float pixel_size, uint32_t resolution, float sigma, std::vector<float>& weights)
+{
+    const float radius = 3.0f * sigma;
+    AxisKernel kernel;
+    kernel.first = uint32_t(std::clamp(std::floor((center - radius) / pixel_size), 0.0f, float(resolution)));
+    kernel.last = uint32_t(std::clamp(std::ceil((center + radius) / pixel_size), 0.0f, float(resolution)));
+    kernel.offset = uint32_t(weights.size());
+    for (uint32_t x = kernel.first; x < kernel.last; ++x)
+    {
+        const float d = (float(x) + 0.5f) * pixel_size - center;
+        weights.push_back(std::exp(-d * d / (2.0f * sigma * sigma)));
+    }
+    return kernel;
+}
+} // namespace
+
+std::vector<float> betti_curve(const PersistenceDiagram& diagram, std::span<const uint32_t> points, const VectorizationSettings& settings)
+{
+    const uint32_t levels = settings.betti_levels;
+    const float step = sample_step(settings.max_value, levels);
+    std::vector<double> diff(size_t(levels) + 1, 0.0);
+
+    // alive at sample k if lo <= k * step < hi
+    auto first_sample = [&](float value)
+    {
+        return size_t(std::clamp(std::ceil(value / step), 0.0f, float(levels)));
+    };
+    for (const Interval& interval : intervals(diagram, points))
+    {
+        diff[first_sample(interval.lo)] += interval.weight;
+        diff[first_sample(interval.hi)] -= interval.weight;
+    }
+
+    std::vector<float> curve(levels);
+    double alive = 0.0;
+    for (uint32_t k = 0; k < levels; ++k)
+    {
+        alive += diff[k];
+        curve[k] = float(alive);
+    }
+    return curve;
+}
+
+std::vector<float> persistence_landscapes(const PersistenceDiagram& diagram, std::span<const uint32_t> points, const VectorizationSettings& settings)
+{
+    const uint32_t K = settings.landscape_count, S = settings.landscape_samples;
+    const float step = sample_step(settings.max_value, S);
+    const std::vector<Interval> items = intervals(diagram, points);
+    std::vector<float> landscapes(size_t(K) * S, 0.0f);
+    if (K == 0) return landscapes;
+
+    #pragma omp parallel
+    {
+        // descending top k of the tent values, every copy of a point counts once
+        std::vector<float> top(K);
+
+        #pragma omp for schedule(dynamic, 8)
+        for (int s = 0; s < int(S); ++s)
+        {
+            const float t = float(s) * step;
+            std::fill(top.begin(), top.end(), 0.0f);
+            for (const Interval& interval : items)
+            {
+                const float tent = std::min(t - interval.lo, interval.hi - t);
+                if (tent <= top[K - 1]) continue;
+                const uint32_t copies = uint32_t(std::min(interval.weight, float(K)));
+                for (uint32_t c = 0; c < copies && tent > top[K - 1]; ++c)
+                {
+                    uint32_t k = K - 1;
+                    for (; k > 0 && top[k - 1] < tent; --k) top[k] = top[k - 1];
+                    top[k] = tent;
+                }
+            }
+            for (uint32_t k = 0; k < K; ++k) landscapes[size_t(k) * S + s] = top[k];
+        }
+    }
+    return landscapes;
+}
+
+std::vector<float> persistence_image(const PersistenceDiagram& diagram, std::span<const uint32_t> points, const VectorizationSettings& settings)
+{
+    const uint32_t R = settings.image_resolution;
+    const float pixel_size = settings.max_value / float(std::max(R, 1u));
+    const float sigma = std::max(settings.image_sigma, 1e-3f);
+    const std::vector<Interval> items = intervals(diagram, points);
+    std::vector<float> image(size_t(R) * R, 0.0f);
+    if (items.empty() || R == 0) return image;
+
+    // separable kernels per point, the weight ramps linearly from 0 at the diagonal to 1 at the
+    // largest persistence and includes the multiplicity and the gaussian normalization
+    float max_persistence = 0.0f;
+    for (const Interval& interval : items) max_persistence = std::max(max_persistence, interval.hi - interval.lo);
+    const float norm = 1.0f / (2.0f * float(M_PI) * sigma * sigma * max_persistence);
+
+    std::vector<float> weights;
+    std::vector<AxisKernel> kx(items.size()), ky(items.size());
+    std::vector<float> scale(items.size());
+    for (size_t p = 0; p < items.size(); ++p)
+    {
+        const float persistence = items[p].hi - items[p].lo;
+        kx[p] = axis_kernel(items[p].lo, pixel_size, R, sigma, weights);
+        ky[p] = axis_kernel(persistence, pixel_size, R, sigma, weights);
+        scale[p] = items[p].weight * persistence * norm;
+    }
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int y = 0; y < int(R); ++y)
+    {
+        float* row = image.data() + size_t(y) * R;
+        for (size_t p = 0; p < items.size(); ++p)
+        {
+            if (uint32_t(y) < ky[p].first || uint32_t(y) >= ky[p].last) continue;
+            const float c = scale[p] * weights[ky[p].offset + (y - ky[p].first)];
+            const float* gx = weights.data() + kx[p].offset - kx[p].first;
+            #pragma omp simd
+            for (uint32_t x = kx[p].first; x < kx[p].last; ++x) row[x] += c * gx[x];
+        }
+    }
+    return image;
+}
+
+DiagramFeatures vectorize_diagram(const PersistenceDiagram& diagram, std::span<const uint32_t> points, const VectorizationSettings& settings)
+{
+    DiagramFeatures features;
+    features.betti = betti_curve(diagram, points, settings);
+    features.landscapes = persistence_landscapes(diagram, points, settings);
+    features.image = persistence_image(diagram, points, settings);
+    return features;
+}
+
+DiagramFeatures vectorize_diagram(const PersistenceDiagram& diagram, const VectorizationSettings& settings)
+{
+    std::vector<uint32_t> all(diagram.size());
+    std::iota(all.begin(), all.end(), 0u);
+    return vectorize_diagram(diagram, all, settings);
+}
+
+int write_features(const std::string& path, const std::vector<DiagramFeatures>& batch, const VectorizationSettings& settings)
+{
+    std::ofstream out(path, std::ios::binary);
+    if (!out)
+    {
+        std::cerr << "Failed to open feature file for writing: " << path << std::endl;
+        return 1;
+    }
+
+    auto write_u32 = [&](uint32_t value) { out.write(reinterpret_cast<const char*>(&value), sizeof(value)); };
+    auto write_f32 = [&](float value) { out.write(reinterpret_cast<const char*>(&value), sizeof(value)); };
+    auto write_array = [&](const std::vector<float>& values, size_t expected)
+    {
+        if (values.size() != expected) return false;
+        out.write(reinterpret_cast<const char*>(values.data()), std::streamsize(values.size() * sizeof(float)));
+        return true;
+    };
+
+    out.write("PDVF", 4);
+    write_u32(1);
+    write_u32(uint32_t(batch.size()));
+    write_u32(settings.betti_levels);
+    write_u32(settings.landscape_count);
+    write_u32(settings.landscape_samples);
+    write_u32(settings.image_resolution);
+    write_f32(settings.max_value);
+    write_f32(settings.image_sigma);
+    for (const DiagramFeatures& features : batch)
+    {
+        if (!write_array(features.betti, settings.betti_levels) ||
+            !write_array(features.landscapes, size_t(settings.landscape_count) * settings.landscape_samples) ||
+            !write_array(features.image, size_t(settings.image_resolution) * settings.image_resolution))
+        {
+            std::cerr << "Features do not match the settings, not writing " << path << std::endl;
+            return 1;
+        }
+    }
+    if (!out)
+    {
+        std::cerr << "Failed to write feature file: " << path << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,281 @@
+#include "feature_tracking.hpp"
+#include "diagram_distance.hpp"
+#include "persistence.hpp"
+#include "util/timer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+bool same_point(const PersistencePair& a, const PersistencePair& b)
+{
+    return a.birth == b.birth && a.death == b.death;
+}
+
+bool point_less(const PersistencePair& a, const PersistencePair& b)
+{
+    return a.birth != b.birth ? a.birth < b.birth : a.death < b.death;
+}
+
+uint32_t point_distance(const PersistencePair& a, const PersistencePair& b)
+{
+    return std::max(a.birth > b.birth ? a.birth - b.birth : b.birth - a.birth, a.death > b.death ? a.death - b.death : b.death - a.death);
+}
+
+// reduced diagram of one timestep without the points closer than min_persistence to the diagonal
+PersistenceDiagram compute_diagram(const Volume& volume, const TrackingSettings& settings)
+{
+    auto [boundary_matrix, filtration_values] = create_boundary_matrix(volume, settings.mode);
+    const AggregatedDiagram all = aggregate_pairs(boundary_matrix.reduce(), filtration_values);
+    AggregatedDiagram kept;
+    for (size_t i = 0; i < all.size(); ++i)
+    {
+        const PersistencePair& p = all.points[i];
+        if ((p.death > p.birth ? p.death - p.birth : p.birth - p.death) < std::max(settings.min_persistence, 1u)) continue;
+        kept.points.push_back(p);
+        kept.multiplicity.push_back(all.multiplicity[i]);
+        kept.total_pairs += all.multiplicity[i];
+    }
+    return PersistenceDiagram(std::move(kept));
+}
+} // namespace
+
+uint32_t FeatureTracker::start_track(uint32_t parent, uint32_t point, uint32_t count, const PersistenceDiagram& diagram)
+{
+    FeatureTrack track;
+    track.id = uint32_t(tracks.size());
+    track.parent = parent;
+    track.last_timestep = timesteps - 1;
+    track.steps.push_back({timesteps - 1, diagram[point], count});
+    tracks.push_back(std::move(track));
+    return tracks.back().id;
+}
+
+void FeatureTracker::add(PersistenceDiagram diagram)
+{
+    const uint32_t t = timesteps++;
+    std::vector<Active> next;
+    auto off_diagonal = [](const PersistenceDiagram& d, uint32_t i) { return d[i].birth != d[i].death; };
+
+    if (t == 0)
+    {
+        for (uint32_t j = 0; j < diagram.size(); ++j)
+        {
+            if (!off_diagonal(diagram, j)) continue;
+            next.push_back({start_track(NO_TRACK, j, diagram.multiplicity()[j], diagram), j, diagram.multiplicity()[j]});
+        }
+        active = std::move(next);
+        previous = std::move(diagram);
+        return;
+    }
+
+    // identical points keep their features, both point lists are sorted by birth and death
+    std::vector<DiagramMatch> matches;
+    AggregatedDiagram rest_a, rest_b;
+    std::vector<uint32_t> index_a, index_b;
+    auto keep_rest = [](AggregatedDiagram& rest, std::vector<uint32_t>& index, const PersistenceDiagram& d, uint32_t i, uint32_t count)
+    {
+        if (count == 0 || d[i].birth == d[i].death) return;
+        rest.points.push_back(d[i]);
+        rest.multiplicity.push_back(count);
+        rest.total_pairs += count;
+        index.push_back(i);
+    };
+    uint32_t i = 0, j = 0;
+    while (i < previous.size() || j < diagram.size())
+    {
+        if (j == diagram.size() || (i < previous.size() && point_less(previous[i], diagram[j])))
+        {
+            keep_rest(rest_a, index_a, previous, i, previous.multiplicity()[i]);
+            ++i;
+        }
+        else if (i == previous.size() || point_less(diagram[j], previous[i]))
+        {
+            keep_rest(rest_b, index_b, diagram, j, diagram.multiplicity()[j]);
+            ++j;
+        }
+        else
+        {
+            const uint32_t same = std::min(previous.multiplicity()[i], diagram.multiplicity()[j]);
+            if (off_diagonal(diagram, j)) matches.push_back({i, j, same});
+            keep_rest(rest_a, index_a, previous, i, previous.multiplicity()[i] - same);
+            keep_rest(rest_b, index_b, diagram, j, diagram.multiplicity()[j] - same);
+            ++i;
+            ++j;
+        }
+    }
+
+    // only the changed pairs are matched, matches beyond max_distance become a death and a birth
+    double distance = 0.0;
+    changed_pairs.push_back(rest_a.total_pairs + rest_b.total_pairs);
+    if (!rest_a.empty() || !rest_b.empty())
+    {
+        const std::vector<DiagramMatch> changed = bottleneck_matching(PersistenceDiagram(std::move(rest_a)), PersistenceDiagram(std::move(rest_b)), distance);
+        for (const DiagramMatch& m : changed)
+        {
+            const uint32_t a = m.a == DIAGONAL_POINT ? DIAGONAL_POINT : index_a[m.a];
+            const uint32_t b = m.b == DIAGONAL_POINT ? DIAGONAL_POINT : index_b[m.b];
+            if (a != DIAGONAL_POINT && b != DIAGONAL_POINT && point_distance(previous[a], diagram[b]) > max_distance)
+            {
+                matches.push_back({a, DIAGONAL_POINT, m.count});
+                matches.push_back({DIAGONAL_POINT, b, m.count});
+            }
+            else
+            {
+                matches.push_back({a, b, m.count});
+            }
+        }
+    }
+    step_distances.push_back(distance);
+
+    // per previous point the largest continuation first, deaths last; births (a = diagonal) at the end
+    std::sort(matches.begin(), matches.end(), [](const DiagramMatch& x, const DiagramMatch& y)
+    {
+        if (x.a != y.a) return x.a < y.a;
+        if ((x.b == DIAGONAL_POINT) != (y.b == DIAGONAL_POINT)) return y.b == DIAGONAL_POINT;
+        return x.count > y.count;
+    });
+
+    // hand the outgoing features of every previous point to the tracks sitting on it, larger tracks
+    // and larger continuations first; a track keeps its id on the first continuation it takes and
+    // splits off child tracks for the others
+    size_t m = 0;
+    for (size_t g = 0; g < active.size();)
+    {
+        const uint32_t point = active[g].point;
+        size_t g_end = g;
+        while (g_end < active.size() && active[g_end].point == point) ++g_end;
+        std::sort(active.begin() + g, active.begin() + g_end, [](const Active& x, const Active& y) { return x.count > y.count; });
+        while (m < matches.size() && matches[m].a < point) ++m;
+
+        for (; g < g_end; ++g)
+        {
+            uint32_t remaining = active[g].count;
+            bool continued = false;
+            while (remaining > 0 && m < matches.size() && matches[m].a == point)
+            {
+                DiagramMatch& out = matches[m];
+                const uint32_t piece = std::min(remaining, out.count);
+                remaining -= piece;
+                out.count -= piece;
+                if (out.b != DIAGONAL_POINT)
+                {
+                    if (!continued)
+                    {
+                        FeatureTrack& track = tracks[active[g].track];
+                        const TrackStep& last = track.steps.back();
+                        if (!same_point(last.point, diagram[out.b]) || last.count != piece) track.steps.push_back({t, diagram[out.b], piece});
+                        track.last_timestep = t;
+                        next.push_back({active[g].track, out.b, piece});
+                        continued = true;
+                    }
+                    else
+                    {
+                        next.push_back({start_track(active[g].track, out.b, piece, diagram), out.b, piece});
+                    }
+                }
+                if (out.count == 0) ++m;
+            }
+        }
+    }
+    for (; m < matches.size(); ++m)
+    {
+        if (matches[m].a == DIAGONAL_POINT && matches[m].count > 0) next.push_back({start_track(NO_TRACK, matches[m].b, matches[m].count, diagram), matches[m].b, matches[m].count});
+    }
+
+    std::sort(next.begin(), next.end(), [](const Active& x, const Active& y) { return x.point < y.point; });
+    active = std::move(next);
+    previous = std::move(diagram);
+}
+
+int track_features(const std::vector<std::string>& files, const TrackingSettings& settings, FeatureTracker& tracker)
+{
+    const size_t n = files.size();
+    const size_t max_in_flight = std::max(settings.max_in_flight, 1u);
+    std::vector<std::unique_ptr<PersistenceDiagram>> slots(n);
+    std::mutex mutex;
+    std::condition_variable changed;
+    size_t next_file = 0; // next timestep a worker picks up
+    size_t consumed = 0; // timesteps already handed to the tracker
+    bool failed = false;
+
+    // workers run ahead of the matching by at most max_in_flight timesteps
+    auto worker = [&]()
+    {
+        while (true)
+        {
+            size_t t;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&] { return failed || next_file >= n || next_file < consumed + max_in_flight; });
+                if (failed || next_file >= n) return;
+                t = next_file++;
+            }
+            Volume volume;
+            if (load_volume_from_file(files[t], volume) != 0)
+            {
+                std::cerr << "Failed to load timestep " << t << ": " << files[t] << std::endl;
+                std::lock_guard<std::mutex> lock(mutex);
+                failed = true;
+                changed.notify_all();
+                return;
+            }
+            auto diagram = std::make_unique<PersistenceDiagram>(compute_diagram(volume, settings));
+            std::lock_guard<std::mutex> lock(mutex);
+            slots[t] = std::move(diagram);
+            changed.notify_all();
+        }
+    };
+    std::vector<std::thread> pool;
+    for (uint32_t w = 0; w < std::max(settings.workers, 1u); ++w) pool.emplace_back(worker);
+
+    using ms = std::milli;
+    Timer<float> timer;
+    for (size_t t = 0; t < n; ++t)
+    {
+        std::unique_ptr<PersistenceDiagram> diagram;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&] { return failed || slots[t] != nullptr; });
+            if (failed) break;
+            diagram = std::move(slots[t]);
+            consumed = t + 1;
+        }
+        changed.notify_all();
+
+        const float wait_ms = timer.restart<ms>();
+        tracker.add(std::move(*diagram));
+        std::cout << CLR_GREEN << "[TIMING] timestep " << t << ": waited " << wait_ms << " ms, matched " << timer.restart<ms>() << " ms";
+        if (t > 0) std::cout << " (" << tracker.get_changed_pairs().back() << " changed pairs)";
+        std::cout << CLR_RESET << std::endl;
+    }
+    for (std::thread& thread : pool) thread.join();
+    return failed ? 1 : 0;
+}
+
+int write_tracks_csv(const std::string& path, const FeatureTracker& tracker)
+{
+    std::ofstream out(path);
+    if (!out)
+    {
+        std::cerr << "Failed to open track file for writing: " << path << std::endl;
+        return 1;
+    }
+    out << "track,parent,timestep,birth,death,count,last_timestep\n";
+    for (const FeatureTrack& track : tracker.get_tracks())
+    {
+        for (const TrackStep& step : track.steps)
+        {
+            out << track.id << "," << (track.parent == NO_TRACK ? -1 : int64_t(track.parent)) << "," << step.timestep << ","
+                << step.point.birth << "," << step.point.death << "," << step.count << "," << track.last_timestep << "\n";
+        }
+    }
+    return out ? 0 : 1;
+}
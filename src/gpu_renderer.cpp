@@ -2,6 +2,8 @@
 
 #include "event_handler.hpp"
 #include "work_context.hpp"
+#include "volume_layout.hpp"
+#include "volume_gradient.hpp"
 #include "util/timer.hpp"
 #include "SDL3/SDL_mouse.h"
 
@@ -12,14 +14,17 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <filesystem>
+#include <algorithm>
+#include <atomic>
+#include <thread>
 
 struct GPUContext 
 {
-    GPUContext(AppState &app_state, const Volume &volume, std::vector<PersistencePair>&& raw_pairs, std::vector<int>&& raw_filt, std::vector<PersistencePair>&& raw_grad_pairs, std::vector<int>&& raw_grad_filt) : vcc(vmc), wc(vmc, vcc, std::move(raw_pairs), std::move(raw_filt), std::move(raw_grad_pairs), std::move(raw_grad_filt))
+    GPUContext(AppState &app_state, const Volume &volume, std::shared_ptr<const PairStore> scalar_pairs, std::shared_ptr<const PairStore> gradient_pairs, bool volume_complete = true) : vcc(vmc), wc(vmc, vcc, std::move(scalar_pairs), std::move(gradient_pairs))
     {
         vmc.construct(app_state.get_window_extent().width, app_state.get_window_extent().height);
         vcc.construct();
-        wc.construct(app_state, volume);
+        wc.construct(app_state, volume, volume_complete);
     }
 
     ~GPUContext() 
@@ -103,13 +108,11 @@ void exportMergeTreeEdges(const MergeTree &merge_tree, const std::string &filena
         return;
     }
     
-    const auto &nodes = merge_tree.get_all_nodes();
-    for (const auto &pair : nodes)
+    for (uint32_t node = 0; node < merge_tree.size(); ++node)
     {
-        MergeTreeNode* node = pair.second;
-        for (auto child : node->children)
+        for (uint32_t child = merge_tree.first_child(node); child != NO_NODE; child = merge_tree.next_sibling(child))
         {
-            ofs << node->id << " " << child->id << "\n";
+            ofs << node << " " << child << "\n";
         }
     }
     ofs.close();
@@ -126,31 +129,19 @@ void exportFilteredMergeTreeEdges(const MergeTree &merge_tree, const std::string
         return;
     }
     
-    // determine which nodes are within the allowed depth
-    const auto &nodes = merge_tree.get_all_nodes();
-    std::unordered_set<uint32_t> filteredNodeIds;
-    for (const auto &pair : nodes) {
-        MergeTreeNode* node = pair.second;
-        if (node->depth <= maxDepth)
-        {
-            filteredNodeIds.insert(node->id);
-        }
-    }
-    
-    // export only edges where both the parent and the child are in the filtered set, and the child's persistence meets the minPersistence threshold
-    for (const auto &pair : nodes) 
+    // export only edges where both the parent and the child are within the allowed depth, and the child's persistence meets the minPersistence threshold
+    for (uint32_t parent = 0; parent < merge_tree.size(); ++parent)
     {
-        MergeTreeNode* parent = pair.second;
-        if (filteredNodeIds.find(parent->id) == filteredNodeIds.end())
+        if (merge_tree.depth(parent) > maxDepth)
             continue;
-        for (auto child : parent->children)
+        for (uint32_t child = merge_tree.first_child(parent); child != NO_NODE; child = merge_tree.next_sibling(child))
         {
-            if (filteredNodeIds.find(child->id) != filteredNodeIds.end())
+            if (merge_tree.depth(child) <= maxDepth)
             {
-                int persistence = child->death - child->birth;
+                int persistence = merge_tree.death(child) - merge_tree.birth(child);
                 if (persistence >= minPersistence)
                 {
-                    ofs << parent->id << " " << child->id << "\n";
+                    ofs << parent << " " << child << "\n";
                 }
             }
         }
@@ -160,58 +151,73 @@ void exportFilteredMergeTreeEdges(const MergeTree &merge_tree, const std::string
     std::cout << "Filtered merge tree edges exported to " << filename << " (max depth = " << maxDepth << ", min persistence = " << minPersistence << ")" << std::endl;
 }
 
-// collect nodes at a given target level recursively
-void get_nodes_at_level(MergeTreeNode *node, int currentLevel, int targetLevel, std::vector<MergeTreeNode *> &result) 
+// return persistence pairs corresponding to nodes at a given target level
+std::vector<PersistencePair> get_persistence_pairs_for_level(const MergeTree& merge_tree, int targetLevel, uint32_t minPersistence)
 {
-    if (!node)
-        return;
-    if (currentLevel == targetLevel) 
+    std::span<const uint32_t> levelNodes = merge_tree.nodes_at_level(targetLevel, minPersistence);
+    std::cout << "Total nodes found at target level " << targetLevel << ": " << levelNodes.size() << std::endl;
+
+    std::vector<PersistencePair> selectedPairs;
+    selectedPairs.reserve(levelNodes.size());
+    for (uint32_t n : levelNodes)
     {
-        result.push_back(node);
-        return;
+        selectedPairs.push_back(PersistencePair(merge_tree.birth(n), merge_tree.death(n)));
     }
-    for (auto child : node->children) 
+    return selectedPairs;
+}
+
+std::string volume_cache_prefix(const Volume& volume)
+{
+    // decide on a volume‐specific cache path, hash the dimensions
+    std::string vol_id = std::to_string(volume.resolution.x) + "x" + std::to_string(volume.resolution.y) + "x" + std::to_string(volume.resolution.z);
+    // the name keeps volumes of equal size and filtered variants of the same volume apart
+    if (!volume.name.empty())
     {
-        get_nodes_at_level(child, currentLevel + 1, targetLevel, result);
+        std::string name = volume.name;
+        std::replace(name.begin(), name.end(), '/', '_');
+        vol_id = name + "_" + vol_id;
     }
+    return "cache/" + vol_id;
 }
 
-// return persistence pairs corresponding to nodes at a given target level
-std::vector<PersistencePair> get_persistence_pairs_for_level(MergeTree& merge_tree, int targetLevel) 
+// count followed by the values, written next to path and renamed so a crash never leaves a torn cache
+// behind
+template<class T>
+static void write_cache(const std::string& path, const std::vector<T>& values)
 {
-    std::vector<MergeTreeNode*> levelNodes;
-    auto all_nodes = merge_tree.get_all_nodes();
-    for (const auto& [id, node] : all_nodes) 
+    const std::string tmp_path = path + ".tmp";
     {
-        if (node->parent == nullptr) 
+        std::ofstream out(tmp_path, std::ios::binary);
+        size_t N = values.size();
+        out.write((char*)&N, sizeof(N));
+        out.write((char*)values.data(), sizeof(T)*N);
+        if (!out)
         {
-            get_nodes_at_level(node, 0, targetLevel, levelNodes);
+            std::cerr << "Failed to write " << tmp_path << std::endl;
+            return;
         }
     }
-    std::cout << "Total nodes found at target level " << targetLevel << ": " << levelNodes.size() << std::endl;
-    
-    std::vector<PersistencePair> selectedPairs;
-    for (auto n : levelNodes) 
-    {
-        //std::cout << "Selected PersistencePair: Birth = " << n->birth << ", Death = " << n->death << ", Depth = " << n->depth << std::endl;
-        selectedPairs.push_back(PersistencePair(n->birth, n->death));
-    }
-    return selectedPairs;
+    std::error_code ec;
+    std::filesystem::rename(tmp_path, path, ec);
+    if (ec) std::cerr << "Failed to move " << tmp_path << " to " << path << ": " << ec.message() << std::endl;
 }
 
-int gpu_render(const Volume &volume) 
+// load or compute the scalar and gradient pairs of the volume and build their stores, a gradient volume
+// the caller already has is used instead of computing it again. a set cancelled flag stops it between the
+// stages, the stores are left empty then
+static void prepare_persistence(const Volume& volume, FiltrationMode mode, GradientOperator gradient_operator, const Volume* gradient, std::shared_ptr<const PairStore>& scalar_pairs, std::shared_ptr<const PairStore>& gradient_pairs,
+                                const std::atomic<bool>* cancelled = nullptr)
 {
-    AppState app_state;
+    auto stop = [&]() { return cancelled && cancelled->load(std::memory_order_acquire); };
     Timer<float> timer;
     using ms = std::milli;
 
-    // decide on a volume‐specific cache path, hash the dimensions
-    std::string cache_base = "cache/";
-    std::string vol_id = std::to_string(volume.resolution.x) + "x" + std::to_string(volume.resolution.y) + "x" + std::to_string(volume.resolution.z);
+    const std::string cache_prefix = volume_cache_prefix(volume);
+    const std::string cache_base = std::filesystem::path(cache_prefix).parent_path().string();
 
     // load or compute raw persistence pairs
-    std::string pairs_cache = cache_base + vol_id + "_pairs.bin";
-    std::string filt_cache = cache_base + vol_id + "_filts.bin";
+    std::string pairs_cache = cache_prefix + "_pairs.bin";
+    std::string filt_cache = cache_prefix + "_filts.bin";
     std::vector<PersistencePair> raw_pairs;
     std::vector<int> filtration_values;
 
@@ -238,27 +244,20 @@ int gpu_render(const Volume &volume)
     else
     {
       // do the expensive compute, then write it out for next time
-      raw_pairs = calculate_persistence_pairs(volume, filtration_values, app_state.filtration_mode);
+      raw_pairs = calculate_persistence_pairs(volume, filtration_values, mode);
       std::filesystem::create_directories(cache_base);
-      {
-        std::ofstream out(pairs_cache, std::ios::binary);
-        size_t N = raw_pairs.size();
-        out.write((char*)&N, sizeof(N));
-        out.write((char*)raw_pairs.data(), sizeof(PersistencePair)*N);
-      }
-      {
-        std::ofstream out(filt_cache, std::ios::binary);
-        size_t M = filtration_values.size();
-        out.write((char*)&M, sizeof(M));
-        out.write((char*)filtration_values.data(), sizeof(int)*M);
-      }
+      write_cache(pairs_cache, raw_pairs);
+      write_cache(filt_cache, filtration_values);
       std::cout << "Computed and cached " << raw_pairs.size() << " persistence pairs.\n";
     }
     std::cout << CLR_GREEN << "[TIMING] persistence‐pairs load/compute: " << timer.restart<ms>() << " ms\n" << CLR_RESET;
+    if (stop()) return;
 
     // gradient
-    std::string grad_pairs_cache = cache_base + vol_id + "_grad_pairs.bin";
-    std::string grad_filt_cache  = cache_base + vol_id + "_grad_filts.bin";
+    // the operator is part of the name, caches from before the one-sided border differences are not reused
+    const std::string grad_tag = "_grad_" + gradient_operator_name(gradient_operator);
+    std::string grad_pairs_cache = cache_prefix + grad_tag + "_pairs.bin";
+    std::string grad_filt_cache  = cache_prefix + grad_tag + "_filts.bin";
     std::vector<PersistencePair> raw_grad_pairs;
     std::vector<int> grad_filtration_values;
 
@@ -277,24 +276,15 @@ int gpu_render(const Volume &volume)
         std::cout << "Loaded " << raw_grad_pairs.size() << " gradient pairs from cache.\n";
     } else
     {
-        Volume grad_vol = compute_gradient_volume(volume);
-        raw_grad_pairs = calculate_persistence_pairs(grad_vol, grad_filtration_values, app_state.filtration_mode);
+        const Volume grad_vol = gradient ? Volume() : compute_gradient_volume(volume, gradient_operator);
+        raw_grad_pairs = calculate_persistence_pairs(gradient ? *gradient : grad_vol, grad_filtration_values, mode);
         std::filesystem::create_directories(cache_base);
-        {
-        std::ofstream outG(grad_pairs_cache, std::ios::binary);
-        size_t G = raw_grad_pairs.size();
-        outG.write((char*)&G, sizeof(G));
-        outG.write((char*)raw_grad_pairs.data(), sizeof(PersistencePair)*G);
-        }
-        {
-        std::ofstream outGF(grad_filt_cache, std::ios::binary);
-        size_t GF = grad_filtration_values.size();
-        outGF.write((char*)&GF, sizeof(GF));
-        outGF.write((char*)grad_filtration_values.data(), sizeof(int)*GF);
-        }
+        write_cache(grad_pairs_cache, raw_grad_pairs);
+        write_cache(grad_filt_cache, grad_filtration_values);
         std::cout << "Computed and cached " << raw_grad_pairs.size() << " gradient pairs.\n";
     }
     std::cout << CLR_GREEN << "[TIMING] gradient‐pairs load/compute: " << timer.restart<ms>() << " ms\n" << CLR_RESET;
+    if (stop()) return;
 
     // dump raw pairs for Python script
     std::ofstream outfile("volume_data/persistence_pairs.txt");
@@ -323,50 +313,58 @@ int gpu_render(const Volume &volume)
 
     std::cout << CLR_GREEN << "[TIMING] file+Python script: " << timer.restart<ms>() << " ms\n" << CLR_RESET;
 
-    std::vector<PersistencePair> scalar_display_pairs;
-    scalar_display_pairs.reserve(raw_pairs.size());
-    for (auto &p : raw_pairs)
+    // the raw pairs are moved into the shared stores, the display diagrams are aggregated exactly once
+    scalar_pairs = PairStore::create(std::move(raw_pairs), std::move(filtration_values));
+    gradient_pairs = PairStore::create(std::move(raw_grad_pairs), std::move(grad_filtration_values));
+    std::cout << CLR_GREEN << "[TIMING] aggregate persistence diagrams: " << timer.restart<ms>() << " ms\n" << CLR_RESET;
+}
+
+// the worker that completes a progressive load, ready once the completion is filled. destroying it
+// cancels the worker between its stages and joins it
+struct CompletionWorker
+{
+    ve::VolumeCompletion completion;
+    std::atomic<bool> ready{false};
+    std::atomic<bool> cancelled{false};
+    std::thread thread;
+
+    ~CompletionWorker()
     {
-        // look up the true scalar
-        uint32_t b = filtration_values[p.birth];
-        uint32_t d = filtration_values[p.death];
-        scalar_display_pairs.emplace_back(b, d);
+        cancelled.store(true, std::memory_order_release);
+        if (thread.joinable()) thread.join();
     }
+};
 
-    std::vector<PersistencePair> grad_display_pairs;
-    for (auto &p : raw_grad_pairs)
+int gpu_render(const Volume &volume, VolumeSeries* series, ProgressiveVolumeLoader* loader, GradientOperator gradient_operator) 
+{
+    AppState app_state;
+    app_state.gradient_operator = gradient_operator;
+    using ms = std::milli;
+
+    EventHandler eh;
+    std::shared_ptr<const PairStore> scalar_pairs;
+    std::shared_ptr<const PairStore> gradient_pairs;
+    if (loader)
     {
-        grad_display_pairs.emplace_back(grad_filtration_values[p.birth], grad_filtration_values[p.death]);
+        // the volume streams in, its persistence is computed once the last slice arrived
+        scalar_pairs = PairStore::create(std::vector<PersistencePair>{}, std::vector<int>{});
+        gradient_pairs = PairStore::create(std::vector<PersistencePair>{}, std::vector<int>{});
     }
-
-    // build a small normalized-and-filtered list
-    std::vector<PersistencePair> filtered_norm_pairs;
-    filtered_norm_pairs.reserve(raw_pairs.size());
-    for (auto &p : raw_pairs)
+    else
     {
-        uint32_t pers = (p.death > p.birth ? p.death - p.birth : 0);
-        if (pers < app_state.persistence_threshold)
-            continue; // skip small persistence
-
-        // map birth/death into actual scalar values
-        uint32_t b = filtration_values[p.birth];
-        uint32_t d = filtration_values[p.death];
-        filtered_norm_pairs.emplace_back(b, d);
+        prepare_persistence(volume, app_state.filtration_mode, gradient_operator, nullptr, scalar_pairs, gradient_pairs);
     }
+    std::vector<PersistencePair> raw_pairs;
+    std::vector<int> filtration_values;
+
+    // the renderer uploads and indexes the voxels linearly, persistence above works on any layout
+    const Volume linear_volume = volume.layout == VoxelLayout::Linear ? Volume() : relayout_volume(volume, VoxelLayout::Linear);
+    GPUContext gpu_context(app_state, volume.layout == VoxelLayout::Linear ? volume : linear_volume, scalar_pairs, gradient_pairs, loader == nullptr);
+    if (series) gpu_context.wc.set_volume_series(series, app_state);
+    if (loader) gpu_context.wc.set_volume_loader(loader, app_state);
+    // a stage that is already running finishes before closing the window returns, the rest is skipped
+    std::unique_ptr<CompletionWorker> worker;
 
-    EventHandler eh;
-    GPUContext gpu_context(app_state, volume, std::move(raw_pairs), std::move(filtration_values), std::move(raw_grad_pairs), std::move(grad_filtration_values));
-
-    auto t0 = std::chrono::high_resolution_clock::now();
-    gpu_context.wc.set_persistence_pairs(std::move(filtered_norm_pairs), volume);
-    auto t1 = std::chrono::high_resolution_clock::now();
-    std::cout << CLR_GREEN << "[TIMING] set_persistence_pairs: " << std::chrono::duration<float,ms>(t1 - t0).count() << " ms\n" << CLR_RESET;
-
-    auto t2 = std::chrono::high_resolution_clock::now();
-    gpu_context.wc.set_gradient_persistence_pairs(grad_display_pairs);
-    auto t3 = std::chrono::high_resolution_clock::now();
-    std::cout << CLR_GREEN << "[TIMING] set_gradient_persistence_pairs: " << std::chrono::duration<float,ms>(t3 - t2).count() << " ms\n" << CLR_RESET;
- 
     bool quit = false;
     Timer rendering_timer;
     SDL_Event e;
@@ -376,7 +374,43 @@ int gpu_render(const Volume &volume)
         dispatch_pressed_keys(gpu_context, eh, app_state);
         app_state.cam.update();
 
-        if (app_state.apply_filtration_mode)
+        if (loader && (loader->done() || loader->failed()) && !worker)
+        {
+            if (loader->failed())
+            {
+                // the slices read so far stay on screen
+                std::cerr << "Progressive loading failed, the volume stays incomplete." << std::endl;
+                gpu_context.wc.set_volume_loader(nullptr, app_state);
+                loader = nullptr;
+            }
+            else
+            {
+                // the gradient is computed once for the pairs and the renderer, the render thread only swaps
+                // the finished completion in
+                worker = std::make_unique<CompletionWorker>();
+                worker->completion.merge_tree_settings = gpu_context.wc.merge_tree_settings(0);
+                worker->thread = std::thread([&volume, w = worker.get(), mode = app_state.filtration_mode, gradient_operator]()
+                {
+                    ve::VolumeCompletion& completion = w->completion;
+                    auto stop = [w]() { return w->cancelled.load(std::memory_order_acquire); };
+                    completion.gradient_volume = compute_gradient_volume(volume, gradient_operator);
+                    if (stop()) return;
+                    prepare_persistence(volume, mode, gradient_operator, &completion.gradient_volume, completion.scalar_pairs, completion.gradient_pairs, &w->cancelled);
+                    if (stop()) return;
+                    ve::WorkContext::prepare_completion(volume, completion);
+                    w->ready.store(true, std::memory_order_release);
+                });
+                app_state.persistence_pending = true;
+            }
+        }
+        if (worker && worker->ready.load(std::memory_order_acquire))
+        {
+            gpu_context.wc.complete_volume(app_state, std::move(worker->completion));
+            worker.reset();
+            app_state.persistence_pending = false;
+            loader = nullptr;
+        }
+        if (app_state.apply_filtration_mode && !loader)
         {
             raw_pairs = calculate_persistence_pairs(volume, filtration_values, app_state.filtration_mode);
             std::cout << "Filtration mode updated. New raw persistence pairs: " << raw_pairs.size() << std::endl;
@@ -399,6 +433,8 @@ int gpu_render(const Volume &volume)
         }
         app_state.time_diff = rendering_timer.restart();
     }
+    // joined before the renderer is torn down
+    worker.reset();
     return 0;
 }
 
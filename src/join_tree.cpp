@@ -0,0 +1,311 @@
+#include "join_tree.hpp"
+#include "volume_layout.hpp"
+#include "util/array_file.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iostream>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace
+{
+constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+inline uint32_t find_root(std::vector<uint32_t>& parent, uint32_t x)
+{
+    // path halving
+    while (parent[x] != x)
+    {
+        parent[x] = parent[parent[x]];
+        x = parent[x];
+    }
+    return x;
+}
+
+// adds root to the distinct roots collected so far
+inline void add_root(std::array<uint32_t, 6>& roots, uint32_t& count, uint32_t root)
+{
+    for (uint32_t k = 0; k < count; ++k)
+    {
+        if (roots[k] == root) return;
+    }
+    roots[count++] = root;
+}
+
+constexpr char AUGMENTED_TREE_MAGIC[8] = {'A', 'M', 'T', 'R', 'E', 'E', '0', '1'};
+constexpr uint32_t AUGMENTED_TREE_ARRAYS = 5;
+} // namespace
+
+AugmentedMergeTree compute_merge_tree(const Volume& volume, MergeTreeType type, uint32_t slabs)
+{
+    // node ids are linear voxel indices
+    if (volume.layout != VoxelLayout::Linear) return compute_merge_tree(relayout_volume(volume, VoxelLayout::Linear), type, slabs);
+    const uint32_t X = volume.resolution.x, Y = volume.resolution.y, Z = volume.resolution.z;
+    const size_t slice = size_t(X) * Y;
+    const size_t n = slice * Z;
+    AugmentedMergeTree tree;
+    tree.type = type;
+    if (n == 0) return tree;
+
+    // the sweep order is ascending (key, voxel index), a split tree sweeps the inverted values
+    const uint8_t* data = volume.data.data();
+    const uint8_t flip = type == MergeTreeType::Join ? 0 : 255;
+    auto key = [&](size_t v) { return uint8_t(data[v] ^ flip); };
+    auto before = [&](size_t u, size_t v) { return key(u) != key(v) ? key(u) < key(v) : u < v; };
+
+#ifdef _OPENMP
+    if (slabs == 0) slabs = uint32_t(omp_get_max_threads());
+#endif
+    slabs = std::clamp(slabs, 1u, Z);
+    std::vector<uint32_t> slab_z(slabs + 1);
+    for (uint32_t s = 0; s <= slabs; ++s) slab_z[s] = uint32_t(uint64_t(Z) * s / slabs);
+
+    // local sweeps: inside a slab every voxel joins the components of its lower neighbours; voxels that
+    // start or merge components and all voxels on a plane shared with another slab are reduced vertices,
+    // link holds the next reduced vertex above a reduced vertex and the reduced vertex below a regular one
+    std::vector<uint32_t> order(n), uf(n), top(n), link(n, NONE);
+    std::vector<uint8_t> reduced(n, 0);
+    std::vector<std::vector<uint32_t>> slab_reduced(slabs);
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int s = 0; s < int(slabs); ++s)
+    {
+        const uint32_t z0 = slab_z[s], z1 = slab_z[s + 1];
+        const size_t first = z0 * slice, last = z1 * slice;
+
+        // counting sort, visiting the voxels in index order keeps the ties ordered
+        std::array<size_t, 257> start{};
+        for (size_t v = first; v < last; ++v) start[key(v) + 1]++;
+        for (int k = 0; k < 256; ++k) start[k + 1] += start[k];
+        for (size_t v = first; v < last; ++v) order[first + start[key(v)]++] = uint32_t(v);
+
+        std::vector<uint32_t>& local_reduced = slab_reduced[s];
+        for (size_t o = first; o < last; ++o)
+        {
+            const uint32_t v = order[o];
+            const uint32_t x = uint32_t(v % X), y = uint32_t((v / X) % Y), z = uint32_t(v / slice);
+            std::array<uint32_t, 6> roots;
+            uint32_t count = 0;
+            auto visit = [&](size_t u)
+            {
+                if (before(u, v)) add_root(roots, count, find_root(uf, uint32_t(u)));
+            };
+            if (x > 0) visit(v - 1);
+            if (x + 1 < X) visit(v + 1);
+            if (y > 0) visit(v - X);
+            if (y + 1 < Y) visit(v + X);
+            if (z > z0) visit(v - slice);
+            if (z + 1 < z1) visit(v + slice);
+
+            const bool boundary = (z == z0 && z0 > 0) || (z + 1 == z1 && z1 < Z);
+            if (count == 1 && !boundary)
+            {
+                uf[v] = roots[0];
+                link[v] = top[roots[0]];
+                continue;
+            }
+            reduced[v] = 1;
+            local_reduced.push_back(v);
+            uf[v] = v;
+            top[v] = v;
+            for (uint32_t k = 0; k < count; ++k)
+            {
+                link[top[roots[k]]] = v;
+                uf[roots[k]] = v;
+            }
+        }
+    }
+
+    // global sweep over the reduced vertices, lower neighbours are the local children and the
+    // neighbours across a slab boundary
+    std::vector<uint32_t> global_order;
+    for (const std::vector<uint32_t>& local_reduced : slab_reduced) global_order.insert(global_order.end(), local_reduced.begin(), local_reduced.end());
+    std::sort(global_order.begin(), global_order.end(), [&](uint32_t a, uint32_t b) { return before(a, b); });
+    const uint32_t m = uint32_t(global_order.size());
+
+    std::vector<uint32_t>& rid = top; // the local tops are not needed anymore
+    for (uint32_t i = 0; i < m; ++i) rid[global_order[i]] = i;
+
+    std::vector<uint32_t> child_start(m + 1, 0), children;
+    for (uint32_t i = 0; i < m; ++i)
+    {
+        if (link[global_order[i]] != NONE) child_start[rid[link[global_order[i]]] + 1]++;
+    }
+    for (uint32_t i = 0; i < m; ++i) child_start[i + 1] += child_start[i];
+    children.resize(child_start[m]);
+    {
+        std::vector<uint32_t> fill(child_start.begin(), child_start.end() - 1);
+        for (uint32_t i = 0; i < m; ++i)
+        {
+            if (link[global_order[i]] != NONE) children[fill[rid[link[global_order[i]]]]++] = i;
+        }
+    }
+
+    std::vector<uint32_t> guf(m), gtop(m), post(m);
+    for (uint32_t i = 0; i < m; ++i)
+    {
+        const uint32_t v = global_order[i];
+        // at most six lower neighbours in the voxel grid, so at most six components meet here
+        std::array<uint32_t, 6> roots;
+        uint32_t count = 0;
+        auto join = [&](uint32_t j) { add_root(roots, count, find_root(guf, j)); };
+        for (uint32_t c = child_start[i]; c < child_start[i + 1]; ++c) join(children[c]);
+        const uint32_t z = uint32_t(v / slice);
+        const uint32_t s = uint32_t(std::upper_bound(slab_z.begin(), slab_z.end(), z) - slab_z.begin()) - 1;
+        if (z == slab_z[s] && z > 0 && before(v - slice, v)) join(rid[v - slice]);
+        if (z + 1 == slab_z[s + 1] && z + 1 < Z && before(v + slice, v)) join(rid[v + slice]);
+
+        guf[i] = i;
+        if (count == 1)
+        {
+            guf[i] = roots[0];
+            post[i] = gtop[roots[0]];
+            continue;
+        }
+        // a leaf or a saddle
+        const uint32_t node = uint32_t(tree.node_voxel.size());
+        tree.node_voxel.push_back(v);
+        tree.node_value.push_back(data[v]);
+        tree.node_parent.push_back(NO_NODE);
+        for (uint32_t k = 0; k < count; ++k)
+        {
+            tree.node_parent[gtop[roots[k]]] = node;
+            guf[roots[k]] = i;
+        }
+        gtop[i] = node;
+        post[i] = node;
+    }
+
+    // the root sits on the last voxel of the sweep unless that voxel is a saddle already
+    uint32_t last_voxel = order[slab_z[1] * slice - 1];
+    for (uint32_t s = 1; s < slabs; ++s)
+    {
+        const uint32_t candidate = order[slab_z[s + 1] * slice - 1];
+        if (before(last_voxel, candidate)) last_voxel = candidate;
+    }
+    uint32_t root = NO_NODE;
+    if (tree.node_voxel.back() != last_voxel)
+    {
+        root = uint32_t(tree.node_voxel.size());
+        tree.node_voxel.push_back(last_voxel);
+        tree.node_value.push_back(data[last_voxel]);
+        tree.node_parent.push_back(NO_NODE);
+        // the grid is connected, a single component remains
+        tree.node_parent[gtop[find_root(guf, m - 1)]] = root;
+    }
+
+    // augmentation: a regular voxel lies on the highest arc above its reduced vertex that starts
+    // before it; the voxels of a slab are visited in sweep order, so the walk per reduced vertex
+    // only moves up
+    tree.voxel_arc.resize(n);
+    std::vector<uint32_t>& cursor = post;
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int s = 0; s < int(slabs); ++s)
+    {
+        for (size_t o = slab_z[s] * slice; o < slab_z[s + 1] * slice; ++o)
+        {
+            const uint32_t v = order[o];
+            if (reduced[v])
+            {
+                tree.voxel_arc[v] = cursor[rid[v]];
+                continue;
+            }
+            uint32_t& arc = cursor[rid[link[v]]];
+            while (tree.node_parent[arc] != NO_NODE && before(tree.node_voxel[tree.node_parent[arc]], v)) arc = tree.node_parent[arc];
+            tree.voxel_arc[v] = arc;
+        }
+    }
+    if (root != NO_NODE) tree.voxel_arc[last_voxel] = root;
+    return tree;
+}
+
+MergeTree to_merge_tree(const AugmentedMergeTree& tree)
+{
+    MergeTree merge_tree;
+    const uint32_t count = uint32_t(tree.size());
+    merge_tree.reserve(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const uint32_t parent = tree.node_parent[i];
+        merge_tree.add_node(tree.node_value[i], parent == NO_NODE ? tree.node_value[i] : tree.node_value[parent]);
+    }
+
+    // parents are created after their children, attach top down so the child lists come out in id order
+    for (uint32_t i = count; i-- > 0;)
+    {
+        if (tree.node_parent[i] != NO_NODE) merge_tree.chain_union(tree.node_parent[i], i);
+        else merge_tree.set_root(i);
+    }
+    merge_tree.build_index();
+    return merge_tree;
+}
+
+uint64_t augmented_merge_tree_key(const Volume& volume, MergeTreeType type)
+{
+    // FNV-1a style over 64 bit words, the voxels are far too many to hash bytewise on every load
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&](uint64_t value)
+    {
+        hash ^= value;
+        hash *= 1099511628211ull;
+    };
+    mix(volume.resolution.x);
+    mix(volume.resolution.y);
+    mix(volume.resolution.z);
+    mix(uint64_t(volume.layout));
+    mix(uint64_t(type));
+    const uint8_t* data = volume.data.data();
+    const size_t size = volume.data.size();
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        mix(word);
+    }
+    for (; i < size; ++i) mix(data[i]);
+    return hash;
+}
+
+int save_augmented_merge_tree(const AugmentedMergeTree& tree, const std::string& path, uint64_t key)
+{
+    ArrayFileWriter out(path, AUGMENTED_TREE_MAGIC, key, AUGMENTED_TREE_ARRAYS);
+    out.write(std::vector<uint8_t>{uint8_t(tree.type)});
+    out.write(tree.node_voxel);
+    out.write(tree.node_value);
+    out.write(tree.node_parent);
+    out.write(tree.voxel_arc);
+    return out.finish();
+}
+
+int load_augmented_merge_tree(const std::string& path, AugmentedMergeTree& tree, uint64_t key)
+{
+    ArrayFileReader in;
+    const int status = in.open(path, AUGMENTED_TREE_MAGIC, key, AUGMENTED_TREE_ARRAYS);
+    if (status == 2)
+    {
+        std::cerr << "Merge tree cache " << path << " was built from another volume." << std::endl;
+        return 1;
+    }
+    AugmentedMergeTree loaded;
+    std::vector<uint8_t> type;
+    bool valid = status == 0 && in.read(type) && in.read(loaded.node_voxel) && in.read(loaded.node_value) && in.read(loaded.node_parent) && in.read(loaded.voxel_arc);
+
+    const size_t n = loaded.node_voxel.size(), voxels = loaded.voxel_arc.size();
+    valid = valid && type.size() == 1 && type[0] <= uint8_t(MergeTreeType::Split) && loaded.node_value.size() == n && loaded.node_parent.size() == n;
+    valid = valid && std::all_of(loaded.node_voxel.begin(), loaded.node_voxel.end(), [&](uint32_t v) { return v < voxels; })
+        && std::all_of(loaded.node_parent.begin(), loaded.node_parent.end(), [&](uint32_t id) { return id < n || id == NO_NODE; })
+        && std::all_of(loaded.voxel_arc.begin(), loaded.voxel_arc.end(), [&](uint32_t id) { return id < n; });
+    if (!valid)
+    {
+        std::cerr << "ERROR: " << path << " is not a valid merge tree cache." << std::endl;
+        return 1;
+    }
+    loaded.type = MergeTreeType(type[0]);
+    tree = std::move(loaded);
+    return 0;
+}
@@ -1,30 +1,134 @@
 #include "volume.hpp"
+#include "volume_filter.hpp"
+#include "volume_gradient.hpp"
+#include "volume_layout.hpp"
+#include "volume_series.hpp"
+#include "volume_import.hpp"
+#include "volume_loader.hpp"
 #include "gpu_renderer.hpp"
 
+#include <algorithm>
 #include <iostream>
 
 int main(int argc, char* argv[])
 {
+    std::vector<std::string> paths;
+    uint32_t ring_size = 8;
+    FilterSettings filter_settings;
+    VolumeStorage storage = VolumeStorage::Mapped;
+    VoxelLayout layout = VoxelLayout::Linear;
+    GradientOperator gradient_operator = GradientOperator::Central;
+    bool progressive = false;
+    uint32_t chunk_slices = 16;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc)
+        {
+            if (!parse_filter_type(argv[++i], filter_settings.type))
+            {
+                std::cerr << "Unknown filter: " << argv[i] << " (expected none, gaussian, median or bilateral)" << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--filter-radius" && i + 1 < argc) filter_settings.radius = std::stoul(argv[++i]);
+        else if (arg == "--filter-sigma" && i + 1 < argc) filter_settings.sigma = std::stof(argv[++i]);
+        else if (arg == "--filter-range-sigma" && i + 1 < argc) filter_settings.range_sigma = std::stof(argv[++i]);
+        else if (arg == "--no-mmap") storage = VolumeStorage::Owned;
+        else if (arg == "--ring" && i + 1 < argc) ring_size = std::stoul(argv[++i]);
+        else if (arg == "--progressive") progressive = true;
+        else if (arg == "--chunk-slices" && i + 1 < argc) chunk_slices = std::max(1ul, std::stoul(argv[++i]));
+        else if (arg == "--layout" && i + 1 < argc)
+        {
+            if (!parse_voxel_layout(argv[++i], layout))
+            {
+                std::cerr << "Unknown layout: " << argv[i] << " (expected linear, bricked or morton)" << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--gradient" && i + 1 < argc)
+        {
+            if (!parse_gradient_operator(argv[++i], gradient_operator))
+            {
+                std::cerr << "Unknown gradient operator: " << argv[i] << " (expected central, sobel or scharr)" << std::endl;
+                return 1;
+            }
+        }
+        else paths.push_back(arg);
+    }
+
+    // several headers or one 4D header play back as a time series
+    NrrdHeader header;
+    const bool series_mode = paths.size() > 1 || (paths.size() == 1 && !is_importable_volume(paths.front()) && read_nrrd_header("data/volume/" + paths.front(), header) == 0 && header.timesteps > 1);
+
+    // a single linear NRRD volume can be shown while it loads, everything else needs the whole volume first
+    if (progressive && !series_mode && paths.size() == 1 && !is_importable_volume(paths.front()))
+    {
+        if (filter_settings.type != FilterType::None || layout != VoxelLayout::Linear)
+        {
+            std::cerr << "--progressive ignores --filter and --layout, the volume is shown linear and unfiltered." << std::endl;
+        }
+        ProgressiveVolumeLoader loader;
+        if (loader.start(paths.front(), chunk_slices) != 0)
+        {
+            std::cerr << "Failed to load volume!" << std::endl;
+            return 1;
+        }
+        if (gpu_render(loader.get_volume(), nullptr, &loader, gradient_operator) != 0)
+        {
+            std::cerr << "Failed to render volume on GPU!" << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    VolumeSeries series;
     Volume volume;
-    if (argc > 1) 
+    if (series_mode)
+    {
+        if (series.open(paths, ring_size, 2, gradient_operator) != 0)
+        {
+            std::cerr << "Failed to open volume series!" << std::endl;
+            return 1;
+        }
+        // persistence is computed for the first timestep
+        std::shared_ptr<const SeriesStep> first = series.get(0);
+        if (!first)
+        {
+            std::cerr << "Failed to load the first timestep!" << std::endl;
+            return 1;
+        }
+        volume = relayout_volume(first->volume, layout);
+        volume.name = series.get_name();
+    }
+    else if (!paths.empty()) 
     {
-        std::string path = argv[1];
+        const std::string& path = paths.front();
         std::cout << "Loading volume from file: " << path << std::endl;
-        if (load_volume_from_file(path, volume) != 0) 
+        // .vti, .mha/.mhd and DICOM directories go through VTK, everything else is a NRRD header
+        const bool imported = is_importable_volume(path);
+        if ((imported ? import_volume(path, volume) : load_volume_from_file(path, volume, storage, layout)) != 0) 
         {
             std::cerr << "Failed to load volume!" << std::endl;
             return 1;
         }
+        if (imported && layout != VoxelLayout::Linear) volume = relayout_volume(volume, layout);
     } else 
     {
         std::cout << "No file provided. Using default small volume." << std::endl;
-        volume = create_disjoint_components_volume();
+        volume = relayout_volume(create_disjoint_components_volume(), layout);
+    }
+
+    // optional pre-smoothing before persistence is computed
+    if (filter_settings.type != FilterType::None)
+    {
+        volume = apply_filter(volume, filter_settings);
     }
 
-    if (gpu_render(volume) != 0) 
+    if (gpu_render(volume, series_mode ? &series : nullptr, nullptr, gradient_operator) != 0) 
     {
         std::cerr << "Failed to render volume on GPU!" << std::endl;
         return 1;
     }
     return 0;
-}
\ No newline at end of file
+}
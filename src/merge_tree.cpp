@@ -1,159 +1,264 @@
 #include "merge_tree.hpp"
+#include "util/array_file.hpp"
 #include <algorithm>
 #include <iostream>
 
 #include <optional>
+#include <iterator>
+#include <map>
 #include <cmath>    
 
-MergeTree::MergeTree() : root(nullptr) {}
+void MergeTree::reserve(size_t count)
+{
+    parent_.reserve(count);
+    first_child_.reserve(count);
+    next_sibling_.reserve(count);
+    birth_.reserve(count);
+    death_.reserve(count);
+    depth_.reserve(count);
+    representative.reserve(count);
+}
 
-MergeTree::~MergeTree() {
-    for (auto& [id, node] : nodes) {
-        delete node;
+uint32_t MergeTree::add_node(uint32_t birth, uint32_t death)
+{
+    const uint32_t id = uint32_t(birth_.size());
+    parent_.push_back(NO_NODE);
+    first_child_.push_back(NO_NODE);
+    next_sibling_.push_back(NO_NODE);
+    birth_.push_back(birth);
+    death_.push_back(death);
+    depth_.push_back(0);
+    representative.push_back(id);
+    // update root: choose the node with the smallest birth
+    if (root == NO_NODE || birth < birth_[root])
+    {
+        root = id;
     }
+    return id;
 }
 
-void MergeTree::add_node(uint32_t id, uint32_t birth, uint32_t death) 
+uint32_t MergeTree::find(uint32_t id)
 {
-    if (nodes.find(id) != nodes.end()) 
-    {
-        std::cerr << "WARNING: Node ID=" << id << " already exists!" << std::endl;
-    } else 
+    uint32_t rep = id;
+    while (representative[rep] != rep) rep = representative[rep];
+    while (representative[id] != rep)
     {
-        nodes[id] = new MergeTreeNode(id, birth, death);
-        //std::cout << "Added Node ID=" << id << ", Birth=" << birth << ", Death=" << death << std::endl;
-        // update root: choose the node with the smallest birth
-        if (!root || birth < root->birth) 
-        {
-            root = nodes[id];
-        }
+        const uint32_t next = representative[id];
+        representative[id] = rep;
+        id = next;
     }
+    return rep;
 }
 
-MergeTreeNode* MergeTree::find(uint32_t id) 
+void MergeTree::link(uint32_t parent, uint32_t child)
 {
-    MergeTreeNode* node = nodes[id];
-    if (node->parent == nullptr)
-        return node;
-    node->parent = find(node->parent->id);
-    return node->parent;
+    // unlink from the previous parent, its child list is short in every builder
+    const uint32_t old_parent = parent_[child];
+    if (old_parent != NO_NODE)
+    {
+        uint32_t* slot = &first_child_[old_parent];
+        while (*slot != child) slot = &next_sibling_[*slot];
+        *slot = next_sibling_[child];
+    }
+    parent_[child] = parent;
+    next_sibling_[child] = first_child_[parent];
+    first_child_[parent] = child;
 }
 
-void MergeTree::union_nodes(uint32_t idA, uint32_t idB) 
+void MergeTree::union_nodes(uint32_t idA, uint32_t idB)
 {
-    if (nodes.find(idA) == nodes.end() || nodes.find(idB) == nodes.end()) 
+    if (idA >= size() || idB >= size())
     {
         std::cerr << "ERROR: Cannot union nodes " << idA << " and " << idB << " because one does not exist." << std::endl;
         return;
     }
-    MergeTreeNode* repA = find(idA);
-    MergeTreeNode* repB = find(idB);
+    const uint32_t repA = find(idA);
+    const uint32_t repB = find(idB);
     if (repA == repB)
         return;
-    MergeTreeNode* parent = (repA->birth <= repB->birth) ? repA : repB;
-    MergeTreeNode* child  = (parent == repA) ? repB : repA;
-    child->parent = parent;
-    child->depth = parent->depth + 1;
-    parent->children.push_back(child);
-    //std::cout << "Union: Node " << parent->id << " (depth " << parent->depth << ") absorbs node " << child->id << " (depth " << child->depth << ")" << std::endl;
+    const uint32_t parent = (birth_[repA] <= birth_[repB]) ? repA : repB;
+    const uint32_t child = (parent == repA) ? repB : repA;
+    representative[child] = parent;
+    link(parent, child);
 }
 
 // directly attach death node to birth node without find/path compression
 void MergeTree::chain_union(uint32_t birth_id, uint32_t death_id)
 {
-    if (nodes.find(birth_id) == nodes.end() || nodes.find(death_id) == nodes.end())
+    if (birth_id >= size() || death_id >= size())
     {
         std::cerr << "Chain union error: one of the nodes does not exist." << std::endl;
         return;
     }
-    MergeTreeNode* birthNode = nodes[birth_id];
-    MergeTreeNode* deathNode = nodes[death_id];
-    deathNode->parent = birthNode;
-    deathNode->depth = birthNode->depth + 1;
-    birthNode->children.push_back(deathNode);
-    //std::cout << "Chain Union: Node " << birthNode->id << " (depth " << birthNode->depth << ") absorbs node " << deathNode->id << " (depth " << deathNode->depth << ")" << std::endl;
+    representative[death_id] = birth_id;
+    link(birth_id, death_id);
 }
 
-MergeTreeNode* MergeTree::get_root() const
+void MergeTree::set_root(uint32_t id)
 {
-    return root;
+    if (id >= size())
+    {
+        std::cerr << "ERROR: Cannot set root " << id << " because it does not exist." << std::endl;
+        return;
+    }
+    root = id;
 }
 
-const std::unordered_map<uint32_t, MergeTreeNode*>& MergeTree::get_all_nodes() const
+void MergeTree::build_index()
 {
-    return nodes;
-}
+    const uint32_t n = uint32_t(size());
 
-std::vector<uint32_t> MergeTree::find_nodes_by_depth(int targetDepth) const
-{
-    std::vector<uint32_t> result;
-    for (const auto& [id, node] : nodes)
+    // breadth first from every root, the queue ends up grouped by level
+    level_nodes.clear();
+    level_nodes.reserve(n);
+    level_start.assign(1, 0);
+    for (uint32_t id = 0; id < n; ++id)
+    {
+        if (parent_[id] == NO_NODE)
+        {
+            depth_[id] = 0;
+            level_nodes.push_back(id);
+        }
+    }
+    for (size_t begin = 0; begin < level_nodes.size();)
     {
-        if (node->parent == nullptr && node->depth == targetDepth)
+        const size_t end = level_nodes.size();
+        level_start.push_back(uint32_t(end));
+        for (size_t i = begin; i < end; ++i)
         {
-            result.push_back(id);
+            for (uint32_t child = first_child_[level_nodes[i]]; child != NO_NODE; child = next_sibling_[child])
+            {
+                depth_[child] = depth_[level_nodes[i]] + 1;
+                level_nodes.push_back(child);
+            }
         }
+        begin = end;
     }
-    return result;
+
+    // counting sort by decreasing persistence
+    uint32_t max_persistence = 0;
+    for (uint32_t id = 0; id < n; ++id) max_persistence = std::max(max_persistence, persistence(id));
+    persistence_cuts.assign(max_persistence + 2, 0);
+    for (uint32_t id = 0; id < n; ++id) persistence_cuts[persistence(id)]++;
+    for (uint32_t p = max_persistence + 1; p-- > 0;) persistence_cuts[p] += persistence_cuts[p + 1];
+    persistence_order.resize(n);
+    std::vector<uint32_t> fill(persistence_cuts.begin() + 1, persistence_cuts.end());
+    for (uint32_t id = 0; id < n; ++id) persistence_order[fill[persistence(id)]++] = id;
+
+    // distributing the persistence order into the levels keeps every level sorted
+    std::vector<uint32_t> level_fill(level_start.begin(), level_start.end() - 1);
+    for (uint32_t id : persistence_order) level_nodes[level_fill[depth_[id]]++] = id;
 }
 
-void MergeTree::set_target_level(int level)
+std::span<const uint32_t> MergeTree::nodes_at_level(int level, uint32_t min_persistence) const
 {
-    target_level = level;
+    if (level < 0 || level > get_max_level()) return {};
+    auto begin = level_nodes.begin() + level_start[level];
+    auto end = level_nodes.begin() + level_start[level + 1];
+    end = std::partition_point(begin, end, [&](uint32_t id) { return persistence(id) >= min_persistence; });
+    return {begin, end};
 }
 
-void MergeTree::set_persistence_threshold(int threshold)
+std::span<const uint32_t> MergeTree::nodes_with_persistence(uint32_t min_persistence) const
 {
-    persistence_threshold = threshold;
+    if (persistence_cuts.empty() || min_persistence > get_max_persistence()) return {};
+    return {persistence_order.data(), persistence_cuts[min_persistence]};
 }
 
-// find a key in compNodes within tolerance of deathVal
-std::optional<uint32_t> findCloseKey(const std::unordered_map<uint32_t, uint32_t>& compNodes, uint32_t deathVal, uint32_t tol) 
+namespace
 {
-    for (const auto &kv : compNodes) 
-    {
-        if (std::abs((int)kv.first - (int)deathVal) <= (int)tol) 
-        {
-            return kv.first;
-        }
-    }
-    return std::nullopt;
+// the root is stored as an array of one element ahead of the node arrays
+constexpr char MERGE_TREE_MAGIC[8] = {'M', 'T', 'R', 'E', 'E', '0', '0', '2'};
+constexpr uint32_t MERGE_TREE_ARRAYS = 12;
+
+bool valid_ids(const std::vector<uint32_t>& ids, size_t n, bool allow_none)
+{
+    return std::all_of(ids.begin(), ids.end(), [&](uint32_t id) { return id < n || (allow_none && id == NO_NODE); });
+}
+} // namespace
+
+int MergeTree::save(const std::string& path, uint64_t key) const
+{
+    ArrayFileWriter out(path, MERGE_TREE_MAGIC, key, MERGE_TREE_ARRAYS);
+    out.write(std::vector<uint32_t>{root});
+    out.write(parent_);
+    out.write(first_child_);
+    out.write(next_sibling_);
+    out.write(birth_);
+    out.write(death_);
+    out.write(depth_);
+    out.write(representative);
+    out.write(level_start);
+    out.write(level_nodes);
+    out.write(persistence_order);
+    out.write(persistence_cuts);
+    return out.finish();
 }
 
-MergeTree::MergeTree(MergeTree&& other) noexcept
-    : nodes(std::move(other.nodes)),
-      root(other.root),
-      target_level(other.target_level),
-      persistence_threshold(other.persistence_threshold)
+int MergeTree::load(const std::string& path, uint64_t key)
 {
-    other.root = nullptr;
-    other.nodes.clear();
+    ArrayFileReader in;
+    const int status = in.open(path, MERGE_TREE_MAGIC, key, MERGE_TREE_ARRAYS);
+    if (status == 2)
+    {
+        std::cerr << "Merge tree cache " << path << " was built from other pairs." << std::endl;
+        return 1;
+    }
+    MergeTree tree;
+    std::vector<uint32_t> root_array;
+    bool valid = status == 0 && in.read(root_array) && in.read(tree.parent_) && in.read(tree.first_child_) && in.read(tree.next_sibling_)
+        && in.read(tree.birth_) && in.read(tree.death_) && in.read(tree.depth_) && in.read(tree.representative)
+        && in.read(tree.level_start) && in.read(tree.level_nodes) && in.read(tree.persistence_order) && in.read(tree.persistence_cuts);
+
+    // every id must name a node, a corrupted file with an intact header must not index out of range
+    const size_t n = tree.birth_.size();
+    valid = valid && root_array.size() == 1 && tree.parent_.size() == n && tree.first_child_.size() == n && tree.next_sibling_.size() == n
+        && tree.death_.size() == n && tree.depth_.size() == n && tree.representative.size() == n && tree.level_nodes.size() == n && tree.persistence_order.size() == n;
+    valid = valid && valid_ids(tree.parent_, n, true) && valid_ids(tree.first_child_, n, true) && valid_ids(tree.next_sibling_, n, true)
+        && valid_ids(tree.representative, n, false) && valid_ids(tree.level_nodes, n, false) && valid_ids(tree.persistence_order, n, false);
+    valid = valid && (tree.level_start.empty() ? n == 0 : tree.level_start.front() == 0 && tree.level_start.back() == n && std::is_sorted(tree.level_start.begin(), tree.level_start.end()))
+        && std::all_of(tree.depth_.begin(), tree.depth_.end(), [&](int d) { return d >= 0 && size_t(d) + 1 < tree.level_start.size(); });
+    valid = valid && (tree.persistence_cuts.empty() ? n == 0 : tree.persistence_cuts.front() == n && std::is_sorted(tree.persistence_cuts.rbegin(), tree.persistence_cuts.rend()));
+    if (valid)
+    {
+        tree.root = root_array[0];
+        valid = tree.root == NO_NODE || tree.root < n;
+    }
+    if (!valid)
+    {
+        std::cerr << "ERROR: " << path << " is not a valid merge tree cache." << std::endl;
+        return 1;
+    }
+    *this = std::move(tree);
+    return 0;
 }
 
-MergeTree& MergeTree::operator=(MergeTree&& other) noexcept 
+// closest key in compNodes within tolerance of deathVal, the lower one on ties
+std::optional<uint32_t> findCloseKey(const std::map<uint32_t, uint32_t>& compNodes, uint32_t deathVal, uint32_t tol) 
 {
-    if (this != &other) 
+    std::optional<uint32_t> best;
+    auto above = compNodes.lower_bound(deathVal);
+    if (above != compNodes.end() && above->first - deathVal <= tol)
     {
-        // delete current nodes to avoid memory leaks
-        for (auto& [id, node] : nodes) 
+        best = above->first;
+    }
+    if (above != compNodes.begin())
+    {
+        const uint32_t below = std::prev(above)->first;
+        if (deathVal - below <= tol && (!best || deathVal - below <= *best - deathVal))
         {
-            delete node;
+            best = below;
         }
-        nodes = std::move(other.nodes);
-        root = other.root;
-        target_level = other.target_level;
-        persistence_threshold = other.persistence_threshold;
-        other.root = nullptr;
-        other.nodes.clear();
     }
-    return *this;
+    return best;
 }
 
 MergeTree build_merge_tree_with_tolerance(const std::vector<PersistencePair>& persistence_pairs, uint32_t tol) 
 {
     MergeTree merge_tree;
-    uint32_t uniqueId = 1;
-    std::unordered_map<uint32_t, uint32_t> compNodes;
+    merge_tree.reserve(2 * persistence_pairs.size());
+    // ordered by death value, a lookup is a single lower_bound instead of a scan of all components
+    std::map<uint32_t, uint32_t> compNodes;
     
     auto pairs = persistence_pairs;
     std::sort(pairs.begin(), pairs.end(), [](const PersistencePair& a, const PersistencePair& b) {
@@ -163,29 +268,47 @@ MergeTree build_merge_tree_with_tolerance(const std::vector<PersistencePair>& pe
     for (const auto &pair : pairs) 
     {
          // always create a new birth node
-         uint32_t birth_node_id = uniqueId++;
-         merge_tree.add_node(birth_node_id, pair.birth, pair.birth);
+         uint32_t birth_node_id = merge_tree.add_node(pair.birth, pair.birth);
          
          // create a new death node for the merge event
-         uint32_t death_node_id = uniqueId++;
-         merge_tree.add_node(death_node_id, pair.birth, pair.death);
+         uint32_t death_node_id = merge_tree.add_node(pair.birth, pair.death);
          
          // attach the death node as a child of the birth node
          merge_tree.chain_union(birth_node_id, death_node_id);
          
-         // check for a near-equal death value within tolerance
+         // check for a near-equal death value within tolerance, the pair then hangs below that
+         // component with its birth node so the birth to death edge of every pair is kept
          auto keyOpt = findCloseKey(compNodes, pair.death, tol);
          if(keyOpt.has_value()) 
          {
-              uint32_t key = keyOpt.value();
-              merge_tree.chain_union(compNodes[key], death_node_id);
+              auto it = compNodes.find(keyOpt.value());
+              merge_tree.chain_union(it->second, birth_node_id);
               // remove old key and use the current death value
-              compNodes.erase(key);
-              compNodes[pair.death] = death_node_id;
-         } else 
-         {
-              compNodes[pair.death] = death_node_id;
+              compNodes.erase(it);
          }
+         compNodes[pair.death] = death_node_id;
     }
+    merge_tree.build_index();
     return merge_tree;
 }
+
+uint64_t merge_tree_key(const std::vector<PersistencePair>& persistence_pairs, uint32_t tol)
+{
+    // FNV-1a over the pairs and the tolerance
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&](uint32_t value)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            hash ^= (value >> (8 * i)) & 0xff;
+            hash *= 1099511628211ull;
+        }
+    };
+    for (const PersistencePair& pair : persistence_pairs)
+    {
+        mix(pair.birth);
+        mix(pair.death);
+    }
+    mix(tol);
+    return hash;
+}
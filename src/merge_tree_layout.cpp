@@ -0,0 +1,77 @@
+#include "merge_tree_layout.hpp"
+
+#include <algorithm>
+
+MergeTreeLayout layout_merge_tree(const BranchDecomposition& decomposition)
+{
+    MergeTreeLayout layout;
+    const std::vector<Branch>& branches = decomposition.get_branches();
+    const uint32_t n = uint32_t(branches.size());
+    if (n == 0) return layout;
+
+    auto persistence = [&](uint32_t b)
+    {
+        return branches[b].birth > branches[b].death ? branches[b].birth - branches[b].death : branches[b].death - branches[b].birth;
+    };
+    auto more_persistent = [&](uint32_t a, uint32_t b)
+    {
+        return persistence(a) != persistence(b) ? persistence(a) > persistence(b) : a < b;
+    };
+
+    // children lists in one counting pass
+    layout.child_start.assign(n + 1, 0);
+    for (uint32_t b = 0; b < n; ++b)
+    {
+        if (branches[b].parent == NO_NODE) layout.roots.push_back(b);
+        else layout.child_start[branches[b].parent + 1]++;
+    }
+    for (uint32_t b = 0; b < n; ++b) layout.child_start[b + 1] += layout.child_start[b];
+    layout.children.resize(layout.child_start[n]);
+    std::vector<uint32_t> cursor(layout.child_start.begin(), layout.child_start.end() - 1);
+    for (uint32_t b = 0; b < n; ++b)
+    {
+        if (branches[b].parent != NO_NODE) layout.children[cursor[branches[b].parent]++] = b;
+    }
+    for (uint32_t b = 0; b < n; ++b)
+    {
+        std::sort(layout.children.begin() + layout.child_start[b], layout.children.begin() + layout.child_start[b + 1], more_persistent);
+    }
+    std::sort(layout.roots.begin(), layout.roots.end(), more_persistent);
+
+    // a branch always has a larger id than the branch it merges into, so one backward pass sums the subtrees
+    std::vector<uint32_t> subtree_size(n, 1);
+    for (uint32_t b = n; b-- > 0;)
+    {
+        if (branches[b].parent != NO_NODE) subtree_size[branches[b].parent] += subtree_size[b];
+    }
+
+    // and one forward pass places every branch inside the range of its parent
+    layout.column.resize(n);
+    layout.range_begin.resize(n);
+    layout.range_end.resize(n);
+    for (uint32_t root : layout.roots)
+    {
+        layout.range_begin[root] = layout.columns;
+        layout.columns += subtree_size[root];
+    }
+    for (uint32_t b = 0; b < n; ++b)
+    {
+        uint32_t next = layout.range_begin[b];
+        layout.range_end[b] = next + subtree_size[b];
+        const uint32_t* first = layout.children.data() + layout.child_start[b];
+        const uint32_t count = layout.child_start[b + 1] - layout.child_start[b];
+        // columns run ... c3 c1 b c0 c2 ...
+        for (uint32_t i = (count % 2 == 0 ? count : count - 1); i >= 2; i -= 2)
+        {
+            layout.range_begin[first[i - 1]] = next;
+            next += subtree_size[first[i - 1]];
+        }
+        layout.column[b] = next++;
+        for (uint32_t i = 0; i < count; i += 2)
+        {
+            layout.range_begin[first[i]] = next;
+            next += subtree_size[first[i]];
+        }
+    }
+    return layout;
+}
@@ -3,7 +3,7 @@
 #include <algorithm>
 #include <limits>
 #include "volume.hpp"
-#include "merge_tree.hpp"
+#include "volume_layout.hpp"
 
 BoundaryMatrix::BoundaryMatrix(uint32_t num_cols) : num_cols_(num_cols), matrix_(num_cols, std::vector<uint32_t>()), dims_(num_cols, 0) {}
 
@@ -22,6 +22,7 @@ void BoundaryMatrix::set_col(uint32_t col_idx, const std::vector<uint32_t>& entr
     if (col_idx < num_cols_) 
     {
         matrix_[col_idx] = entries;
+        std::sort(matrix_[col_idx].begin(), matrix_[col_idx].end());
     }
 }
 
@@ -41,9 +42,27 @@ std::vector<uint32_t> BoundaryMatrix::get_col(uint32_t col_idx) const
     return {};
 }
 
+// return the number of column additions of the last reduction
+uint64_t BoundaryMatrix::get_column_additions() const
+{
+    return column_additions_;
+}
+
+const char* reduction_engine_name(ReductionEngine engine)
+{
+    switch (engine)
+    {
+        case ReductionEngine::Standard: return "standard";
+        case ReductionEngine::SortedMerge: return "sorted_merge";
+        case ReductionEngine::Heap: return "heap";
+    }
+    return "unknown";
+}
+
 // add entries from one column to another (mod 2 addition)
 void BoundaryMatrix::add_to(uint32_t source_col, uint32_t target_col) 
 {
+    ++column_additions_;
     for (uint32_t entry : matrix_[source_col]) 
     {
         auto it = std::find(matrix_[target_col].begin(), matrix_[target_col].end(), entry);
@@ -57,6 +76,17 @@ void BoundaryMatrix::add_to(uint32_t source_col, uint32_t target_col)
     std::sort(matrix_[target_col].begin(), matrix_[target_col].end());
 }
 
+// mod 2 addition of two sorted columns in a single linear merge
+void BoundaryMatrix::add_to_sorted(uint32_t source_col, uint32_t target_col, std::vector<uint32_t>& scratch)
+{
+    ++column_additions_;
+    const auto& source = matrix_[source_col];
+    auto& target = matrix_[target_col];
+    scratch.clear();
+    std::set_symmetric_difference(target.begin(), target.end(), source.begin(), source.end(), std::back_inserter(scratch));
+    target.swap(scratch);
+}
+
 // finalize a column (produces a canonical copy)
 void BoundaryMatrix::finalize(uint32_t col_idx) 
 {
@@ -64,15 +94,24 @@ void BoundaryMatrix::finalize(uint32_t col_idx)
     matrix_[col_idx].swap(temp);
 }
 
-// perform the reduction
-std::vector<PersistencePair> BoundaryMatrix::reduce() 
+// perform the reduction with the selected engine
+std::vector<PersistencePair> BoundaryMatrix::reduce(ReductionEngine engine)
+{
+    column_additions_ = 0;
+    switch (engine)
+    {
+        case ReductionEngine::SortedMerge: return reduce_sorted_merge();
+        case ReductionEngine::Heap: return reduce_heap();
+        default: return reduce_standard();
+    }
+}
+
+std::vector<PersistencePair> BoundaryMatrix::reduce_standard()
 {
     std::vector<PersistencePair> pairs;
     const uint32_t EMPTY = std::numeric_limits<uint32_t>::max();
     std::vector<uint32_t> lowest_one_lookup(num_cols_, EMPTY);
 
-    MergeTree merge_tree;
-
     for (uint32_t cur_col = 0; cur_col < num_cols_; ++cur_col) 
     {
         if (!matrix_[cur_col].empty()) 
@@ -95,22 +134,103 @@ std::vector<PersistencePair> BoundaryMatrix::reduce()
             {
                 lowest_one_lookup[lowest_one] = cur_col;
                 pairs.emplace_back(lowest_one, cur_col);
-
-                if (merge_tree.get_all_nodes().find(lowest_one) == merge_tree.get_all_nodes().end()) 
-                {
-                    merge_tree.add_node(lowest_one, lowest_one, lowest_one);
-                }
-                if (merge_tree.get_all_nodes().find(cur_col) == merge_tree.get_all_nodes().end()) 
-                {
-                    merge_tree.add_node(cur_col, lowest_one, cur_col);
-                }
-                merge_tree.union_nodes(lowest_one, cur_col);
             }
         }
         finalize(cur_col);
     }
     return pairs;
 }
+
+// columns stay sorted, so the pivot is the last entry and every addition is one merge
+std::vector<PersistencePair> BoundaryMatrix::reduce_sorted_merge()
+{
+    std::vector<PersistencePair> pairs;
+    const uint32_t EMPTY = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> lowest_one_lookup(num_cols_, EMPTY);
+    std::vector<uint32_t> scratch;
+
+    for (uint32_t cur_col = 0; cur_col < num_cols_; ++cur_col)
+    {
+        auto& col = matrix_[cur_col];
+        while (!col.empty() && lowest_one_lookup[col.back()] != EMPTY)
+        {
+            add_to_sorted(lowest_one_lookup[col.back()], cur_col, scratch);
+        }
+        if (!col.empty())
+        {
+            lowest_one_lookup[col.back()] = cur_col;
+            pairs.emplace_back(col.back(), cur_col);
+        }
+    }
+    return pairs;
+}
+
+// additions are pushed lazily onto a max-heap; equal entries cancel when they are popped
+std::vector<PersistencePair> BoundaryMatrix::reduce_heap()
+{
+    std::vector<PersistencePair> pairs;
+    const uint32_t EMPTY = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> lowest_one_lookup(num_cols_, EMPTY);
+    std::vector<uint32_t> heap;
+
+    auto pop_pivot = [&heap, EMPTY]() -> uint32_t
+    {
+        while (!heap.empty())
+        {
+            std::pop_heap(heap.begin(), heap.end());
+            uint32_t top = heap.back();
+            heap.pop_back();
+            if (!heap.empty() && heap.front() == top)
+            {
+                std::pop_heap(heap.begin(), heap.end());
+                heap.pop_back();
+            }
+            else
+            {
+                return top;
+            }
+        }
+        return EMPTY;
+    };
+
+    for (uint32_t cur_col = 0; cur_col < num_cols_; ++cur_col)
+    {
+        auto& col = matrix_[cur_col];
+        if (col.empty()) continue;
+
+        heap.assign(col.begin(), col.end());
+        std::make_heap(heap.begin(), heap.end());
+        uint32_t pivot = pop_pivot();
+        while (pivot != EMPTY && lowest_one_lookup[pivot] != EMPTY)
+        {
+            ++column_additions_;
+            // the pivot cancels against the source column's pivot, only the remainder is pushed
+            const auto& source = matrix_[lowest_one_lookup[pivot]];
+            for (size_t i = 0; i + 1 < source.size(); ++i)
+            {
+                heap.push_back(source[i]);
+                std::push_heap(heap.begin(), heap.end());
+            }
+            pivot = pop_pivot();
+        }
+
+        // write back the canonical column, later columns add it
+        col.clear();
+        if (pivot != EMPTY)
+        {
+            std::sort(heap.begin(), heap.end());
+            for (size_t i = 0; i < heap.size(); ++i)
+            {
+                if (i + 1 < heap.size() && heap[i] == heap[i + 1]) ++i;
+                else col.push_back(heap[i]);
+            }
+            col.push_back(pivot);
+            lowest_one_lookup[pivot] = cur_col;
+            pairs.emplace_back(pivot, cur_col);
+        }
+    }
+    return pairs;
+}
 // create the boundary matrix from the volume
 std::pair<BoundaryMatrix, std::vector<int>> create_boundary_matrix(const Volume& volume, FiltrationMode mode)
 {
@@ -133,6 +253,13 @@ std::pair<BoundaryMatrix, std::vector<int>> create_boundary_matrix(const Volume&
         return z * dim_y * dim_x + y * dim_x + x;
     };
 
+    // cells are numbered in linear order, the values are read in the layout of the volume
+    const VoxelAddressing at(volume);
+    auto value = [&](uint32_t x, uint32_t y, uint32_t z) -> uint8_t
+    {
+        return volume.data[at(x, y, z)];
+    };
+
     // for vertices, the filtration value is just the voxel's intensity
     for (uint32_t z = 0; z < dim_z; ++z) 
     {
@@ -140,8 +267,7 @@ std::pair<BoundaryMatrix, std::vector<int>> create_boundary_matrix(const Volume&
         {
             for (uint32_t x = 0; x < dim_x; ++x) 
             {
-                uint32_t voxel_idx = index(x, y, z);
-                filtration_values.push_back(volume.data[voxel_idx]);
+                filtration_values.push_back(value(x, y, z));
             }
         }
     }
@@ -170,21 +296,21 @@ std::pair<BoundaryMatrix, std::vector<int>> create_boundary_matrix(const Volume&
                 {
                     uint32_t neighbor = index(x + 1, y, z);
                     edges.push_back({voxel_idx, neighbor});
-                    filtration_values.push_back(combine({volume.data[voxel_idx], volume.data[neighbor]}));
+                    filtration_values.push_back(combine({value(x, y, z), value(x + 1, y, z)}));
                     num_edges++;
                 }
                 if (y < dim_y - 1)
                 {
                     uint32_t neighbor = index(x, y + 1, z);
                     edges.push_back({voxel_idx, neighbor});
-                    filtration_values.push_back(combine({volume.data[voxel_idx], volume.data[neighbor]}));
+                    filtration_values.push_back(combine({value(x, y, z), value(x, y + 1, z)}));
                     num_edges++;
                 }
                 if (z < dim_z - 1)
                 {
                     uint32_t neighbor = index(x, y, z + 1);
                     edges.push_back({voxel_idx, neighbor});
-                    filtration_values.push_back(combine({volume.data[voxel_idx], volume.data[neighbor]}));
+                    filtration_values.push_back(combine({value(x, y, z), value(x, y, z + 1)}));
                     num_edges++;
                 }
             }
@@ -201,17 +327,17 @@ std::pair<BoundaryMatrix, std::vector<int>> create_boundary_matrix(const Volume&
                 uint32_t voxel_idx = index(x, y, z);
                 // x-y plane
                 faces.push_back({voxel_idx, index(x + 1, y, z), index(x, y + 1, z), index(x + 1, y + 1, z)});
-                filtration_values.push_back(combine({volume.data[voxel_idx], volume.data[index(x + 1, y, z)], volume.data[index(x, y + 1, z)], volume.data[index(x + 1, y + 1, z)]}));
+                filtration_values.push_back(combine({value(x, y, z), value(x + 1, y, z), value(x, y + 1, z), value(x + 1, y + 1, z)}));
                 num_faces++;
 
                 // y-z plane
                 faces.push_back({voxel_idx, index(x, y + 1, z), index(x, y, z + 1), index(x, y + 1, z + 1)});
-                filtration_values.push_back(combine({volume.data[voxel_idx], volume.data[index(x, y + 1, z)], volume.data[index(x, y, z + 1)], volume.data[index(x, y + 1, z + 1)]}));
+                filtration_values.push_back(combine({value(x, y, z), value(x, y + 1, z), value(x, y, z + 1), value(x, y + 1, z + 1)}));
                 num_faces++;
 
                 // x-z plane
                 faces.push_back({voxel_idx, index(x + 1, y, z), index(x, y, z + 1), index(x + 1, y, z + 1)});
-                filtration_values.push_back(combine({volume.data[voxel_idx], volume.data[index(x + 1, y, z)], volume.data[index(x, y, z + 1)], volume.data[index(x + 1, y, z + 1)]}));
+                filtration_values.push_back(combine({value(x, y, z), value(x + 1, y, z), value(x, y, z + 1), value(x + 1, y, z + 1)}));
                 num_faces++;
             }
         }
@@ -229,14 +355,14 @@ std::pair<BoundaryMatrix, std::vector<int>> create_boundary_matrix(const Volume&
                                    index(x, y, z + 1), index(x + 1, y, z + 1), index(x, y + 1, z + 1), index(x + 1, y + 1, z + 1)});
                 filtration_values.push_back(combine(
                 {
-                    volume.data[voxel_idx],
-                    volume.data[index(x + 1, y, z)],
-                    volume.data[index(x, y + 1, z)],
-                    volume.data[index(x + 1, y + 1, z)],
-                    volume.data[index(x, y, z + 1)],
-                    volume.data[index(x + 1, y, z + 1)],
-                    volume.data[index(x, y + 1, z + 1)],
-                    volume.data[index(x + 1, y + 1, z + 1)]
+                    value(x, y, z),
+                    value(x + 1, y, z),
+                    value(x, y + 1, z),
+                    value(x + 1, y + 1, z),
+                    value(x, y, z + 1),
+                    value(x + 1, y, z + 1),
+                    value(x, y + 1, z + 1),
+                    value(x + 1, y + 1, z + 1)
                 }));
                 num_voxels++;
             }
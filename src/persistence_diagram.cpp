@@ -0,0 +1,237 @@
+#include "persistence_diagram.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace
+{
+constexpr uint32_t GRID = 256;
+
+// generic run length compression for values outside of the dense grid
+template<class Map>
+AggregatedDiagram aggregate_sorted(size_t n, Map map)
+{
+    std::vector<PersistencePair> sorted(n);
+    #pragma omp parallel for schedule(static)
+    for (int64_t i = 0; i < int64_t(n); ++i) sorted[i] = map(size_t(i));
+    std::sort(sorted.begin(), sorted.end(), [](const PersistencePair& a, const PersistencePair& b)
+    {
+        return a.birth != b.birth ? a.birth < b.birth : a.death < b.death;
+    });
+
+    AggregatedDiagram diagram;
+    diagram.total_pairs = n;
+    for (const PersistencePair& p : sorted)
+    {
+        if (!diagram.points.empty() && diagram.points.back().birth == p.birth && diagram.points.back().death == p.death)
+        {
+            diagram.multiplicity.back()++;
+        }
+        else
+        {
+            diagram.points.push_back(p);
+            diagram.multiplicity.push_back(1);
+        }
+    }
+    return diagram;
+}
+
+// counts every point in a dense 256 x 256 grid, falls back to sorting if a value does not fit
+template<class Map>
+AggregatedDiagram aggregate(size_t n, Map map)
+{
+    std::vector<uint32_t> counts(GRID * GRID, 0);
+    bool in_range = true;
+
+    #pragma omp parallel reduction(&&: in_range)
+    {
+        std::vector<uint32_t> local(GRID * GRID, 0);
+        #pragma omp for schedule(static) nowait
+        for (int64_t i = 0; i < int64_t(n); ++i)
+        {
+            const PersistencePair p = map(size_t(i));
+            if (p.birth >= GRID || p.death >= GRID)
+            {
+                in_range = false;
+                continue;
+            }
+            local[p.birth * GRID + p.death]++;
+        }
+        #pragma omp critical
+        for (uint32_t c = 0; c < GRID * GRID; ++c) counts[c] += local[c];
+    }
+    if (!in_range) return aggregate_sorted(n, map);
+
+    AggregatedDiagram diagram;
+    diagram.total_pairs = n;
+    for (uint32_t c = 0; c < GRID * GRID; ++c)
+    {
+        if (counts[c] == 0) continue;
+        diagram.points.emplace_back(c / GRID, c % GRID);
+        diagram.multiplicity.push_back(counts[c]);
+    }
+    return diagram;
+}
+} // namespace
+
+AggregatedDiagram aggregate_pairs(const std::vector<PersistencePair>& raw_pairs, const std::vector<int>& filtration_values)
+{
+    return aggregate(raw_pairs.size(), [&](size_t i)
+    {
+        const PersistencePair& p = raw_pairs[i];
+        return PersistencePair(uint32_t(filtration_values[p.birth]), uint32_t(filtration_values[p.death]));
+    });
+}
+
+AggregatedDiagram aggregate_pairs(const std::vector<PersistencePair>& pairs)
+{
+    return aggregate(pairs.size(), [&](size_t i) { return pairs[i]; });
+}
+
+PersistenceDiagram::PersistenceDiagram(AggregatedDiagram diagram) : data(std::move(diagram))
+{
+    build_index();
+}
+
+PersistenceDiagram::PersistenceDiagram(const std::vector<PersistencePair>& pairs) : data(aggregate_pairs(pairs))
+{
+    build_index();
+}
+
+void PersistenceDiagram::build_index()
+{
+    const uint32_t n = uint32_t(data.points.size());
+
+    by_persistence.resize(n);
+    std::iota(by_persistence.begin(), by_persistence.end(), 0u);
+    std::stable_sort(by_persistence.begin(), by_persistence.end(), [&](uint32_t a, uint32_t b)
+    {
+        return persistence(data.points[a]) < persistence(data.points[b]);
+    });
+    persistence_keys.resize(n);
+    for (uint32_t i = 0; i < n; ++i) persistence_keys[i] = persistence(data.points[by_persistence[i]]);
+
+    by_birth.resize(n);
+    std::iota(by_birth.begin(), by_birth.end(), 0u);
+    std::stable_sort(by_birth.begin(), by_birth.end(), [&](uint32_t a, uint32_t b)
+    {
+        return data.points[a].birth < data.points[b].birth;
+    });
+    birth_keys.resize(n);
+    for (uint32_t i = 0; i < n; ++i) birth_keys[i] = data.points[by_birth[i]].birth;
+
+    grid_dim = 0;
+    cell_start.clear();
+    cell_points.clear();
+    if (n == 0) return;
+
+    // bounding box of the points, split into at most MAX_GRID_DIM cells per axis
+    uint32_t max_birth = 0, max_death = 0;
+    origin_birth = origin_death = std::numeric_limits<uint32_t>::max();
+    for (const PersistencePair& p : data.points)
+    {
+        origin_birth = std::min(origin_birth, p.birth);
+        origin_death = std::min(origin_death, p.death);
+        max_birth = std::max(max_birth, p.birth);
+        max_death = std::max(max_death, p.death);
+    }
+    const uint64_t extent = uint64_t(std::max(max_birth - origin_birth, max_death - origin_death)) + 1;
+    cell_size = uint32_t((extent + MAX_GRID_DIM - 1) / MAX_GRID_DIM);
+    grid_dim = uint32_t((extent + cell_size - 1) / cell_size);
+
+    // counting sort of the point indices into their cells
+    cell_start.assign(size_t(grid_dim) * grid_dim + 1, 0);
+    auto cell_of = [&](const PersistencePair& p)
+    {
+        return size_t((p.death - origin_death) / cell_size) * grid_dim + (p.birth - origin_birth) / cell_size;
+    };
+    for (const PersistencePair& p : data.points) cell_start[cell_of(p) + 1]++;
+    for (size_t c = 1; c < cell_start.size(); ++c) cell_start[c] += cell_start[c - 1];
+    cell_points.resize(n);
+    std::vector<uint32_t> fill(cell_start.begin(), cell_start.end() - 1);
+    for (uint32_t i = 0; i < n; ++i) cell_points[fill[cell_of(data.points[i])]++] = i;
+}
+
+uint32_t PersistenceDiagram::max_persistence() const
+{
+    return persistence_keys.empty() ? 0 : persistence_keys.back();
+}
+
+size_t PersistenceDiagram::most_persistent() const
+{
+    return by_persistence.empty() ? size() : by_persistence.back();
+}
+
+std::span<const uint32_t> PersistenceDiagram::persistence_at_least(uint32_t min_persistence) const
+{
+    auto it = std::lower_bound(persistence_keys.begin(), persistence_keys.end(), min_persistence);
+    const size_t first = size_t(it - persistence_keys.begin());
+    return std::span<const uint32_t>(by_persistence).subspan(first);
+}
+
+std::span<const uint32_t> PersistenceDiagram::diagonal_distance_at_least(float min_distance) const
+{
+    // the euclidean distance from the line death = birth is persistence / sqrt(2), monotone in the persistence
+    const float sqrt2 = std::sqrt(2.0f);
+    auto it = std::partition_point(persistence_keys.begin(), persistence_keys.end(), [&](uint32_t pers)
+    {
+        return float(pers) / sqrt2 < min_distance;
+    });
+    const size_t first = size_t(it - persistence_keys.begin());
+    return std::span<const uint32_t>(by_persistence).subspan(first);
+}
+
+std::span<const uint32_t> PersistenceDiagram::birth_between(uint32_t lo, uint32_t hi) const
+{
+    if (lo > hi) return {};
+    auto first = std::lower_bound(birth_keys.begin(), birth_keys.end(), lo);
+    auto last = std::upper_bound(first, birth_keys.end(), hi);
+    return std::span<const uint32_t>(by_birth).subspan(size_t(first - birth_keys.begin()), size_t(last - first));
+}
+
+std::vector<uint32_t> PersistenceDiagram::range(uint32_t birth_lo, uint32_t birth_hi, uint32_t death_lo, uint32_t death_hi) const
+{
+    std::vector<uint32_t> result;
+    if (grid_dim == 0 || birth_lo > birth_hi || death_lo > death_hi) return result;
+
+    // clamp the query to the grid, cells outside of the bounding box are empty
+    auto cell_range = [&](uint32_t lo, uint32_t hi, uint32_t origin, uint32_t& c0, uint32_t& c1)
+    {
+        if (hi < origin) return false;
+        c0 = lo <= origin ? 0 : (lo - origin) / cell_size;
+        c1 = std::min(grid_dim - 1, (hi - origin) / cell_size);
+        return c0 < grid_dim;
+    };
+    uint32_t bx0, bx1, dy0, dy1;
+    if (!cell_range(birth_lo, birth_hi, origin_birth, bx0, bx1) || !cell_range(death_lo, death_hi, origin_death, dy0, dy1)) return result;
+
+    for (uint32_t cy = dy0; cy <= dy1; ++cy)
+    {
+        for (uint32_t cx = bx0; cx <= bx1; ++cx)
+        {
+            const size_t c = size_t(cy) * grid_dim + cx;
+            for (uint32_t k = cell_start[c]; k < cell_start[c + 1]; ++k)
+            {
+                const PersistencePair& p = data.points[cell_points[k]];
+                if (p.birth >= birth_lo && p.birth <= birth_hi && p.death >= death_lo && p.death <= death_hi) result.push_back(cell_points[k]);
+            }
+        }
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+std::shared_ptr<const PairStore> PairStore::create(std::vector<PersistencePair>&& raw_pairs, std::vector<int>&& filtration_values)
+{
+    auto store = std::make_shared<PairStore>();
+    store->raw = std::move(raw_pairs);
+    store->filtration = std::move(filtration_values);
+    store->diagram = PersistenceDiagram(aggregate_pairs(store->raw, store->filtration));
+    return store;
+}
@@ -19,11 +19,15 @@ void RayMarcher::setup_storage(AppState& app_state, const Volume& volume, const
   
   buffers[RAY_MARCHER_BUFFER_1] = storage.add_buffer("ray_marcher_output_1", initial_ray_macher_data, vk::BufferUsageFlagBits::eStorageBuffer, false, QueueFamilyFlags::Transfer | QueueFamilyFlags::Compute);
   
-  buffers[VOLUME_BUFFER] = storage.add_buffer("volume", volume.data, vk::BufferUsageFlagBits::eStorageBuffer, false, QueueFamilyFlags::Transfer | QueueFamilyFlags::Compute);
+  buffers[VOLUME_BUFFER] = storage.add_buffer("volume", volume.data.data(), volume.data.size(), vk::BufferUsageFlagBits::eStorageBuffer, false, QueueFamilyFlags::Transfer | QueueFamilyFlags::Compute);
 
   buffers[TF_BUFFER] = storage.add_buffer("transfer_function", AppState::TF2D_BINS * AppState::TF2D_BINS * sizeof(glm::vec4), vk::BufferUsageFlagBits::eStorageBuffer, false, QueueFamilyFlags::Transfer | QueueFamilyFlags::Compute);
 
-  buffers[GRADIENT_VOLUME_BUFFER] = storage.add_buffer("gradient_volume", gradient_volume.data, vk::BufferUsageFlagBits::eStorageBuffer, false, QueueFamilyFlags::Transfer | QueueFamilyFlags::Compute);
+  buffers[GRADIENT_VOLUME_BUFFER] = storage.add_buffer("gradient_volume", gradient_volume.data.data(), gradient_volume.data.size(), vk::BufferUsageFlagBits::eStorageBuffer, false, QueueFamilyFlags::Transfer | QueueFamilyFlags::Compute);
+
+  // 1 per voxel that is rendered while a branch segmentation is active
+  std::vector<uint8_t> initial_segment_mask(volume.data.size(), 1);
+  buffers[SEGMENT_MASK_BUFFER] = storage.add_buffer("segment_mask", initial_segment_mask, vk::BufferUsageFlagBits::eStorageBuffer, false, QueueFamilyFlags::Transfer | QueueFamilyFlags::Compute);
 
   buffers[UNIFORM_BUFFER] = storage.add_buffer("ray_marcher_uniform_buffer", sizeof(Camera::Data), vk::BufferUsageFlagBits::eUniformBuffer, false, QueueFamilyFlags::Transfer | QueueFamilyFlags::Compute);
   app_state.cam.update();
@@ -73,6 +77,8 @@ void RayMarcher::compute(vk::CommandBuffer& cb, AppState& app_state, uint32_t re
   pc.display_mode = app_state.display_mode;
   pc.max_gradient = app_state.max_gradient;
   pc.density_threshold = app_state.density_threshold;
+  pc.use_segment_mask = app_state.segmented_branch >= 0 ? 1 : 0;
+  pc.loaded_slices = app_state.loaded_slices;
   cb.pushConstants(pipeline.get_layout(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(PushConstants), &pc);
   cb.dispatch((app_state.get_render_extent().width + 31) / 32, (app_state.get_render_extent().height + 31) / 32, 1);
 }
@@ -99,6 +105,7 @@ void RayMarcher::create_descriptor_set()
   dsh.add_binding(4, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute);
   dsh.add_binding(5, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute);
   dsh.add_binding(6, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute);
+  dsh.add_binding(7, vk::DescriptorType::eStorageBuffer, vk::ShaderStageFlagBits::eCompute);
   
   for (uint32_t i = 0; i < frames_in_flight; ++i)
   {
@@ -111,6 +118,7 @@ void RayMarcher::create_descriptor_set()
     dsh.add_descriptor(i, 4, storage.get_buffer_by_name("ray_marcher_output_" + std::to_string(i)));
     dsh.add_descriptor(i, 5, storage.get_buffer_by_name("ray_marcher_output_" + std::to_string(1 - i)));
     dsh.add_descriptor(i, 6, storage.get_buffer_by_name("gradient_volume"));
+    dsh.add_descriptor(i, 7, storage.get_buffer_by_name("segment_mask"));
   }
   dsh.construct();
 }
@@ -2,49 +2,31 @@
 
 #include <algorithm>
 
-std::vector<PersistencePair> threshold_cut(const std::vector<PersistencePair>& pairs, uint32_t threshold) 
+namespace
 {
-    // The pairs vector must be sorted in ascending order by persistence.
-    auto comp = [threshold](const PersistencePair& p, uint32_t thresh) -> bool
-    {
-        uint32_t pers = (p.death > p.birth ? p.death - p.birth : 0);
-        return pers < thresh;
-    };
-    auto it = std::lower_bound(pairs.begin(), pairs.end(), threshold, comp);
-    std::vector<PersistencePair> result(it, pairs.end());
+std::vector<PersistencePair> gather(const PersistenceDiagram& diagram, std::span<const uint32_t> idxs)
+{
+    std::vector<PersistencePair> result;
+    result.reserve(idxs.size());
+    for (uint32_t i : idxs) result.push_back(diagram[i]);
     return result;
 }
+} // namespace
 
-// keep only those pairs whose distance from the diagonal is >= minDistance
-std::vector<PersistencePair> diagonal_distance_cut(const std::vector<PersistencePair>& pairs, float minDistance)
+// keep only those pairs whose persistence is >= threshold
+std::vector<PersistencePair> threshold_cut(const PersistenceDiagram& diagram, uint32_t threshold)
 {
-    std::vector<PersistencePair> result;
-    float sqrt2 = std::sqrt(2.0f);
-    for (const auto &p : pairs)
-    {
-        float pers = (p.death > p.birth) ? (p.death - p.birth) : 0.0f;
-
-        // euclidean distance from the line death=birth is pers / sqrt(2)
-        float distFromDiagonal = pers / sqrt2;
+    return gather(diagram, diagram.persistence_at_least(threshold));
+}
 
-        // keep only pairs with distance >= minDistance
-        if (distFromDiagonal >= minDistance)
-        {
-            result.push_back(p);
-        }
-    }
-    return result;
+// keep only those pairs whose distance from the diagonal is >= minDistance
+std::vector<PersistencePair> diagonal_distance_cut(const PersistenceDiagram& diagram, float minDistance)
+{
+    return gather(diagram, diagram.diagonal_distance_at_least(minDistance));
 }
 
-std::vector<PersistencePair> filter_non_egenerate(const std::vector<PersistencePair>& pairs, uint32_t minPersistence)
+// keep only those pairs with death > birth + minPersistence
+std::vector<PersistencePair> filter_non_degenerate(const PersistenceDiagram& diagram, uint32_t minPersistence)
 {
-    std::vector<PersistencePair> filtered;
-    for (const auto& p : pairs)
-    {
-        if (p.death > p.birth + minPersistence)
-        {
-            filtered.push_back(p);
-        }
-    }
-    return filtered;
+    return gather(diagram, diagram.persistence_at_least(minPersistence + 1));
 }
@@ -1,5 +1,6 @@
 #include "transfer_function.hpp"
 #include "app_state.hpp"
+#include "volume_stats.hpp"
 #include "glm/vec3.hpp"
 #include <algorithm>
 #include <limits>
@@ -10,42 +11,28 @@
 
 std::pair<uint32_t, uint32_t> TransferFunction::compute_min_max_scalar(const Volume& volume)
 {
-  // parallel reduction to compute min and max scalar value in the volume
-  uint32_t min_value = std::numeric_limits<uint32_t>::max();
-  uint32_t max_value = std::numeric_limits<uint32_t>::min();
-
-  #pragma omp parallel for reduction(min: min_value) reduction(max: max_value)
-  for (size_t i = 0; i < volume.data.size(); ++i)
-  {
-    uint32_t v = volume.data[i];
-    min_value = std::min(min_value, v);
-    max_value = std::max(max_value, v);
-  }
-  return {min_value, max_value};
+  // cached on the volume, only the first update scans the voxels
+  const VolumeStats& stats = volume_stats(volume);
+  return {stats.min, stats.max};
 }
 
-void TransferFunction::update(const std::vector<PersistencePair>& pairs, const Volume& volume, std::vector<glm::vec4>& tf_data)
+void TransferFunction::update(const PersistenceDiagram& diagram, const Volume& volume, std::vector<glm::vec4>& tf_data)
 {
   // compute volume scalar range
   auto [vol_min, vol_max] = compute_min_max_scalar(volume);
   float span = float(vol_max > vol_min ? (vol_max - vol_min) : 1);
 
   tf_data.assign(AppState::TF2D_BINS * AppState::TF2D_BINS, glm::vec4(0.0f));
- 
-  // find max persistence in parallel
-  uint32_t max_pers = 1;
-  #pragma omp parallel for reduction(max: max_pers)
-  for (size_t i = 0; i < pairs.size(); ++i)
-  {
-    const auto &p = pairs[i];
-    uint32_t pers = (p.death > p.birth ? p.death - p.birth : 0);
-    max_pers = std::max(max_pers, pers);
-  }
+
+  // the diagram holds every distinct point once, repeated pairs would paint the same brush again
+  const std::vector<PersistencePair>& pairs = diagram.points();
+  uint32_t max_pers = std::max(1u, diagram.max_persistence());
 
   // precompute brush entries (bi, di, rgb)
   struct Brush
   {
     uint32_t bi, di; 
+    uint32_t pers;
     glm::vec3 rgb;
     float a;
   };
@@ -66,29 +53,83 @@ void TransferFunction::update(const std::vector<PersistencePair>& pairs, const V
     uint32_t di = uint32_t(std::clamp(nd, 0.0f, 1.0f) * float(AppState::TF2D_BINS - 1));
     if (bi > di) std::swap(bi, di);
 
-    brushes.push_back({bi, di, rgb, a});
+    brushes.push_back({bi, di, pers, rgb, a});
+  }
+  // paint the most persistent features last so they stay on top
+  std::stable_sort(brushes.begin(), brushes.end(), [](const Brush& a, const Brush& b) { return a.pers < b.pers; });
+
+  // the brushes do not depend on the gradient axis, paint one row and replicate it
+  std::vector<glm::vec4> row(AppState::TF2D_BINS, glm::vec4(0.0f));
+  for (const auto &br : brushes)
+  {
+    glm::vec4 src{ br.rgb, br.a };
+    float invA = 1.0f - src.w;
+    for (uint32_t x = br.bi; x <= br.di; ++x)
+    {
+      auto &dst = row[x];
+      dst.x = src.w * src.x + invA * dst.x;
+      dst.y = src.w * src.y + invA * dst.y;
+      dst.z = src.w * src.z + invA * dst.z;
+      dst.w = src.w + invA * dst.w;
+    }
   }
 
-  // parallel paint by row
   #pragma omp parallel for schedule(static)
-  for (int g = 0; g < AppState::TF2D_BINS; ++g)
+  for (int g = 0; g < int(AppState::TF2D_BINS); ++g)
   {
-    auto row_begin = tf_data.data() + g * AppState::TF2D_BINS;
-    for (const auto &br : brushes)
+    std::copy(row.begin(), row.end(), tf_data.begin() + size_t(g) * AppState::TF2D_BINS);
+  }
+}
+
+void TransferFunction::update(const BranchDecomposition& branches, const BranchSegmentation& segmentation, const Volume& volume, std::vector<glm::vec4>& tf_data)
+{
+  auto [vol_min, vol_max] = compute_min_max_scalar(volume);
+  float span = float(vol_max > vol_min ? (vol_max - vol_min) : 1);
+  auto to_bin = [&](uint32_t value)
+  {
+    float n = (float(value) - float(vol_min)) / span;
+    return uint32_t(std::clamp(n, 0.0f, 1.0f) * float(AppState::TF2D_BINS - 1));
+  };
+
+  tf_data.assign(AppState::TF2D_BINS * AppState::TF2D_BINS, glm::vec4(0.0f));
+  const std::vector<Branch>& all = branches.get_branches();
+  uint32_t max_pers = 1;
+  for (const Branch& b : all) max_pers = std::max(max_pers, b.birth > b.death ? b.birth - b.death : b.death - b.birth);
+
+  std::vector<uint32_t> order(all.size());
+  for (uint32_t i = 0; i < order.size(); ++i) order[i] = i;
+  auto persistence = [&](uint32_t i) { return all[i].birth > all[i].death ? all[i].birth - all[i].death : all[i].death - all[i].birth; };
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return persistence(a) < persistence(b); });
+
+  std::vector<glm::vec4> row(AppState::TF2D_BINS, glm::vec4(0.0f));
+  for (uint32_t id : order)
+  {
+    uint32_t lo = std::min(all[id].birth, all[id].death), hi = std::max(all[id].birth, all[id].death);
+    if (id < segmentation.regions.size())
+    {
+      const BranchRegion& region = segmentation.regions[id];
+      // a branch without voxels of its own has nothing to color
+      if (region.voxel_count == 0) continue;
+      lo = region.min_value;
+      hi = region.max_value;
+    }
+    // golden angle steps keep neighbouring branch ids apart in hue
+    const glm::vec3 rgb = hsv2rgb(std::fmod(float(id) * 137.508f, 360.0f), 0.8f, 1.0f);
+    const float a = 0.25f + 0.75f * float(persistence(id)) / float(max_pers);
+    const float invA = 1.0f - a;
+    for (uint32_t x = to_bin(lo); x <= to_bin(hi); ++x)
     {
-      glm::vec4 src{ br.rgb, br.a };
-
-      for (uint32_t x = br.bi; x <= br.di; ++x)
-      {
-        auto &dst = row_begin[x];
-        float invA = 1.0f - src.w;
-
-        dst.x = src.w * src.x + invA * dst.x;
-        dst.y = src.w * src.y + invA * dst.y;
-        dst.z = src.w * src.z + invA * dst.z;
-        dst.w = src.w + invA * dst.w;
-      }
+      auto &dst = row[x];
+      dst.x = a * rgb.x + invA * dst.x;
+      dst.y = a * rgb.y + invA * dst.y;
+      dst.z = a * rgb.z + invA * dst.z;
+      dst.w = a + invA * dst.w;
     }
   }
+
+  #pragma omp parallel for schedule(static)
+  for (int g = 0; g < int(AppState::TF2D_BINS); ++g)
+  {
+    std::copy(row.begin(), row.end(), tf_data.begin() + size_t(g) * AppState::TF2D_BINS);
+  }
 }
- 
\ No newline at end of file
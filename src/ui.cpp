@@ -2,6 +2,7 @@
 #include "imgui.h"
 #include "backends/imgui_impl_vulkan.h"
 #include "backends/imgui_impl_sdl3.h"
+#include <algorithm>
 #include <cmath>
 #include <limits>
 #include <implot.h> 
@@ -13,6 +14,7 @@
 #include "persistence.hpp"
 #include "merge_tree.hpp"
 #include "volume.hpp"
+#include "volume_stats.hpp"
 
 namespace ve {
 
@@ -83,11 +85,14 @@ void UI::set_volume(const Volume* volume)
     this->volume = volume;
 }
 
-void UI::set_persistence_pairs(const std::vector<PersistencePair>* pairs)
+void UI::set_persistence_diagram(const PersistenceDiagram* diagram)
 {
-    this->persistence_pairs = pairs;
-    cache_dirty = true;
+    this->persistence_diagram = diagram;
     initial_feature_highlighted = false;
+    // the summary may point into the diagram that was just replaced, the next plot picks the points again
+    summary_diagram = nullptr;
+    summary_points.clear();
+    summary_dirty = true;
 }
 
 void UI::set_persistence_texture(ImTextureID tex)
@@ -115,11 +120,14 @@ void UI::set_on_brush_selected(const std::function<void(const std::vector<Persis
     on_brush_selected = cb;
 }
 
-void UI::set_gradient_persistence_pairs(const std::vector<PersistencePair>* gp)
+void UI::set_gradient_persistence_diagram(const PersistenceDiagram* diagram)
 {
-    gradient_pairs = gp;
-    cache_dirty = true;
+    gradient_diagram = diagram;
     initial_feature_highlighted = false;
+    // the summary may point into the diagram that was just replaced, the next plot picks the points again
+    summary_diagram = nullptr;
+    summary_points.clear();
+    summary_dirty = true;
 }
 
 void UI::set_merge_tree(MergeTree* mt)
@@ -127,11 +135,31 @@ void UI::set_merge_tree(MergeTree* mt)
     merge_tree = mt;
 }
 
+void UI::set_branch_decomposition(const BranchDecomposition* branches)
+{
+    branch_decomposition = branches;
+}
+
+void UI::set_branch_segmentation(const BranchSegmentation* segmentation)
+{
+    branch_segmentation = segmentation;
+}
+
 void UI::set_on_merge_mode_changed(const std::function<void(int)>& cb)
 {
     on_merge_mode_changed = cb;
 }
 
+void UI::set_on_merge_tree_source_changed(const std::function<void(int source, uint32_t tolerance)>& cb)
+{
+    on_merge_tree_source_changed = cb;
+}
+
+void UI::set_on_tf_source_changed(const std::function<void(int source)>& cb)
+{
+    on_tf_source_changed = cb;
+}
+
 void UI::mark_merge_tree_dirty() 
 { 
     mt_dirty = true;
@@ -209,6 +237,11 @@ void UI::set_on_evaluation(const std::function<void(float,float,float,float)>& c
   on_evaluation = cb;
 }
 
+void UI::set_on_diagram_distance(const std::function<void(float q)>& cb)
+{
+    on_diagram_distance = cb;
+}
+
 void UI::clear_selection()
 {
     selected_idx = -1;
@@ -233,6 +266,14 @@ void UI::draw(vk::CommandBuffer& cb, AppState& app_state)
     ImGui::NewFrame();
 
     ImGui::Begin("AutoTF_PH");
+    if (app_state.load_progress < 1.0f)
+    {
+        ImGui::ProgressBar(app_state.load_progress, ImVec2(-1.0f, 0.0f), "Loading volume");
+    }
+    else if (app_state.persistence_pending)
+    {
+        ImGui::ProgressBar(-1.0f * float(ImGui::GetTime()), ImVec2(-1.0f, 0.0f), "Computing persistence");
+    }
     if (ImGui::CollapsingHeader("Navigation"))
     {
         ImGui::Text("'W'A'S'D'Q'E': movement");
@@ -266,6 +307,62 @@ void UI::draw(vk::CommandBuffer& cb, AppState& app_state)
         }
         ImGui::SameLine();
         ImGui::Text("Current mode: %s", (currentMode == 0) ? "Lower Star" : "Upper Star");
+
+        // join/split tree swept from the volume or the old chaining of the persistence pairs
+        static int merge_tree_source = 0;
+        static int merge_tree_tolerance = 5;
+        const char* sourceOptions[] = { "Volume Sweep", "Pair Tolerance" };
+        bool merge_tree_changed = ImGui::Combo("Merge Tree", &merge_tree_source, sourceOptions, IM_ARRAYSIZE(sourceOptions));
+        if (merge_tree_source == 1 && ImGui::InputInt("Death Tolerance", &merge_tree_tolerance))
+        {
+            merge_tree_tolerance = std::clamp(merge_tree_tolerance, 0, 255);
+            merge_tree_changed = true;
+        }
+        if (merge_tree_changed && on_merge_tree_source_changed)
+        {
+            on_merge_tree_source_changed(merge_tree_source, uint32_t(merge_tree_tolerance));
+        }
+
+        // the transfer function colors persistence pairs or the branches of the merge tree above
+        static int tf_source = 0;
+        const char* tfOptions[] = { "Persistence Diagram", "Merge Tree Branches" };
+        if (ImGui::Combo("Transfer Function", &tf_source, tfOptions, IM_ARRAYSIZE(tfOptions)) && on_tf_source_changed)
+        {
+            on_tf_source_changed(tf_source);
+        }
+
+        // highlights the nodes of one tree level, the index answers every slider step directly
+        if (merge_tree && !merge_tree->empty())
+        {
+            if (ImGui::SliderInt("Tree Level", &app_state.target_level, 0, merge_tree->get_max_level()))
+            {
+                app_state.apply_target_level = true;
+            }
+            if (ImGui::SliderInt("Min Persistence", &app_state.persistence_threshold, 0, int(merge_tree->get_max_persistence())))
+            {
+                app_state.apply_persistence_threshold = true;
+            }
+            ImGui::Text("Nodes: %zu", merge_tree->nodes_at_level(app_state.target_level, uint32_t(app_state.persistence_threshold)).size());
+        }
+    }
+    ImGui::Separator();
+
+    // distance between the scalar and the gradient persistence diagram
+    if (ImGui::CollapsingHeader("Diagram Distance"))
+    {
+        static float distance_q = 2.0f;
+        ImGui::InputFloat("Wasserstein q", &distance_q, 1.0f, 1.0f, "%.1f");
+        if (distance_q < 1.0f) distance_q = 1.0f;
+        if (ImGui::Button("Compute Distances") && on_diagram_distance)
+        {
+            on_diagram_distance(distance_q);
+        }
+        if (last_distance_valid)
+        {
+            ImGui::Text("Bottleneck: %.2f", last_bottleneck);
+            ImGui::Text("Wasserstein: %.2f", last_wasserstein);
+            ImGui::Text("Time: %.1f ms", last_distance_ms);
+        }
     }
     ImGui::PushItemWidth(80.0f);
     ImGui::Separator();
@@ -301,7 +398,6 @@ void UI::draw(vk::CommandBuffer& cb, AppState& app_state)
             multi_selected_idxs.clear();
             multi_selected_cols.clear();
             range_active = false;
-            cache_dirty = true;
             initial_feature_highlighted = false;
             viewType = 0;
         }
@@ -338,9 +434,9 @@ void UI::draw(vk::CommandBuffer& cb, AppState& app_state)
                 hits = last_highlight_hits;
             } else
             {
-                const auto* dp = (pd_mode == 1 && gradient_pairs) ? gradient_pairs : persistence_pairs;
+                const auto* dp = (pd_mode == 1 && gradient_diagram) ? gradient_diagram : persistence_diagram;
                 hits.reserve(dp->size());
-                for (auto &p : *dp)
+                for (auto &p : dp->points())
                     hits.emplace_back(p, highlight_opacity);
             }
 
@@ -369,7 +465,9 @@ void UI::draw(vk::CommandBuffer& cb, AppState& app_state)
 
         ImGui::Separator(); 
         // choose which set to draw
-        const auto* draw_pairs = (pd_mode == 1 && gradient_pairs) ? gradient_pairs : persistence_pairs;
+        // every distinct (birth, death) point is drawn once, the multiplicity only scales its marker
+        const PersistenceDiagram* draw_diagram = (pd_mode == 1 && gradient_diagram) ? gradient_diagram : persistence_diagram;
+        const std::vector<PersistencePair>* draw_pairs = draw_diagram ? &draw_diagram->points() : nullptr;
 
         if (!draw_pairs || draw_pairs->empty())
         {
@@ -379,18 +477,15 @@ void UI::draw(vk::CommandBuffer& cb, AppState& app_state)
         }
 
         int N = int(draw_pairs->size());
-        ImGui::Text("Total pairs: %d", N);
+        ImGui::Text("Total pairs: %zu (%d unique points)", draw_diagram->total_pairs(), N);
         ImGui::Separator();
 
         // automatic initial highlight of most persistent feature
         if (!initial_feature_highlighted && draw_pairs && !draw_pairs->empty())
         {
             // find the pair with max persistence (death - birth)
-            auto it = std::max_element(draw_pairs->begin(), draw_pairs->end(), [](auto &a, auto &b)
-            {
-                return (a.death - a.birth) < (b.death - b.birth);
-            });
-            PersistencePair most = *it;
+            const int most_idx = int(draw_diagram->most_persistent());
+            PersistencePair most = (*draw_diagram)[most_idx];
 
             if (viewType == 0)
             {
@@ -398,11 +493,10 @@ void UI::draw(vk::CommandBuffer& cb, AppState& app_state)
                 {
                     on_pair_selected(most);
                     // direct B-mask calculation
-                    int feat_idx = int(std::distance(draw_pairs->begin(), it));
                     if (on_persistence_reprojected)
-                        on_persistence_reprojected(feat_idx);
+                        on_persistence_reprojected(most_idx);
                 }
-                selected_idx = int(std::distance(draw_pairs->begin(), it));
+                selected_idx = most_idx;
             }
             else if (viewType == 1)
             {
@@ -450,7 +544,6 @@ void UI::draw(vk::CommandBuffer& cb, AppState& app_state)
                 birth_range[1] = death_range[1] = persistence_range[1] = 255.0f;
                 diagram_zoom = 1.0f;
                 marker_size = 5.0f;
-                cache_dirty = true;
                 range_active = false;
                 multi_selected_idxs.clear();
                 multi_selected_cols.clear();
@@ -459,6 +552,8 @@ void UI::draw(vk::CommandBuffer& cb, AppState& app_state)
             }
             ImGui::SameLine();
             ImGui::Checkbox("Show Dots", &show_dots);
+            ImGui::SameLine();
+            ImGui::Checkbox("Scale by Multiplicity", &scale_by_multiplicity);
             ImGui::SliderInt("Max Points", &max_points_to_show, 1, N);
             ImGui::PushID("range_filters");
             ImGui::SliderFloat("Density Cutoff", &app_state.density_threshold, 0.0f, 1.0f, "%.2f");
@@ -488,21 +583,33 @@ void UI::draw(vk::CommandBuffer& cb, AppState& app_state)
                     diagram_zoom = std::clamp(diagram_zoom + io.MouseWheel * 0.2f, 0.1f, 10.0f);
 
                 // filter index list
+                // the rectangle query only visits the grid cells overlapping the birth and death ranges
                 std::vector<int> idxs;
-                idxs.reserve(N);
-                for (int i = 0; i < N; ++i)
+                const std::vector<uint32_t> candidates = draw_diagram->range(
+                    uint32_t(std::ceil(birth_range[0])), uint32_t(std::floor(birth_range[1])),
+                    uint32_t(std::ceil(death_range[0])), uint32_t(std::floor(death_range[1])));
+                idxs.reserve(std::min<size_t>(candidates.size(), size_t(max_points_to_show)));
+                for (uint32_t i : candidates)
                 {
                     const auto &p = (*draw_pairs)[i];
                     float birth = float(p.birth);
                     float death = float(p.death);
                     float pers = death - birth;
-                    if (birth >= birth_range[0] && birth <= birth_range[1] && death >= death_range[0] && death <= death_range[1] && pers >= persistence_range[0] && pers <= persistence_range[1])
+                    if (pers >= persistence_range[0] && pers <= persistence_range[1])
                     {
-                        idxs.push_back(i);
+                        idxs.push_back(int(i));
                         if ((int)idxs.size() >= max_points_to_show) break;
                     }
                 }
 
+                // the summaries follow the filtered points
+                if (draw_diagram != summary_diagram || !std::equal(idxs.begin(), idxs.end(), summary_points.begin(), summary_points.end(), [](int a, uint32_t b) { return uint32_t(a) == b; }))
+                {
+                    summary_diagram = draw_diagram;
+                    summary_points.assign(idxs.begin(), idxs.end());
+                    summary_dirty = true;
+                }
+
                 if (selected_idx >= (int)idxs.size())
                     selected_idx = -1;
 
@@ -553,23 +660,8 @@ void UI::draw(vk::CommandBuffer& cb, AppState& app_state)
 
                 if (show_dots)
                 {
-                    // rebuild cache once
-                    if (cache_dirty)
-                    {
-                        xs.resize(N); ys.resize(N); pers.resize(N);
-                        float maxP = 0.0f;
-                        for (int i = 0; i < N; ++i)
-                        {
-                            auto &p = (*draw_pairs)[i];
-                            xs[i] = double(p.birth);
-                            ys[i] = double(p.death);
-                            pers[i] = float(p.death - p.birth);
-                            maxP = std::max(maxP, pers[i]);
-                        }
-                        for (int i = 0; i < N; ++i)
-                            pers[i] /= (maxP > 0.0f ? maxP : 1.0f);
-                        cache_dirty = false;
-                    }
+                    // color by persistence relative to the cached maximum of the diagram
+                    const float inv_max_pers = 1.0f / float(std::max(1u, draw_diagram->max_persistence()));
 
                     // plot each dot
                     dot_pos.clear();
@@ -583,7 +675,7 @@ void UI::draw(vk::CommandBuffer& cb, AppState& app_state)
                         ImVec2 pos = ImVec2(origin.x + pad + fx * inner_w, origin.y + pad + (1.0f - fy) * inner_h);
                         dot_pos.push_back(pos);
 
-                        float tval = pers[i];
+                        float tval = float(PersistenceDiagram::persistence(p)) * inv_max_pers;
 
                         // ramp‐based color lookup
                         float cr=0.0f, cg=0.0f, cb=0.0f;
@@ -638,8 +730,11 @@ void UI::draw(vk::CommandBuffer& cb, AppState& app_state)
                         cg = glm::clamp(cg, 0.0f, 1.0f);
                         cb = glm::clamp(cb, 0.0f, 1.0f);
 
-                        // draw the dot
-                        dl->AddCircleFilled(pos, marker_size, IM_COL32(int(cr*255), int(cg*255), int(cb*255), 255));
+                        // draw the dot, points that stand for many pairs grow logarithmically
+                        float radius = marker_size;
+                        if (scale_by_multiplicity)
+                            radius *= 1.0f + 0.25f * std::log2(float(draw_diagram->multiplicity()[i]));
+                        dl->AddCircleFilled(pos, radius, IM_COL32(int(cr*255), int(cg*255), int(cb*255), 255));
 
                         // if it is a very dark color draw a faint white outline
                         float lum = 0.2126f*cr + 0.7152f*cg + 0.0722f*cb;
@@ -873,6 +968,16 @@ void UI::draw(vk::CommandBuffer& cb, AppState& app_state)
                     {
                         need_update = true;
                     }
+
+                    // saddle where the branches of A and B join in the merge tree
+                    if (branch_decomposition && merge_tree && !merge_tree->empty())
+                    {
+                        const uint32_t saddle = branch_decomposition->merge_node(branch_decomposition->find_branch(p1), branch_decomposition->find_branch(p2));
+                        if (saddle != NO_NODE)
+                            ImGui::Text("A and B merge at %u (tree level %d)", merge_tree->birth(saddle), merge_tree->depth(saddle));
+                        else
+                            ImGui::Text("A and B do not merge in the merge tree");
+                    }
                     ImGui::Separator();
 
                     if (selected_set_op == 0) // Show A
@@ -1039,7 +1144,22 @@ void UI::draw(vk::CommandBuffer& cb, AppState& app_state)
                 if (selected_idx >= 0)
                 {
                     auto &p = (*draw_pairs)[selected_idx];
-                    ImGui::Text("Selected Pair: (%u , %u)", p.birth, p.death);
+                    ImGui::Text("Selected Pair: (%u , %u) x%u", p.birth, p.death, draw_diagram->multiplicity()[selected_idx]);
+
+                    // voxels of the pair's branch, the segmentation renders the branch with everything merging into it
+                    if (branch_decomposition && branch_segmentation && !branch_segmentation->empty())
+                    {
+                        const uint32_t branch = branch_decomposition->find_branch(p);
+                        const BranchRegion& region = branch_segmentation->regions[branch];
+                        ImGui::Text("Branch %u: %llu voxels, values %u - %u", branch, (unsigned long long)region.voxel_count, region.min_value, region.max_value);
+                        ImGui::Text("Bounds: (%u, %u, %u) - (%u, %u, %u)", region.min.x, region.min.y, region.min.z, region.max.x, region.max.y, region.max.z);
+                        bool segmented = app_state.segmented_branch == int(branch);
+                        if (ImGui::Checkbox("Segment Branch", &segmented))
+                        {
+                            app_state.segmented_branch = segmented ? int(branch) : -1;
+                            app_state.apply_segmented_branch = true;
+                        }
+                    }
                 }
             }
         }
@@ -1250,7 +1370,7 @@ void UI::draw(vk::CommandBuffer& cb, AppState& app_state)
             ImGui::Separator();
             ImGui::Text("Choose colors for brush-clusters:");
 
-            const auto* dp = (pd_mode == 1 && gradient_pairs) ? gradient_pairs : persistence_pairs;
+            const auto* dp = (pd_mode == 1 && gradient_diagram) ? &gradient_diagram->points() : &persistence_diagram->points();
 
             for (size_t ci = 0; ci < brush_clusters.size(); ++ci)
             {
@@ -1293,6 +1413,175 @@ void UI::draw(vk::CommandBuffer& cb, AppState& app_state)
     }
     ImGui::End();
 
+    // fixed size summaries of the filtered diagram, recomputed whenever the filters change
+    ImGui::Begin("Diagram Summaries");
+    {
+        bool settings_changed = false;
+        int landscape_count = int(summary_settings.landscape_count);
+        int image_resolution = int(summary_settings.image_resolution);
+        settings_changed |= ImGui::SliderInt("Landscapes", &landscape_count, 1, 10);
+        settings_changed |= ImGui::SliderInt("Image Resolution", &image_resolution, 8, 128);
+        settings_changed |= ImGui::SliderFloat("Image Sigma", &summary_settings.image_sigma, 0.5f, 32.0f, "%.1f");
+        summary_settings.landscape_count = uint32_t(landscape_count);
+        summary_settings.image_resolution = uint32_t(image_resolution);
+
+        if (summary_diagram && (summary_dirty || settings_changed))
+        {
+            summary_features = vectorize_diagram(*summary_diagram, summary_points, summary_settings);
+            const size_t R = summary_settings.image_resolution;
+            summary_image_flipped.resize(R * R);
+            for (size_t y = 0; y < R; ++y)
+                std::copy_n(summary_features.image.begin() + (R - 1 - y) * R, R, summary_image_flipped.begin() + y * R);
+            summary_dirty = false;
+        }
+
+        if (summary_features.betti.empty())
+        {
+            ImGui::Text("No filtered persistence diagram");
+        }
+        else
+        {
+            ImGui::Text("%zu filtered points", summary_points.size());
+            const double max_value = summary_settings.max_value;
+            const int levels = int(summary_features.betti.size());
+            if (ImPlot::BeginPlot("Betti Curve", ImVec2(-1, 200)))
+            {
+                ImPlot::SetupAxes("Level", "Alive Intervals", ImPlotAxisFlags_None, ImPlotAxisFlags_AutoFit);
+                ImPlot::SetupAxisLimits(ImAxis_X1, 0, max_value, ImPlotCond_Always);
+                ImPlot::PlotLine("Betti", summary_features.betti.data(), levels, max_value / std::max(levels - 1, 1));
+                ImPlot::EndPlot();
+            }
+
+            const int samples = int(summary_settings.landscape_samples);
+            if (ImPlot::BeginPlot("Persistence Landscapes", ImVec2(-1, 200)))
+            {
+                ImPlot::SetupAxes("Level", "Tent Height", ImPlotAxisFlags_None, ImPlotAxisFlags_AutoFit);
+                ImPlot::SetupAxisLimits(ImAxis_X1, 0, max_value, ImPlotCond_Always);
+                for (uint32_t k = 0; k < summary_settings.landscape_count; ++k)
+                {
+                    char label[32];
+                    std::snprintf(label, sizeof(label), "lambda %u", k + 1);
+                    ImPlot::PlotLine(label, summary_features.landscapes.data() + size_t(k) * samples, samples, max_value / std::max(samples - 1, 1));
+                }
+                ImPlot::EndPlot();
+            }
+
+            const int R = int(summary_settings.image_resolution);
+            if (ImPlot::BeginPlot("Persistence Image", ImVec2(-1, 300)))
+            {
+                ImPlot::SetupAxes("Birth", "Persistence");
+                ImPlot::PushColormap(ImPlotColormap_Viridis);
+                ImPlot::PlotHeatmap("##persistence_image", summary_image_flipped.data(), R, R, 0.0, 0.0, nullptr, ImPlotPoint(0, 0), ImPlotPoint(max_value, max_value));
+                ImPlot::PopColormap();
+                ImPlot::EndPlot();
+            }
+        }
+    }
+    ImGui::End();
+
+    // playback controls, only shown for a time series
+    if (app_state.series_steps > 0)
+    {
+        ImGui::Begin("Time Series");
+        ImGui::Checkbox("Play", &app_state.series_playing);
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(120.0f);
+        ImGui::SliderFloat("Steps/s", &app_state.series_fps, 1.0f, 120.0f, "%.0f");
+        if (ImGui::SliderInt("Step", &app_state.series_step, 0, app_state.series_steps - 1)) app_state.apply_series_step = true;
+        ImGui::Text("Decoded ahead: %d", app_state.series_ready);
+        ImGui::End();
+    }
+
+    // branch layout of the merge tree, laid out again only when the tree changes
+    ImGui::Begin("Merge Tree");
+    {
+        bool refit = false;
+        if (mt_dirty && branch_decomposition)
+        {
+            mt_layout = layout_merge_tree(*branch_decomposition);
+            mt_dirty = false;
+            refit = true;
+        }
+
+        if (!branch_decomposition || mt_layout.empty())
+        {
+            ImGui::Text("No merge tree");
+        }
+        else
+        {
+            static std::vector<std::pair<uint32_t, bool>> mt_stack;
+            const std::vector<Branch>& branches = branch_decomposition->get_branches();
+            const uint32_t min_persistence = uint32_t(std::max(app_state.persistence_threshold, 0));
+            uint32_t drawn = 0;
+            uint32_t hovered = NO_NODE;
+
+            if (refit) ImPlot::SetNextAxesLimits(0, mt_layout.columns, 0, 255, ImPlotCond_Always);
+            if (ImPlot::BeginPlot("##MergeTree", ImVec2(-1, -ImGui::GetFrameHeightWithSpacing())))
+            {
+                ImPlot::SetupAxes("Branch", "Value", ImPlotAxisFlags_NoTickLabels, ImPlotAxisFlags_None);
+                const ImPlotRect limits = ImPlot::GetPlotLimits();
+                const ImVec2 plot_size = ImPlot::GetPlotSize();
+                const double px_per_column = plot_size.x / limits.X.Size();
+                const double px_per_value = plot_size.y / limits.Y.Size();
+                const ImVec2 mouse = ImGui::GetMousePos();
+                const bool plot_hovered = ImPlot::IsPlotHovered();
+                float hover_distance = 4.0f;
+                ImDrawList* dl = ImPlot::GetPlotDrawList();
+                ImPlot::PushPlotClipRect();
+
+                // level of detail: a subtree is skipped once it leaves the view or its branch gets shorter than a
+                // pixel, and its children are skipped once it is narrower than a pixel. children never outlive
+                // their parent and lie inside its column range, so neither cut changes the picture
+                mt_stack.clear();
+                for (auto it = mt_layout.roots.rbegin(); it != mt_layout.roots.rend(); ++it) mt_stack.emplace_back(*it, false);
+                while (!mt_stack.empty())
+                {
+                    const auto [b, in_segment] = mt_stack.back();
+                    mt_stack.pop_back();
+                    const Branch& branch = branches[b];
+                    const uint32_t persistence = branch.birth > branch.death ? branch.birth - branch.death : branch.death - branch.birth;
+                    if (mt_layout.range_end[b] <= limits.X.Min || mt_layout.range_begin[b] >= limits.X.Max) continue;
+                    if (persistence < min_persistence || (persistence * px_per_value < 1.0 && branch.parent != NO_NODE)) continue;
+
+                    const bool segmented = in_segment || app_state.segmented_branch == int(b);
+                    const ImU32 col = segmented ? IM_COL32(220, 40, 40, 255) : IM_COL32(60, 60, 60, 255);
+                    const double x = mt_layout.column[b] + 0.5;
+                    const ImVec2 top = ImPlot::PlotToPixels(x, double(branch.birth));
+                    const ImVec2 bottom = ImPlot::PlotToPixels(x, double(branch.death));
+                    dl->AddLine(top, bottom, col, 1.5f);
+                    if (branch.parent != NO_NODE)
+                        dl->AddLine(bottom, ImPlot::PlotToPixels(mt_layout.column[branch.parent] + 0.5, double(branch.death)), col, 1.0f);
+                    drawn++;
+
+                    if (plot_hovered && std::abs(mouse.x - top.x) < hover_distance && mouse.y >= std::min(top.y, bottom.y) && mouse.y <= std::max(top.y, bottom.y))
+                    {
+                        hovered = b;
+                        hover_distance = std::abs(mouse.x - top.x);
+                    }
+
+                    if ((mt_layout.range_end[b] - mt_layout.range_begin[b]) * px_per_column < 1.0) continue;
+                    for (uint32_t i = mt_layout.child_start[b + 1]; i-- > mt_layout.child_start[b];)
+                        mt_stack.emplace_back(mt_layout.children[i], segmented);
+                }
+                ImPlot::PopPlotClipRect();
+
+                if (hovered != NO_NODE)
+                {
+                    ImGui::SetTooltip("Branch %u: (%u , %u)", hovered, branches[hovered].birth, branches[hovered].death);
+                    // clicking a branch segments it when the tree comes from the volume
+                    if (ImGui::IsMouseClicked(ImGuiMouseButton_Left))
+                    {
+                        app_state.segmented_branch = int(hovered);
+                        app_state.apply_segmented_branch = true;
+                    }
+                }
+                ImPlot::EndPlot();
+            }
+            ImGui::Text("Drawn %u of %zu branches", drawn, branches.size());
+        }
+    }
+    ImGui::End();
+
 
     // 2D transfer function editor
     ImGui::Begin("2D TF Editor");
@@ -1303,7 +1592,8 @@ void UI::draw(vk::CommandBuffer& cb, AppState& app_state)
         static std::vector<double> hist;
         hist.assign(AppState::TF2D_BINS * AppState::TF2D_BINS, 0.0);
         
-        for (size_t i = 0; i < volume->data.size(); ++i)
+        // no volume while it is still loading
+        for (size_t i = 0; volume && i < volume->data.size(); ++i)
         {
             int scalar = int(volume->data[i]);
             int gradient = int(gradient_volume->data[i]);
@@ -1396,18 +1686,8 @@ void UI::draw(vk::CommandBuffer& cb, AppState& app_state)
             on_tf2d_selected(sel, brush_color);
         };
 
-        // compute highest non empty gradient bin
-        int max_gradient = 0;
-        for (int gradient = 0; gradient < AppState::TF2D_BINS; ++gradient)
-        {
-            for (int scalar = 0; scalar < AppState::TF2D_BINS; ++scalar)
-            {
-                if (hist[gradient * AppState::TF2D_BINS + scalar] > 0.0)
-                {
-                    max_gradient = std::max(max_gradient, gradient);
-                }
-            }
-        }
+        // highest non empty gradient bin, rows are flipped so it holds the smallest gradient
+        int max_gradient = volume ? int(AppState::TF2D_BINS) - 1 - int(volume_stats(*gradient_volume).min) : 0;
         float plot_max_gradient = float(max_gradient) + 1.0f;
 
         ImPlot::SetNextAxisLimits(ImAxis_X1, 0, (double)AppState::TF2D_BINS, ImPlotCond_Always);
@@ -1537,7 +1817,6 @@ void UI::draw(vk::CommandBuffer& cb, AppState& app_state)
             persistence_bin_colors.clear();
             region_defined = false;
             clear_selection();
-            cache_dirty = true;
             if (on_clear_custom_colors) on_clear_custom_colors(); 
         }
 
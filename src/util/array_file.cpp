@@ -0,0 +1,89 @@
+#include "util/array_file.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+namespace
+{
+struct ArrayFileHeader
+{
+  char magic[8];
+  uint64_t key;
+  uint32_t array_count;
+  uint32_t reserved;
+};
+
+uint64_t padding(uint64_t bytes)
+{
+  return (ARRAY_FILE_ALIGNMENT - bytes % ARRAY_FILE_ALIGNMENT) % ARRAY_FILE_ALIGNMENT;
+}
+} // namespace
+
+ArrayFileWriter::ArrayFileWriter(const std::string& path, const char (&magic)[8], uint64_t key, uint32_t array_count)
+  : path(path), tmp_path(path + ".tmp"), out(tmp_path, std::ios::binary), arrays_left(array_count)
+{
+  ArrayFileHeader header{};
+  std::memcpy(header.magic, magic, sizeof(header.magic));
+  header.key = key;
+  header.array_count = array_count;
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+void ArrayFileWriter::write_bytes(const void* data, uint64_t count, size_t element_size)
+{
+  static const char zeros[ARRAY_FILE_ALIGNMENT] = {};
+  const uint64_t bytes = count * element_size;
+  out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+  out.write(static_cast<const char*>(data), std::streamsize(bytes));
+  out.write(zeros, std::streamsize(padding(bytes)));
+  arrays_left--;
+}
+
+int ArrayFileWriter::finish()
+{
+  out.close();
+  if (!out || arrays_left != 0)
+  {
+    std::cerr << "ERROR: Failed to write " << tmp_path << "." << std::endl;
+    std::filesystem::remove(tmp_path);
+    return 1;
+  }
+  std::error_code ec;
+  std::filesystem::rename(tmp_path, path, ec);
+  if (ec)
+  {
+    std::cerr << "ERROR: Cannot move " << tmp_path << " to " << path << ": " << ec.message() << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+int ArrayFileReader::open(const std::string& path, const char (&magic)[8], uint64_t key, uint32_t array_count)
+{
+  std::error_code ec;
+  const uint64_t size = std::filesystem::file_size(path, ec);
+  in.open(path, std::ios::binary);
+  ArrayFileHeader header;
+  if (ec || !in || size < sizeof(header) || !in.read(reinterpret_cast<char*>(&header), sizeof(header))) return 1;
+  if (std::memcmp(header.magic, magic, sizeof(header.magic)) != 0 || header.array_count != array_count) return 1;
+  if (header.key != key) return 2;
+  remaining = size - sizeof(header);
+  return 0;
+}
+
+bool ArrayFileReader::read_count(uint64_t& count, size_t element_size)
+{
+  if (remaining < sizeof(count) || !in.read(reinterpret_cast<char*>(&count), sizeof(count))) return false;
+  remaining -= sizeof(count);
+  return count <= remaining / element_size;
+}
+
+bool ArrayFileReader::read_elements(void* data, uint64_t bytes)
+{
+  const uint64_t pad = padding(bytes);
+  if (bytes + pad > remaining || !in.read(static_cast<char*>(data), std::streamsize(bytes))) return false;
+  in.seekg(std::streamoff(pad), std::ios::cur);
+  remaining -= bytes + pad;
+  return bool(in);
+}
@@ -8,13 +8,132 @@
 #include <vector>
 #include <cstdint>
 #include <cmath>
+#include "volume_compression.hpp"
+#include "volume_stats.hpp"
+#include "volume_layout.hpp"
+#include "util/timer.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+VolumeData& VolumeData::operator=(const VolumeData& other)
+{
+    if (this == &other) return *this;
+    owned.assign(other.begin(), other.end());
+    external.reset();
+    bytes = owned.data();
+    count = owned.size();
+    return *this;
+}
 
-[[nodiscard]] int load_volume_from_file(const std::string& header_filename, Volume& volume)
+VolumeData& VolumeData::operator=(VolumeData&& other) noexcept
+{
+    if (this == &other) return *this;
+    // moving the vector keeps its buffer, bytes stays valid
+    owned = std::move(other.owned);
+    external = std::move(other.external);
+    bytes = other.bytes;
+    count = other.count;
+    other.owned.clear();
+    other.bytes = nullptr;
+    other.count = 0;
+    return *this;
+}
+
+void VolumeData::adopt(uint8_t* data, size_t size, std::shared_ptr<void> owner)
+{
+    std::vector<uint8_t>().swap(owned);
+    external = std::move(owner);
+    bytes = data;
+    count = size;
+}
+
+void VolumeData::resize(size_t size)
+{
+    if (external)
+    {
+        owned.assign(bytes, bytes + std::min(size, count));
+        external.reset();
+    }
+    owned.resize(size);
+    bytes = owned.data();
+    count = owned.size();
+}
+
+void VolumeData::assign(size_t size, uint8_t value)
+{
+    external.reset();
+    owned.assign(size, value);
+    bytes = owned.data();
+    count = owned.size();
+}
+
+// private mapping of the whole file, writes stay in this process and copy only the touched pages
+static int map_raw_file(const std::filesystem::path& path, size_t size, VolumeData& data)
+{
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        std::cerr << "Failed to open raw data file: " << path << std::endl;
+        return 1;
+    }
+    void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        std::cerr << "Failed to map raw data file: " << path << std::endl;
+        return 1;
+    }
+    // the kernel reads ahead far for the sweeps over the volume, huge pages where the file system allows
+    madvise(mapping, size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+    madvise(mapping, size, MADV_HUGEPAGE);
+#endif
+    data.adopt(static_cast<uint8_t*>(mapping), size, std::shared_ptr<void>(mapping, [size](void* p) { munmap(p, size); }));
+    return 0;
+}
+
+static int read_raw_file(const std::filesystem::path& raw_file_path, size_t volume_size, VolumeData& data)
+{
+    data.resize(volume_size);
+
+    // open volume file (raw file)
+    std::ifstream file(raw_file_path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) 
+    {
+        std::cerr << "Failed to open raw data file: " << raw_file_path << std::endl;
+        return 1;
+    }
+    std::cout << "Successfully opened raw data file: " << raw_file_path << std::endl;
+
+    std::streamsize fileSize = file.tellg();
+    file.seekg(0, std::ios::beg);
+
+    if (fileSize != static_cast<std::streamsize>(volume_size)) {
+        std::cerr << "File size mismatch! Read: " << fileSize << ", expected: " << volume_size << std::endl;
+        return 1;
+    }
+    // read volume data
+    file.read(reinterpret_cast<char*>(data.data()), volume_size);
+    std::cout << "Bytes read: " << file.gcount() << " expected: " << volume_size << std::endl;
+
+    if (!file) 
+    {
+        std::cerr << "Failed to read raw data file!" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+static std::string trim(const std::string& text)
+{
+    const auto first = std::find_if(text.begin(), text.end(), [](unsigned char ch) { return !std::isspace(ch); });
+    const auto last = std::find_if(text.rbegin(), text.rend(), [](unsigned char ch) { return !std::isspace(ch); }).base();
+    return first < last ? std::string(first, last) : std::string();
+}
+
+[[nodiscard]] int read_nrrd_header(const std::string& header_path, NrrdHeader& header)
 {
-    const std::string volume_folder = "data/volume/";
-    if (!std::filesystem::exists(volume_folder)) std::filesystem::create_directories(volume_folder);
-    volume.name = header_filename.substr(0, header_filename.find_last_of('.'));
-    const std::string header_path = volume_folder + header_filename;
     std::ifstream header_file(header_path);
     if (!header_file.is_open()) {
         std::cerr << "Failed to open header file: " << header_path << std::endl;
@@ -24,39 +143,36 @@
     std::string line;
     bool sizes_found = false;
     std::string data_file_path;
+    std::string encoding = "raw";
 
     // iterate through each line of header file
     while (std::getline(header_file, line)) 
     {
-        // look for 'sizes:' line to extract resolution
+        // look for 'sizes:' line to extract resolution, a fourth size counts the timesteps
         if (line.find("sizes:") == 0) 
         {
             std::stringstream ss(line.substr(6));  // skip "sizes:"
-            ss >> volume.resolution.x >> volume.resolution.y >> volume.resolution.z;
-            std::cout << "Parsed sizes: " << volume.resolution.x << " " << volume.resolution.y << " " << volume.resolution.z << std::endl;
+            ss >> header.resolution.x >> header.resolution.y >> header.resolution.z;
+            if (!(ss >> header.timesteps)) header.timesteps = 1;
             sizes_found = true;
         }
         // look for 'data file:' line to extract path to the .raw file
         if (line.find("data file:") == 0) 
         {
-            data_file_path = line.substr(10); // skip "data file:"
-            // remove whitespaces
-            data_file_path.erase(data_file_path.begin(), std::find_if(data_file_path.begin(), data_file_path.end(), [](unsigned char ch) 
-            {
-                return !std::isspace(ch);
-            }));
-            data_file_path.erase(std::find_if(data_file_path.rbegin(), data_file_path.rend(), [](unsigned char ch) 
-            {
-                return !std::isspace(ch);
-            }).base(), data_file_path.end());
-            std::cout << "Data file path: " << data_file_path << std::endl;
+            data_file_path = trim(line.substr(10)); // skip "data file:"
+        }
+        // raw or gzip, the header names the encoding of the data file
+        if (line.find("encoding:") == 0)
+        {
+            encoding = trim(line.substr(9));
+            if (encoding == "gz") encoding = "gzip";
         }
     }
 
     header_file.close();
 
     // check if resolution and path to the .raw file were correctly read
-    if (!sizes_found || volume.resolution.x == 0 || volume.resolution.y == 0 || volume.resolution.z == 0) 
+    if (!sizes_found || header.resolution.x == 0 || header.resolution.y == 0 || header.resolution.z == 0 || header.timesteps == 0) 
     {
         std::cerr << "Failed to parse volume resolution!" << std::endl;
         return 1;
@@ -66,105 +182,141 @@
         std::cerr << "Failed to parse data file path from header!" << std::endl;
         return 1;
     }
-
-    // calculate expected size of volume
-    size_t volume_size = volume.resolution.x * volume.resolution.y * volume.resolution.z;
-    volume.data.resize(volume_size);
-
-    // combine directory path of header file with the path to the .raw file
-    std::filesystem::path raw_file_path = std::filesystem::path(header_path).parent_path() / data_file_path;
-
-    // open volume file (raw file)
-    std::ifstream file(raw_file_path, std::ios::binary | std::ios::ate);
-    if (!file.is_open()) 
+    if (encoding != "raw" && encoding != "gzip")
     {
-        std::cerr << "Failed to open raw data file: " << raw_file_path << std::endl;
-        return 1;
-    }
-    std::cout << "Successfully opened raw data file: " << raw_file_path << std::endl;
-
-    std::streamsize fileSize = file.tellg();
-    file.seekg(0, std::ios::beg);
-
-    if (fileSize != static_cast<std::streamsize>(volume_size)) {
-        std::cerr << "File size mismatch! Read: " << fileSize << ", expected: " << volume_size << std::endl;
+        std::cerr << "Unsupported NRRD encoding: " << encoding << " (expected raw or gzip)" << std::endl;
         return 1;
     }
-    // read volume data
-    file.read(reinterpret_cast<char*>(volume.data.data()), volume_size);
-    std::cout << "Bytes read: " << file.gcount() << " expected: " << volume_size << std::endl;
+    header.encoding = encoding == "gzip" ? VolumeEncoding::Gzip : VolumeEncoding::Raw;
+    // combine directory path of header file with the path to the .raw file
+    header.data_file = std::filesystem::path(header_path).parent_path() / data_file_path;
+    return 0;
+}
 
-    if (!file) 
+[[nodiscard]] int load_volume_from_file(const std::string& header_filename, Volume& volume, VolumeStorage storage, VoxelLayout layout)
+{
+    const std::string volume_folder = "data/volume/";
+    if (!std::filesystem::exists(volume_folder)) std::filesystem::create_directories(volume_folder);
+    volume.name = header_filename.substr(0, header_filename.find_last_of('.'));
+    volume.layout = VoxelLayout::Linear;
+    volume.stats.reset();
+    NrrdHeader header;
+    if (read_nrrd_header(volume_folder + header_filename, header) != 0) return 1;
+    volume.resolution = header.resolution;
+    std::cout << "Parsed sizes: " << volume.resolution.x << " " << volume.resolution.y << " " << volume.resolution.z << std::endl;
+    std::cout << "Data file path: " << header.data_file.filename().string() << std::endl;
+    if (header.timesteps > 1)
     {
-        std::cerr << "Failed to read raw data file!" << std::endl;
+        std::cerr << header_filename << " holds " << header.timesteps << " timesteps, open it as a series." << std::endl;
         return 1;
     }
 
-    file.close();
+    // calculate expected size of volume
+    size_t volume_size = size_t(volume.resolution.x) * volume.resolution.y * volume.resolution.z;
+
+    const std::filesystem::path& raw_file_path = header.data_file;
 
-    // Debug: print first few values of the volume data
-    std::cout << "Volume data loaded successfully." << std::endl;
-    float avg = 0.0f;
-    float min = std::numeric_limits<float>::max();
-    float max = std::numeric_limits<float>::lowest();
-    float variance = 0.0f;
-    float std = 0.0f;
-    for (const uint8_t value : volume.data) 
+    if (header.encoding == VolumeEncoding::Gzip)
     {
-        avg += float(value) / float(volume.data.size());
-        min = std::min(min, float(value));
-        max = std::max(max, float(value));
+        // compressed data is always inflated into owned memory
+        Timer<float> inflate_timer;
+        volume.data.resize(volume_size);
+        if (inflate_file(raw_file_path, volume.data.data(), volume_size) != 0) return 1;
+        std::cout << CLR_GREEN << "[TIMING] inflate " << raw_file_path.filename().string() << ": " << inflate_timer.elapsed<std::milli>() << " ms" << CLR_RESET << std::endl;
     }
-    std::printf("avg: %.3f, min: %.3f, max: %.3f", avg, min, max);
-    std::cout << std::endl;
-
-    size_t num_non_zero = 0;
-    for (size_t i = 0; i < volume.data.size(); ++i) 
+    else if (storage == VolumeStorage::Mapped)
     {
-        if (volume.data[i] != 0) 
+        std::error_code ec;
+        const uintmax_t file_size = std::filesystem::file_size(raw_file_path, ec);
+        if (ec)
+        {
+            std::cerr << "Failed to open raw data file: " << raw_file_path << std::endl;
+            return 1;
+        }
+        if (file_size != volume_size)
         {
-            num_non_zero++;
+            std::cerr << "File size mismatch! Read: " << file_size << ", expected: " << volume_size << std::endl;
+            return 1;
         }
+        if (map_raw_file(raw_file_path, volume_size, volume.data) != 0) return 1;
+        std::cout << "Mapped raw data file: " << raw_file_path << " (" << volume_size << " bytes)" << std::endl;
+        // no statistics pass, it would fault in the whole file
+        if (layout == VoxelLayout::Linear) return 0;
+    }
+    else if (read_raw_file(raw_file_path, volume_size, volume.data) != 0)
+    {
+        return 1;
+    }
+
+    std::cout << "Volume data loaded successfully." << std::endl;
+    if (layout != VoxelLayout::Linear)
+    {
+        Timer<float> layout_timer;
+        volume = relayout_volume(volume, layout);
+        std::cout << CLR_GREEN << "[TIMING] " << voxel_layout_name(layout) << " layout: " << layout_timer.elapsed<std::milli>() << " ms" << CLR_RESET << std::endl;
     }
-    std::cout << "Number of non-zero voxels: " << num_non_zero << std::endl;
+    Timer<float> stats_timer;
+    const VolumeStats& stats = volume_stats(volume);
+    std::cout << CLR_GREEN << "[TIMING] volume stats: " << stats_timer.elapsed<std::milli>() << " ms" << CLR_RESET << std::endl;
+    std::cout << "avg: " << stats.mean << ", std: " << std::sqrt(stats.variance) << ", min: " << int(stats.min) << ", max: " << int(stats.max) << std::endl;
+    std::cout << "Number of non-zero voxels: " << stats.nonzero << std::endl;
 
     return 0;
 }
 
-// computes central‐difference gradient magnitude, normalizes to [0,255]
-Volume compute_gradient_volume(const Volume& volume)
+[[nodiscard]] int save_volume_to_file(const std::string& header_path, const Volume& volume, VolumeEncoding encoding)
 {
-    Volume grad = volume;
-    uint32_t X = volume.resolution.x, Y = volume.resolution.y, Z = volume.resolution.z;
-    auto idx = [&](int x, int y, int z){ return size_t(z) * Y * X + size_t(y) * X + size_t(x); };
-
-    // compute raw float magnitudes
-    std::vector<float> mags(X * Y * Z, 0.0f);
-    float max_mag = 0.0f;
-    for (int z = 1; z < int(Z) - 1; ++z)
+    if (volume.layout != VoxelLayout::Linear) return save_volume_to_file(header_path, relayout_volume(volume, VoxelLayout::Linear), encoding);
+
+    const std::filesystem::path header(header_path);
+    if (header.has_parent_path()) std::filesystem::create_directories(header.parent_path());
+    const std::filesystem::path data_path = std::filesystem::path(header).replace_extension(encoding == VolumeEncoding::Gzip ? ".raw.gz" : ".raw");
+
+    std::ofstream out(data_path, std::ios::binary);
+    if (!out.is_open())
     {
-      for (int y = 1; y < int(Y) - 1; ++y)
-      {
-        for (int x = 1; x < int(X)-1; ++x)
+        std::cerr << "Failed to open data file for writing: " << data_path << std::endl;
+        return 1;
+    }
+    if (encoding == VolumeEncoding::Gzip)
+    {
+        std::vector<uint8_t> compressed;
+        if (gzip_blocks(volume.data.data(), volume.data.size(), compressed) != 0)
         {
-          float gx = (float(volume.data[idx(x + 1, y, z)]) - float(volume.data[idx(x - 1, y, z)])) * 0.5f;
-          float gy = (float(volume.data[idx(x, y + 1, z)]) - float(volume.data[idx(x, y - 1, z)])) * 0.5f;
-          float gz = (float(volume.data[idx(x, y, z + 1)]) - float(volume.data[idx(x, y, z - 1)])) * 0.5f;
-          float m = std::sqrt(gx * gx + gy * gy + gz * gz);
-          mags[idx(x, y, z)] = m;
-          max_mag = std::max(max_mag, m);
+            std::cerr << "Failed to compress data file: " << data_path << std::endl;
+            return 1;
         }
-      }
+        out.write(reinterpret_cast<const char*>(compressed.data()), std::streamsize(compressed.size()));
     }
+    else
+    {
+        out.write(reinterpret_cast<const char*>(volume.data.data()), std::streamsize(volume.data.size()));
+    }
+    if (!out)
+    {
+        std::cerr << "Failed to write data file: " << data_path << std::endl;
+        return 1;
+    }
+    out.close();
+    return write_nrrd_header(header_path, volume.resolution, encoding, data_path.filename().string());
+}
 
-    // normalize into 0..255 integer range
-    if (max_mag < 1e-6f) max_mag = 1.0f;
-    for (size_t i = 0; i < mags.size(); ++i)
+[[nodiscard]] int write_nrrd_header(const std::string& header_path, glm::uvec3 resolution, VolumeEncoding encoding, const std::string& data_file)
+{
+    std::ofstream nhdr(header_path);
+    if (!nhdr.is_open())
     {
-      uint32_t v = uint32_t(std::clamp((mags[i]/max_mag) * 255.0f, 0.0f, 255.0f));
-      grad.data[i] = v;
+        std::cerr << "Failed to open header file for writing: " << header_path << std::endl;
+        return 1;
     }
-    return grad;
+    nhdr << "NRRD0005\n"
+         << "type: uint8\n"
+         << "dimension: 3\n"
+         << "sizes: " << resolution.x << " " << resolution.y << " " << resolution.z << "\n"
+         << "encoding: " << (encoding == VolumeEncoding::Gzip ? "gzip" : "raw") << "\n"
+         << "data file: " << data_file << "\n"
+         << "space directions: (1,0,0) (0,1,0) (0,0,1)\n";
+    return nhdr ? 0 : 1;
 }
 
 Volume create_simple_volume()
@@ -269,4 +421,26 @@ Volume create_gradient_volume()
         }
     }
     return volume;
-}
\ No newline at end of file
+}
+
+Volume scale_volume(const Volume& volume, uint32_t factor)
+{
+    if (volume.layout != VoxelLayout::Linear) return relayout_volume(scale_volume(relayout_volume(volume, VoxelLayout::Linear), factor), volume.layout);
+    Volume scaled;
+    scaled.name = volume.name.empty() ? "" : volume.name + "_x" + std::to_string(factor);
+    scaled.resolution = volume.resolution * factor;
+    const uint32_t X = scaled.resolution.x, Y = scaled.resolution.y, Z = scaled.resolution.z;
+    scaled.data.resize(size_t(X) * Y * Z);
+
+    #pragma omp parallel for schedule(static)
+    for (int z = 0; z < int(Z); ++z)
+    {
+        for (uint32_t y = 0; y < Y; ++y)
+        {
+            const uint8_t* src = volume.data.data() + (size_t(z / factor) * volume.resolution.y + y / factor) * volume.resolution.x;
+            uint8_t* dst = scaled.data.data() + (size_t(z) * Y + y) * X;
+            for (uint32_t x = 0; x < X; ++x) dst[x] = src[x / factor];
+        }
+    }
+    return scaled;
+}
@@ -0,0 +1,225 @@
+#include "volume_compression.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace
+{
+constexpr size_t BLOCK_HEADER_SIZE = 20; // gzip header with one 8 byte extra field
+constexpr size_t BLOCK_FOOTER_SIZE = 8; // crc32 and input size
+constexpr size_t STREAM_CHUNK = size_t(1) << 30; // zlib counts in 32 bit
+
+void put16(uint8_t* p, uint32_t value)
+{
+    p[0] = uint8_t(value);
+    p[1] = uint8_t(value >> 8);
+}
+
+void put32(uint8_t* p, uint32_t value)
+{
+    put16(p, value);
+    put16(p + 2, value >> 16);
+}
+
+uint32_t get16(const uint8_t* p)
+{
+    return uint32_t(p[0]) | uint32_t(p[1]) << 8;
+}
+
+uint32_t get32(const uint8_t* p)
+{
+    return get16(p) | get16(p + 2) << 16;
+}
+
+struct Block
+{
+    size_t offset; // of the member in the file
+    size_t size; // of the whole member
+    size_t out_offset;
+    size_t out_size;
+};
+
+// walks the members, false as soon as one lacks the block size field
+bool find_blocks(const uint8_t* file, size_t file_size, std::vector<Block>& blocks)
+{
+    size_t offset = 0, out_offset = 0;
+    while (offset < file_size)
+    {
+        const uint8_t* member = file + offset;
+        if (file_size - offset < BLOCK_HEADER_SIZE + BLOCK_FOOTER_SIZE) return false;
+        if (member[0] != 0x1f || member[1] != 0x8b || member[2] != Z_DEFLATED || !(member[3] & 4)) return false;
+        if (get16(member + 10) != 8 || member[12] != 'A' || member[13] != 'T' || get16(member + 14) != 4) return false;
+        const size_t size = get32(member + 16);
+        if (size < BLOCK_HEADER_SIZE + BLOCK_FOOTER_SIZE || size > file_size - offset) return false;
+        const size_t out_size = get32(member + size - 4);
+        blocks.push_back({offset, size, out_offset, out_size});
+        offset += size;
+        out_offset += out_size;
+    }
+    return true;
+}
+
+// raw inflate of one member body, checked against its crc
+bool inflate_block(const uint8_t* member, const Block& block, uint8_t* out)
+{
+    z_stream zs{};
+    if (inflateInit2(&zs, -MAX_WBITS) != Z_OK) return false;
+    zs.next_in = const_cast<Bytef*>(member + BLOCK_HEADER_SIZE);
+    zs.avail_in = uInt(block.size - BLOCK_HEADER_SIZE - BLOCK_FOOTER_SIZE);
+    zs.next_out = out;
+    zs.avail_out = uInt(block.out_size);
+    const int ret = inflate(&zs, Z_FINISH);
+    const bool ok = ret == Z_STREAM_END && zs.avail_out == 0;
+    inflateEnd(&zs);
+    return ok && crc32(0, out, uInt(block.out_size)) == get32(member + block.size - BLOCK_FOOTER_SIZE);
+}
+
+// any gzip or zlib stream, concatenated gzip members included
+bool inflate_stream(const uint8_t* file, size_t file_size, uint8_t* out, size_t size)
+{
+    z_stream zs{};
+    if (inflateInit2(&zs, MAX_WBITS + 32) != Z_OK) return false;
+    size_t in_offset = 0, out_offset = 0;
+    int ret = Z_OK;
+    while (true)
+    {
+        if (zs.avail_in == 0 && in_offset < file_size)
+        {
+            const size_t n = std::min(file_size - in_offset, STREAM_CHUNK);
+            zs.next_in = const_cast<Bytef*>(file + in_offset);
+            zs.avail_in = uInt(n);
+            in_offset += n;
+        }
+        if (zs.avail_out == 0 && out_offset < size)
+        {
+            const size_t n = std::min(size - out_offset, STREAM_CHUNK);
+            zs.next_out = out + out_offset;
+            zs.avail_out = uInt(n);
+            out_offset += n;
+        }
+        ret = inflate(&zs, Z_NO_FLUSH);
+        if (ret == Z_STREAM_END)
+        {
+            if (zs.avail_in == 0 && in_offset == file_size) break;
+            inflateReset(&zs);
+        }
+        else if (ret != Z_OK)
+        {
+            break;
+        }
+    }
+    const size_t produced = out_offset - zs.avail_out;
+    inflateEnd(&zs);
+    return ret == Z_STREAM_END && produced == size;
+}
+} // namespace
+
+int gzip_blocks(const uint8_t* data, size_t size, std::vector<uint8_t>& out, int level, size_t block_size)
+{
+    const size_t count = (size + block_size - 1) / block_size;
+    std::vector<std::vector<uint8_t>> members(count);
+    int failed = 0;
+    #pragma omp parallel for schedule(dynamic) reduction(+:failed)
+    for (int64_t b = 0; b < int64_t(count); ++b)
+    {
+        const uint8_t* in = data + size_t(b) * block_size;
+        const size_t n = std::min(block_size, size - size_t(b) * block_size);
+        std::vector<uint8_t>& member = members[b];
+
+        // deflateBound leaves room for the whole block, one call finishes it
+        z_stream zs{};
+        if (deflateInit2(&zs, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+            failed++;
+            continue;
+        }
+        member.resize(BLOCK_HEADER_SIZE + deflateBound(&zs, uLong(n)) + BLOCK_FOOTER_SIZE);
+        zs.next_in = const_cast<Bytef*>(in);
+        zs.avail_in = uInt(n);
+        zs.next_out = member.data() + BLOCK_HEADER_SIZE;
+        zs.avail_out = uInt(member.size() - BLOCK_HEADER_SIZE - BLOCK_FOOTER_SIZE);
+        const int ret = deflate(&zs, Z_FINISH);
+        const size_t compressed = zs.total_out;
+        deflateEnd(&zs);
+        if (ret != Z_STREAM_END)
+        {
+            failed++;
+            continue;
+        }
+        member.resize(BLOCK_HEADER_SIZE + compressed + BLOCK_FOOTER_SIZE);
+
+        // magic, deflate, FEXTRA, no mtime, no extra flags, unknown os, then the "AT" field with the member size
+        const uint8_t header[16] = {0x1f, 0x8b, Z_DEFLATED, 4, 0, 0, 0, 0, 0, 0xff, 8, 0, 'A', 'T', 4, 0};
+        std::copy(header, header + 16, member.begin());
+        put32(member.data() + 16, uint32_t(member.size()));
+        uint8_t* footer = member.data() + BLOCK_HEADER_SIZE + compressed;
+        put32(footer, uint32_t(crc32(0, in, uInt(n))));
+        put32(footer + 4, uint32_t(n));
+    }
+    if (failed > 0)
+    {
+        std::cerr << "Failed to deflate " << failed << " of " << count << " blocks." << std::endl;
+        return 1;
+    }
+    size_t total = out.size();
+    for (const std::vector<uint8_t>& member : members) total += member.size();
+    out.reserve(total);
+    for (const std::vector<uint8_t>& member : members) out.insert(out.end(), member.begin(), member.end());
+    return 0;
+}
+
+int inflate_file(const std::filesystem::path& path, uint8_t* out, size_t size)
+{
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        std::cerr << "Failed to open compressed data file: " << path << std::endl;
+        return 1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        std::cerr << "Compressed data file is empty: " << path << std::endl;
+        return 1;
+    }
+    const size_t file_size = size_t(st.st_size);
+    void* mapping = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        std::cerr << "Failed to map compressed data file: " << path << std::endl;
+        return 1;
+    }
+    const uint8_t* file = static_cast<const uint8_t*>(mapping);
+
+    bool ok = true;
+    std::vector<Block> blocks;
+    if (find_blocks(file, file_size, blocks) && !blocks.empty() && blocks.back().out_offset + blocks.back().out_size == size)
+    {
+        int failed = 0;
+        #pragma omp parallel for schedule(dynamic) reduction(+:failed)
+        for (int64_t b = 0; b < int64_t(blocks.size()); ++b)
+        {
+            if (!inflate_block(file + blocks[b].offset, blocks[b], out + blocks[b].out_offset)) failed++;
+        }
+        ok = failed == 0;
+    }
+    else
+    {
+        madvise(mapping, file_size, MADV_SEQUENTIAL);
+        ok = inflate_stream(file, file_size, out, size);
+    }
+    munmap(mapping, file_size);
+    if (!ok)
+    {
+        std::cerr << "Failed to inflate " << path << " into " << size << " bytes, the file is corrupt or of another size." << std::endl;
+        return 1;
+    }
+    return 0;
+}
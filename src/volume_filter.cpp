@@ -0,0 +1,310 @@
+#include "volume_filter.hpp"
+#include "util/timer.hpp"
+#include "volume_layout.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace
+{
+// normalized 1D gaussian weights for the offsets -radius..radius
+std::vector<float> gaussian_weights(uint32_t radius, float sigma)
+{
+    const float s = std::max(sigma, 1e-3f);
+    std::vector<float> weights(2 * radius + 1);
+    float sum = 0.0f;
+    for (int k = -int(radius); k <= int(radius); ++k)
+    {
+        weights[k + radius] = std::exp(-float(k * k) / (2.0f * s * s));
+        sum += weights[k + radius];
+    }
+    for (float& w : weights) w /= sum;
+    return weights;
+}
+
+inline size_t clamp_coord(int c, uint32_t size)
+{
+    return size_t(std::clamp(c, 0, int(size) - 1));
+}
+
+// copy a row into dst and replicate the border values pad times on both sides
+template<class T>
+inline void pad_row(const T* src, uint32_t width, uint32_t pad, T* dst)
+{
+    std::fill(dst, dst + pad, src[0]);
+    std::copy(src, src + width, dst + pad);
+    std::fill(dst + pad + width, dst + 2 * pad + width, src[width - 1]);
+}
+
+// element-wise compare-exchange of two rows: a receives the minimum, b the maximum
+inline void compare_exchange(uint8_t* a, uint8_t* b, uint32_t width)
+{
+    #pragma omp simd
+    for (uint32_t x = 0; x < width; ++x)
+    {
+        uint8_t lo = std::min(a[x], b[x]);
+        uint8_t hi = std::max(a[x], b[x]);
+        a[x] = lo;
+        b[x] = hi;
+    }
+}
+
+Volume empty_like(const Volume& volume)
+{
+    Volume out;
+    out.name = volume.name;
+    out.resolution = volume.resolution;
+    out.data.resize(volume.data.size());
+    return out;
+}
+} // namespace
+
+// separable gaussian, one output slice per iteration: z pass, then y pass, then x pass
+// every pass runs along contiguous x-rows so the inner loops vectorize
+Volume gaussian_filter(const Volume& volume, uint32_t radius, float sigma)
+{
+    const uint32_t X = volume.resolution.x, Y = volume.resolution.y, Z = volume.resolution.z;
+    const size_t slice = size_t(X) * Y;
+    const int r = int(radius);
+    const std::vector<float> weights = gaussian_weights(radius, sigma);
+    Volume out = empty_like(volume);
+
+    #pragma omp parallel
+    {
+        // per thread scratch, bounded by one slice
+        std::vector<float> acc(slice), tmp(slice), row(X + 2 * r), res(X);
+
+        #pragma omp for schedule(dynamic, 1)
+        for (int z = 0; z < int(Z); ++z)
+        {
+            std::fill(acc.begin(), acc.end(), 0.0f);
+            for (int k = -r; k <= r; ++k)
+            {
+                const uint8_t* src = volume.data.data() + clamp_coord(z + k, Z) * slice;
+                const float w = weights[k + r];
+                #pragma omp simd
+                for (size_t i = 0; i < slice; ++i) acc[i] += w * float(src[i]);
+            }
+
+            for (int y = 0; y < int(Y); ++y)
+            {
+                float* dst = tmp.data() + size_t(y) * X;
+                std::fill(dst, dst + X, 0.0f);
+                for (int k = -r; k <= r; ++k)
+                {
+                    const float* src = acc.data() + clamp_coord(y + k, Y) * X;
+                    const float w = weights[k + r];
+                    #pragma omp simd
+                    for (uint32_t x = 0; x < X; ++x) dst[x] += w * src[x];
+                }
+            }
+
+            uint8_t* out_slice = out.data.data() + size_t(z) * slice;
+            for (uint32_t y = 0; y < Y; ++y)
+            {
+                pad_row(tmp.data() + size_t(y) * X, X, radius, row.data());
+                std::fill(res.begin(), res.end(), 0.0f);
+                for (int k = 0; k <= 2 * r; ++k)
+                {
+                    const float* tap = row.data() + k;
+                    const float w = weights[k];
+                    #pragma omp simd
+                    for (uint32_t x = 0; x < X; ++x) res[x] += w * tap[x];
+                }
+                uint8_t* dst = out_slice + size_t(y) * X;
+                #pragma omp simd
+                for (uint32_t x = 0; x < X; ++x) dst[x] = uint8_t(std::clamp(res[x] + 0.5f, 0.0f, 255.0f));
+            }
+        }
+    }
+    return out;
+}
+
+// 3x3x3 median by forgetful selection over whole x-rows: start with 15 of the 27 taps,
+// repeatedly drop the row-wise min and max and pull in the next tap until one row is left
+Volume median_filter(const Volume& volume)
+{
+    const uint32_t X = volume.resolution.x, Y = volume.resolution.y, Z = volume.resolution.z;
+    const size_t slice = size_t(X) * Y;
+    Volume out = empty_like(volume);
+
+    #pragma omp parallel
+    {
+        std::vector<uint8_t> padded(9 * size_t(X + 2));
+        std::vector<uint8_t> work(15 * size_t(X));
+
+        #pragma omp for schedule(dynamic, 1)
+        for (int z = 0; z < int(Z); ++z)
+        {
+            for (int y = 0; y < int(Y); ++y)
+            {
+                const uint8_t* taps[27];
+                int t = 0;
+                for (int dz = -1; dz <= 1; ++dz)
+                {
+                    for (int dy = -1; dy <= 1; ++dy)
+                    {
+                        const uint8_t* src = volume.data.data() + clamp_coord(z + dz, Z) * slice + clamp_coord(y + dy, Y) * X;
+                        uint8_t* p = padded.data() + size_t((dz + 1) * 3 + (dy + 1)) * (X + 2);
+                        pad_row(src, X, 1, p);
+                        taps[t++] = p;
+                        taps[t++] = p + 1;
+                        taps[t++] = p + 2;
+                    }
+                }
+
+                uint8_t* active[15];
+                uint8_t* free_rows[2];
+                int count = 15;
+                for (int i = 0; i < count; ++i)
+                {
+                    active[i] = work.data() + size_t(i) * X;
+                    std::copy(taps[i], taps[i] + X, active[i]);
+                }
+                int next = 15;
+                while (true)
+                {
+                    // move the row-wise minimum to the front and the maximum to the back
+                    for (int i = 1; i < count; ++i) compare_exchange(active[0], active[i], X);
+                    for (int i = 1; i < count - 1; ++i) compare_exchange(active[i], active[count - 1], X);
+                    free_rows[0] = active[0];
+                    free_rows[1] = active[count - 1];
+                    for (int i = 0; i < count - 2; ++i) active[i] = active[i + 1];
+                    count -= 2;
+                    if (next == 27) break;
+                    active[count] = free_rows[0];
+                    std::copy(taps[next], taps[next] + X, active[count]);
+                    ++count;
+                    ++next;
+                }
+                std::copy(active[0], active[0] + X, out.data.data() + size_t(z) * slice + size_t(y) * X);
+            }
+        }
+    }
+    return out;
+}
+
+// brute force 3D bilateral filter with a precomputed range kernel lookup table
+Volume bilateral_filter(const Volume& volume, uint32_t radius, float sigma, float range_sigma)
+{
+    const uint32_t X = volume.resolution.x, Y = volume.resolution.y, Z = volume.resolution.z;
+    const size_t slice = size_t(X) * Y;
+    const int r = int(radius);
+    const int size = 2 * r + 1;
+    const float s = std::max(sigma, 1e-3f);
+    const float rs = std::max(range_sigma, 1e-3f);
+
+    std::vector<float> spatial(size_t(size) * size * size);
+    for (int dz = -r; dz <= r; ++dz)
+        for (int dy = -r; dy <= r; ++dy)
+            for (int dx = -r; dx <= r; ++dx)
+                spatial[size_t((dz + r) * size + (dy + r)) * size + (dx + r)] = std::exp(-float(dx * dx + dy * dy + dz * dz) / (2.0f * s * s));
+
+    float range[256];
+    for (int d = 0; d < 256; ++d) range[d] = std::exp(-float(d * d) / (2.0f * rs * rs));
+
+    Volume out = empty_like(volume);
+
+    #pragma omp parallel
+    {
+        std::vector<uint8_t> row(X + 2 * r);
+        std::vector<float> num(X), den(X);
+
+        #pragma omp for schedule(dynamic, 1)
+        for (int z = 0; z < int(Z); ++z)
+        {
+            for (int y = 0; y < int(Y); ++y)
+            {
+                const uint8_t* center = volume.data.data() + size_t(z) * slice + size_t(y) * X;
+                std::fill(num.begin(), num.end(), 0.0f);
+                std::fill(den.begin(), den.end(), 0.0f);
+                for (int dz = -r; dz <= r; ++dz)
+                {
+                    for (int dy = -r; dy <= r; ++dy)
+                    {
+                        pad_row(volume.data.data() + clamp_coord(z + dz, Z) * slice + clamp_coord(y + dy, Y) * X, X, radius, row.data());
+                        const float* ws = spatial.data() + size_t((dz + r) * size + (dy + r)) * size;
+                        for (int k = 0; k < size; ++k)
+                        {
+                            const uint8_t* tap = row.data() + k;
+                            const float w_s = ws[k];
+                            #pragma omp simd
+                            for (uint32_t x = 0; x < X; ++x)
+                            {
+                                float w = w_s * range[std::abs(int(tap[x]) - int(center[x]))];
+                                num[x] += w * float(tap[x]);
+                                den[x] += w;
+                            }
+                        }
+                    }
+                }
+                uint8_t* dst = out.data.data() + size_t(z) * slice + size_t(y) * X;
+                for (uint32_t x = 0; x < X; ++x) dst[x] = uint8_t(std::clamp(num[x] / den[x] + 0.5f, 0.0f, 255.0f));
+            }
+        }
+    }
+    return out;
+}
+
+Volume apply_filter(const Volume& volume, const FilterSettings& settings)
+{
+    if (settings.type == FilterType::None) return volume;
+    // the filters sweep linear rows
+    if (volume.layout != VoxelLayout::Linear) return relayout_volume(apply_filter(relayout_volume(volume, VoxelLayout::Linear), settings), volume.layout);
+
+    Timer<float> timer;
+    Volume filtered;
+    switch (settings.type)
+    {
+        case FilterType::Gaussian:
+            filtered = gaussian_filter(volume, settings.radius, settings.sigma);
+            break;
+        case FilterType::Median:
+            filtered = median_filter(volume);
+            break;
+        case FilterType::Bilateral:
+            filtered = bilateral_filter(volume, settings.radius, settings.sigma, settings.range_sigma);
+            break;
+        default:
+            return volume;
+    }
+    const std::string tag = filter_tag(settings);
+    filtered.name = volume.name.empty() ? tag : volume.name + "_" + tag;
+    std::cout << CLR_GREEN << "[TIMING] " << tag << " filter: " << timer.restart<std::milli>() << " ms\n" << CLR_RESET;
+    return filtered;
+}
+
+bool parse_filter_type(const std::string& name, FilterType& type)
+{
+    if (name == "none") type = FilterType::None;
+    else if (name == "gaussian") type = FilterType::Gaussian;
+    else if (name == "median") type = FilterType::Median;
+    else if (name == "bilateral") type = FilterType::Bilateral;
+    else return false;
+    return true;
+}
+
+std::string filter_tag(const FilterSettings& settings)
+{
+    char buf[64];
+    switch (settings.type)
+    {
+        case FilterType::Gaussian:
+            std::snprintf(buf, sizeof(buf), "gaussian_r%u_s%.2f", settings.radius, settings.sigma);
+            return buf;
+        case FilterType::Median:
+            return "median3";
+        case FilterType::Bilateral:
+            std::snprintf(buf, sizeof(buf), "bilateral_r%u_s%.2f_rs%.1f", settings.radius, settings.sigma, settings.range_sigma);
+            return buf;
+        default:
+            return "";
+    }
+}
@@ -0,0 +1,329 @@
+#include "volume_generator.hpp"
+#include "util/random_generator.hpp"
+#include "util/timer.hpp"
+#include "volume_compression.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <vector>
+
+namespace
+{
+struct Box
+{
+    glm::ivec3 lo; // inclusive
+    glm::ivec3 hi; // exclusive
+    uint8_t value;
+};
+
+struct Torus
+{
+    glm::vec3 center;
+    float radius;
+    float tube;
+    uint8_t peak;
+};
+
+struct Scene
+{
+    std::vector<Box> boxes;
+    std::vector<Torus> tori;
+    std::array<uint8_t, 512> perm;
+    float cell_size; // perlin lattice spacing in voxels
+};
+
+bool overlaps(const Box& a, const Box& b)
+{
+    // keep a one voxel gap so components stay disjoint in the 6-neighbourhood
+    for (int i = 0; i < 3; ++i)
+    {
+        if (a.hi[i] + 1 <= b.lo[i] || b.hi[i] + 1 <= a.lo[i]) return false;
+    }
+    return true;
+}
+
+// every random decision is made here, sequentially from the seed, so the generated slices
+// do not depend on the number of threads or the slab size
+Scene build_scene(const GeneratorSettings& s)
+{
+    Scene scene;
+    RandomGenerator rg(s.seed);
+    const glm::ivec3 res(s.resolution);
+    const float min_dim = float(std::min({s.resolution.x, s.resolution.y, s.resolution.z}));
+
+    std::vector<Box> outer;
+    for (uint32_t c = 0; c < s.components; ++c)
+    {
+        const int half = std::max(1, int(s.component_size * min_dim * (1.0f + s.size_jitter * rg.random_float(-1.0f, 1.0f))));
+        const uint8_t base = uint8_t(rg.random_float(std::min(float(s.background) + 48.0f, 200.0f), 200.0f));
+        Box box;
+        box.value = base;
+        // rejection sampling for a disjoint position, the last candidate is kept if none fits
+        for (int attempt = 0; attempt < 64; ++attempt)
+        {
+            for (int i = 0; i < 3; ++i)
+            {
+                const int extent = std::min(2 * half, res[i]);
+                box.lo[i] = std::min(rg.random_int32(0, res[i] - extent + 1), res[i] - extent);
+                box.hi[i] = box.lo[i] + extent;
+            }
+            if (std::none_of(outer.begin(), outer.end(), [&](const Box& other) { return overlaps(box, other); })) break;
+        }
+        outer.push_back(box);
+
+        scene.boxes.push_back(box);
+        for (uint32_t level = 1; level <= s.nested_levels; ++level)
+        {
+            // shrink towards the center, each level brighter than its parent
+            const float t = float(level) / float(s.nested_levels + 1);
+            Box inner;
+            for (int i = 0; i < 3; ++i)
+            {
+                const int shrink = int(float(box.hi[i] - box.lo[i]) * 0.5f * t);
+                inner.lo[i] = box.lo[i] + shrink;
+                inner.hi[i] = std::max(inner.lo[i] + 1, box.hi[i] - shrink);
+            }
+            inner.value = uint8_t(float(base) + (255.0f - float(base)) * float(level) / float(s.nested_levels));
+            scene.boxes.push_back(inner);
+        }
+    }
+
+    for (uint32_t t = 0; t < s.tori; ++t)
+    {
+        Torus torus;
+        torus.radius = std::max(1.0f, s.torus_radius * min_dim);
+        torus.tube = std::max(1.0f, s.tube_radius * min_dim);
+        const float reach_xy = torus.radius + torus.tube;
+        for (int i = 0; i < 3; ++i)
+        {
+            const float reach = i < 2 ? reach_xy : torus.tube;
+            const float lo = std::min(reach, 0.5f * float(res[i]));
+            torus.center[i] = rg.random_float(lo, std::max(lo, float(res[i]) - reach));
+        }
+        torus.peak = uint8_t(rg.random_float(160.0f, 255.0f));
+        scene.tori.push_back(torus);
+    }
+
+    std::array<uint8_t, 256> p;
+    std::iota(p.begin(), p.end(), 0);
+    std::shuffle(p.begin(), p.end(), rg.get_generator());
+    for (int i = 0; i < 512; ++i) scene.perm[i] = p[i & 255];
+    scene.cell_size = min_dim / std::max(s.noise_scale, 1e-3f);
+    return scene;
+}
+
+// improved perlin noise, roughly in [-1, 1]
+inline float fade(float t) { return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f); }
+
+inline float grad(uint8_t hash, float x, float y, float z)
+{
+    const int h = hash & 15;
+    const float u = h < 8 ? x : y;
+    const float v = h < 4 ? y : (h == 12 || h == 14 ? x : z);
+    return ((h & 1) ? -u : u) + ((h & 2) ? -v : v);
+}
+
+float perlin(const std::array<uint8_t, 512>& perm, float x, float y, float z)
+{
+    const float fx = std::floor(x), fy = std::floor(y), fz = std::floor(z);
+    const int X = int(fx) & 255, Y = int(fy) & 255, Z = int(fz) & 255;
+    x -= fx;
+    y -= fy;
+    z -= fz;
+    const float u = fade(x), v = fade(y), w = fade(z);
+    const int A = perm[X] + Y, AA = perm[A] + Z, AB = perm[A + 1] + Z;
+    const int B = perm[X + 1] + Y, BA = perm[B] + Z, BB = perm[B + 1] + Z;
+    auto lerp = [](float t, float a, float b) { return a + t * (b - a); };
+    return lerp(w, lerp(v, lerp(u, grad(perm[AA], x, y, z), grad(perm[BA], x - 1, y, z)),
+                           lerp(u, grad(perm[AB], x, y - 1, z), grad(perm[BB], x - 1, y - 1, z))),
+                   lerp(v, lerp(u, grad(perm[AA + 1], x, y, z - 1), grad(perm[BA + 1], x - 1, y, z - 1)),
+                           lerp(u, grad(perm[AB + 1], x, y - 1, z - 1), grad(perm[BB + 1], x - 1, y - 1, z - 1))));
+}
+
+// counter based standard normal sample, depends only on the seed and the voxel index
+inline float gaussian_sample(uint64_t seed, uint64_t index)
+{
+    uint64_t h = (seed << 40) ^ index;
+    h += 0x9e3779b97f4a7c15ull;
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+    h ^= h >> 31;
+    const float u1 = (float(h >> 40) + 1.0f) / 16777217.0f;
+    const float u2 = float((h >> 16) & 0xffffff) / 16777216.0f;
+    return std::sqrt(-2.0f * std::log(u1)) * std::cos(6.2831853f * u2);
+}
+
+// fill slices [z_begin, z_end) into dst, which holds (z_end - z_begin) slices
+void generate_slices(const GeneratorSettings& s, const Scene& scene, uint32_t z_begin, uint32_t z_end, uint8_t* dst)
+{
+    const uint32_t X = s.resolution.x, Y = s.resolution.y;
+    const size_t slice = size_t(X) * Y;
+
+    #pragma omp parallel
+    {
+        std::vector<float> row(X);
+
+        #pragma omp for schedule(dynamic, 1)
+        for (int z = int(z_begin); z < int(z_end); ++z)
+        {
+            uint8_t* out_slice = dst + size_t(z - z_begin) * slice;
+            std::fill(out_slice, out_slice + slice, s.background);
+
+            for (const Box& box : scene.boxes)
+            {
+                if (z < box.lo.z || z >= box.hi.z) continue;
+                for (int y = box.lo.y; y < box.hi.y; ++y)
+                {
+                    uint8_t* out_row = out_slice + size_t(y) * X;
+                    for (int x = box.lo.x; x < box.hi.x; ++x) out_row[x] = std::max(out_row[x], box.value);
+                }
+            }
+
+            for (const Torus& torus : scene.tori)
+            {
+                const float dz = float(z) + 0.5f - torus.center.z;
+                const float q = torus.tube * torus.tube - dz * dz;
+                if (q <= 0.0f) continue;
+                // only the x-span within the outer ring radius can be inside the tube
+                const float outer = torus.radius + std::sqrt(q);
+                const int y_lo = std::max(0, int(std::floor(torus.center.y - outer)));
+                const int y_hi = std::min(int(Y), int(std::ceil(torus.center.y + outer)));
+                for (int y = y_lo; y < y_hi; ++y)
+                {
+                    const float dy = float(y) + 0.5f - torus.center.y;
+                    const float span2 = outer * outer - dy * dy;
+                    if (span2 <= 0.0f) continue;
+                    const float span = std::sqrt(span2);
+                    const int x_lo = std::max(0, int(std::floor(torus.center.x - span)));
+                    const int x_hi = std::min(int(X), int(std::ceil(torus.center.x + span)));
+                    uint8_t* out_row = out_slice + size_t(y) * X;
+                    for (int x = x_lo; x < x_hi; ++x)
+                    {
+                        const float dx = float(x) + 0.5f - torus.center.x;
+                        const float ring = std::sqrt(dx * dx + dy * dy) - torus.radius;
+                        const float d = std::sqrt(ring * ring + dz * dz);
+                        if (d >= torus.tube) continue;
+                        const float v = float(s.background) + (float(torus.peak) - float(s.background)) * (1.0f - d / torus.tube);
+                        out_row[x] = std::max(out_row[x], uint8_t(std::clamp(v, 0.0f, 255.0f)));
+                    }
+                }
+            }
+
+            if (s.noise == NoiseType::None || s.noise_level <= 0.0f) continue;
+            for (uint32_t y = 0; y < Y; ++y)
+            {
+                uint8_t* out_row = out_slice + size_t(y) * X;
+                if (s.noise == NoiseType::Gaussian)
+                {
+                    const uint64_t base = (size_t(z) * Y + y) * X;
+                    for (uint32_t x = 0; x < X; ++x) row[x] = s.noise_level * gaussian_sample(s.seed, base + x);
+                }
+                else
+                {
+                    const float inv = 1.0f / scene.cell_size;
+                    for (uint32_t x = 0; x < X; ++x) row[x] = s.noise_level * perlin(scene.perm, (float(x) + 0.5f) * inv, (float(y) + 0.5f) * inv, (float(z) + 0.5f) * inv);
+                }
+                #pragma omp simd
+                for (uint32_t x = 0; x < X; ++x) out_row[x] = uint8_t(std::clamp(float(out_row[x]) + row[x] + 0.5f, 0.0f, 255.0f));
+            }
+        }
+    }
+}
+} // namespace
+
+Volume generate_volume(const GeneratorSettings& settings)
+{
+    Timer<float> timer;
+    const Scene scene = build_scene(settings);
+    Volume volume;
+    volume.name = generator_tag(settings);
+    volume.resolution = settings.resolution;
+    volume.data.resize(size_t(settings.resolution.x) * settings.resolution.y * settings.resolution.z);
+    generate_slices(settings, scene, 0, settings.resolution.z, volume.data.data());
+    std::cout << CLR_GREEN << "[TIMING] generate " << volume.name << ": " << timer.restart<std::milli>() << " ms\n" << CLR_RESET;
+    return volume;
+}
+
+[[nodiscard]] int write_generated_volume(const GeneratorSettings& settings, const std::string& header_path, uint32_t slab_depth, VolumeEncoding encoding)
+{
+    Timer<float> timer;
+    const std::filesystem::path header(header_path);
+    if (header.has_parent_path()) std::filesystem::create_directories(header.parent_path());
+    const std::filesystem::path raw_path = std::filesystem::path(header).replace_extension(encoding == VolumeEncoding::Gzip ? ".raw.gz" : ".raw");
+
+    std::ofstream raw(raw_path, std::ios::binary);
+    if (!raw.is_open())
+    {
+        std::cerr << "Failed to open raw data file for writing: " << raw_path << std::endl;
+        return 1;
+    }
+
+    const Scene scene = build_scene(settings);
+    const uint32_t Z = settings.resolution.z;
+    const size_t slice = size_t(settings.resolution.x) * settings.resolution.y;
+    slab_depth = std::clamp(slab_depth, 1u, std::max(Z, 1u));
+    std::vector<uint8_t> slab(slice * slab_depth);
+    std::vector<uint8_t> compressed;
+    for (uint32_t z = 0; z < Z; z += slab_depth)
+    {
+        const uint32_t z_end = std::min(Z, z + slab_depth);
+        generate_slices(settings, scene, z, z_end, slab.data());
+        if (encoding == VolumeEncoding::Gzip)
+        {
+            // every slab ends a block, the members still concatenate to one gzip stream
+            compressed.clear();
+            if (gzip_blocks(slab.data(), slice * (z_end - z), compressed) != 0)
+            {
+                std::cerr << "Failed to compress raw data file: " << raw_path << std::endl;
+                return 1;
+            }
+            raw.write(reinterpret_cast<const char*>(compressed.data()), std::streamsize(compressed.size()));
+        }
+        else
+        {
+            raw.write(reinterpret_cast<const char*>(slab.data()), std::streamsize(slice * (z_end - z)));
+        }
+        if (!raw)
+        {
+            std::cerr << "Failed to write raw data file: " << raw_path << std::endl;
+            return 1;
+        }
+    }
+    raw.close();
+
+    if (write_nrrd_header(header_path, settings.resolution, encoding, raw_path.filename().string()) != 0) return 1;
+
+    const float seconds = timer.restart();
+    const float mb = float(slice) * float(Z) / (1024.0f * 1024.0f);
+    std::cout << CLR_GREEN << "[TIMING] generate and write " << header.string() << ": " << seconds * 1000.0f << " ms (" << mb / std::max(seconds, 1e-6f) << " MB/s)\n" << CLR_RESET;
+    return 0;
+}
+
+bool parse_noise_type(const std::string& name, NoiseType& type)
+{
+    if (name == "none") type = NoiseType::None;
+    else if (name == "gaussian") type = NoiseType::Gaussian;
+    else if (name == "perlin") type = NoiseType::Perlin;
+    else return false;
+    return true;
+}
+
+std::string generator_tag(const GeneratorSettings& settings)
+{
+    const glm::uvec3 r = settings.resolution;
+    std::string tag = "gen_" + (r.x == r.y && r.y == r.z ? std::to_string(r.x) : std::to_string(r.x) + "x" + std::to_string(r.y) + "x" + std::to_string(r.z));
+    tag += "_c" + std::to_string(settings.components) + "_n" + std::to_string(settings.nested_levels) + "_t" + std::to_string(settings.tori);
+    if (settings.noise != NoiseType::None && settings.noise_level > 0.0f)
+    {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "_%s%.0f", settings.noise == NoiseType::Gaussian ? "gauss" : "perlin", settings.noise_level);
+        tag += buf;
+    }
+    return tag + "_s" + std::to_string(settings.seed);
+}
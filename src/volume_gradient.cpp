@@ -0,0 +1,247 @@
+#include "volume_gradient.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include "volume_layout.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace
+{
+// rows of output voxels per task, tasks run along y inside one z slice
+constexpr uint32_t TILE_ROWS = 32;
+
+// smoothing taps across the derivative axis, the derivative itself is always (-1, 0, 1)
+std::array<float, 3> smoothing_taps(GradientOperator op)
+{
+    switch (op)
+    {
+    case GradientOperator::Sobel: return {1.0f, 2.0f, 1.0f};
+    case GradientOperator::Scharr: return {3.0f, 10.0f, 3.0f};
+    default: return {0.0f, 1.0f, 0.0f};
+    }
+}
+
+// outside the volume a coordinate is linearly extrapolated from the two voxels next to the border, so
+// the central difference at the border turns into the one-sided difference; a single voxel is repeated
+struct Tap
+{
+    uint32_t coord;
+    float weight;
+};
+
+int border_taps(int c, uint32_t n, Tap* taps)
+{
+    if (c >= 0 && c < int(n))
+    {
+        taps[0] = {uint32_t(c), 1.0f};
+        return 1;
+    }
+    const uint32_t edge = c < 0 ? 0 : n - 1;
+    if (n == 1)
+    {
+        taps[0] = {edge, 1.0f};
+        return 1;
+    }
+    taps[0] = {edge, 2.0f};
+    taps[1] = {c < 0 ? 1u : n - 2, -1.0f};
+    return 2;
+}
+
+class GradientStencil
+{
+public:
+    GradientStencil(const Volume& volume, GradientOperator op) : volume(volume), at(volume), taps(smoothing_taps(op)), smoothed(op != GradientOperator::Central)
+    {
+        const float sum = taps[0] + taps[1] + taps[2];
+        // a unit ramp has gradient magnitude 1 under every operator
+        scale = 1.0f / (2.0f * sum * sum);
+    }
+
+    // calls row(y, z, squared magnitudes) for every x-row and returns the largest squared magnitude. the
+    // scratch of every thread is a few rows, the magnitudes are only valid during the call
+    template<class RowFn>
+    float sweep(RowFn&& row) const
+    {
+        const uint32_t X = volume.resolution.x, Y = volume.resolution.y, Z = volume.resolution.z;
+        const uint32_t tiles_y = (Y + TILE_ROWS - 1) / TILE_ROWS;
+        const float scale2 = scale * scale;
+        float max_mag2 = 0.0f;
+        #pragma omp parallel reduction(max: max_mag2)
+        {
+            // lines[k][dz] holds the padded x-row at y + k - 1 and z + dz - 1
+            std::vector<float> lines(9 * size_t(X + 2)), a(X + 2), b(X + 2), c(X + 2), mags2(X);
+            auto line = [&](uint32_t slot, uint32_t dz) { return lines.data() + (slot * 3 + dz) * size_t(X + 2); };
+
+            #pragma omp for schedule(dynamic, 1)
+            for (int64_t t = 0; t < int64_t(tiles_y) * Z; ++t)
+            {
+                const uint32_t z = uint32_t(t / tiles_y), y0 = uint32_t(t % tiles_y) * TILE_ROWS, y1 = std::min(y0 + TILE_ROWS, Y);
+                // the three y-neighbours rotate through the slots, every step loads one new y
+                uint32_t slot[3] = {0, 1, 2};
+                for (uint32_t k = 0; k < 2; ++k)
+                {
+                    for (uint32_t dz = 0; dz < 3; ++dz) load_line(int(y0) + int(k) - 1, int(z) + int(dz) - 1, line(slot[k], dz));
+                }
+                for (uint32_t y = y0; y < y1; ++y)
+                {
+                    for (uint32_t dz = 0; dz < 3; ++dz) load_line(int(y) + 1, int(z) + int(dz) - 1, line(slot[2], dz));
+                    const float* r[3][3];
+                    for (uint32_t k = 0; k < 3; ++k)
+                    {
+                        for (uint32_t dz = 0; dz < 3; ++dz) r[k][dz] = line(slot[k], dz);
+                    }
+
+                    if (smoothed)
+                    {
+                        // a smooths y and z for the x-derivative, b smooths z for the y-derivative and
+                        // c smooths y for the z-derivative; the last smoothing runs along x below
+                        const float s0 = taps[0], s1 = taps[1], s2 = taps[2];
+                        #pragma omp simd
+                        for (uint32_t p = 0; p < X + 2; ++p)
+                        {
+                            const float z0 = s0 * r[0][0][p] + s1 * r[1][0][p] + s2 * r[2][0][p];
+                            const float z1 = s0 * r[0][1][p] + s1 * r[1][1][p] + s2 * r[2][1][p];
+                            const float z2 = s0 * r[0][2][p] + s1 * r[1][2][p] + s2 * r[2][2][p];
+                            a[p] = s0 * z0 + s1 * z1 + s2 * z2;
+                            b[p] = s0 * (r[2][0][p] - r[0][0][p]) + s1 * (r[2][1][p] - r[0][1][p]) + s2 * (r[2][2][p] - r[0][2][p]);
+                            c[p] = z2 - z0;
+                        }
+                        #pragma omp simd reduction(max: max_mag2)
+                        for (uint32_t x = 0; x < X; ++x)
+                        {
+                            const float gx = a[x + 2] - a[x];
+                            const float gy = s0 * b[x] + s1 * b[x + 1] + s2 * b[x + 2];
+                            const float gz = s0 * c[x] + s1 * c[x + 1] + s2 * c[x + 2];
+                            mags2[x] = (gx * gx + gy * gy + gz * gz) * scale2;
+                            max_mag2 = std::max(max_mag2, mags2[x]);
+                        }
+                    }
+                    else
+                    {
+                        const float* center = r[1][1];
+                        const float* y_lo = r[0][1] + 1;
+                        const float* y_hi = r[2][1] + 1;
+                        const float* z_lo = r[1][0] + 1;
+                        const float* z_hi = r[1][2] + 1;
+                        #pragma omp simd reduction(max: max_mag2)
+                        for (uint32_t x = 0; x < X; ++x)
+                        {
+                            const float gx = center[x + 2] - center[x];
+                            const float gy = y_hi[x] - y_lo[x];
+                            const float gz = z_hi[x] - z_lo[x];
+                            mags2[x] = (gx * gx + gy * gy + gz * gz) * scale2;
+                            max_mag2 = std::max(max_mag2, mags2[x]);
+                        }
+                    }
+                    row(y, z, mags2.data());
+
+                    const uint32_t oldest = slot[0];
+                    slot[0] = slot[1];
+                    slot[1] = slot[2];
+                    slot[2] = oldest;
+                }
+            }
+        }
+        return max_mag2;
+    }
+
+    const VoxelAddressing& addressing() const { return at; }
+
+private:
+    const Volume& volume;
+    const VoxelAddressing at;
+    const std::array<float, 3> taps;
+    const bool smoothed; // central differences skip the smoothing
+    float scale = 1.0f;
+
+    // x-row (y, z) as floats with one extrapolated voxel on either side, y and z may lie one voxel outside
+    void load_line(int y, int z, float* dst) const
+    {
+        const uint32_t X = volume.resolution.x;
+        Tap ty[2], tz[2];
+        const int ny = border_taps(y, volume.resolution.y, ty), nz = border_taps(z, volume.resolution.z, tz);
+        float* out = dst + 1;
+        if (ny == 1 && nz == 1 && volume.layout == VoxelLayout::Linear)
+        {
+            const uint8_t* src = volume.data.data() + at(0, ty[0].coord, tz[0].coord);
+            #pragma omp simd
+            for (uint32_t x = 0; x < X; ++x) out[x] = float(src[x]);
+        }
+        else
+        {
+            std::fill(out, out + X, 0.0f);
+            for (int i = 0; i < ny; ++i)
+            {
+                for (int j = 0; j < nz; ++j)
+                {
+                    const float w = ty[i].weight * tz[j].weight;
+                    for (uint32_t x = 0; x < X; ++x) out[x] += w * float(volume.data[at(x, ty[i].coord, tz[j].coord)]);
+                }
+            }
+        }
+        dst[0] = X > 1 ? 2.0f * out[0] - out[1] : out[0];
+        dst[X + 1] = X > 1 ? 2.0f * out[X - 1] - out[X - 2] : out[X - 1];
+    }
+};
+} // namespace
+
+// the stencil is evaluated twice, once for the maximum and once to quantize against it, so no full size
+// copy of the magnitudes is ever held
+Volume compute_gradient_volume(const Volume& volume, GradientOperator op)
+{
+    Volume grad;
+    grad.name = volume.name;
+    grad.resolution = volume.resolution;
+    grad.layout = volume.layout;
+    grad.data.resize(volume.data.size());
+    if (volume.resolution.x == 0 || volume.resolution.y == 0 || volume.resolution.z == 0) return grad;
+
+    const GradientStencil stencil(volume, op);
+    float max_mag = std::sqrt(stencil.sweep([](uint32_t, uint32_t, const float*) {}));
+
+    // normalize into 0..255 integer range, padding stays zero
+    if (max_mag < 1e-6f) max_mag = 1.0f;
+    const VoxelAddressing& at = stencil.addressing();
+    const uint32_t X = volume.resolution.x;
+    stencil.sweep([&](uint32_t y, uint32_t z, const float* mags2)
+    {
+        if (volume.layout == VoxelLayout::Linear)
+        {
+            uint8_t* dst = grad.data.data() + at(0, y, z);
+            #pragma omp simd
+            for (uint32_t x = 0; x < X; ++x) dst[x] = uint8_t(std::min(std::sqrt(mags2[x]) / max_mag * 255.0f, 255.0f));
+        }
+        else
+        {
+            for (uint32_t x = 0; x < X; ++x) grad.data[at(x, y, z)] = uint8_t(std::min(std::sqrt(mags2[x]) / max_mag * 255.0f, 255.0f));
+        }
+    });
+    return grad;
+}
+
+bool parse_gradient_operator(const std::string& name, GradientOperator& op)
+{
+    for (GradientOperator o : {GradientOperator::Central, GradientOperator::Sobel, GradientOperator::Scharr})
+    {
+        if (name == gradient_operator_name(o))
+        {
+            op = o;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string gradient_operator_name(GradientOperator op)
+{
+    switch (op)
+    {
+    case GradientOperator::Sobel: return "sobel";
+    case GradientOperator::Scharr: return "scharr";
+    default: return "central";
+    }
+}
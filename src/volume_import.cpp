@@ -0,0 +1,152 @@
+#include "volume_import.hpp"
+#include "util/timer.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+
+#include <vtkDICOMImageReader.h>
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkMetaImageReader.h>
+#include <vtkPointData.h>
+#include <vtkSmartPointer.h>
+#include <vtkXMLImageDataReader.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace
+{
+std::filesystem::path resolve(const std::string& path)
+{
+    if (std::filesystem::exists(path)) return path;
+    return std::filesystem::path("data/volume") / path;
+}
+
+std::string lower_extension(const std::filesystem::path& path)
+{
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+    return ext;
+}
+
+// linear map of [lo, hi] onto 0..255
+template<class T>
+void quantize(const T* in, size_t count, double lo, double hi, uint8_t* out)
+{
+    const double scale = hi > lo ? 255.0 / (hi - lo) : 0.0;
+    #pragma omp parallel for schedule(static)
+    for (int64_t i = 0; i < int64_t(count); ++i)
+    {
+        out[i] = uint8_t(std::clamp((double(in[i]) - lo) * scale + 0.5, 0.0, 255.0));
+    }
+}
+
+vtkSmartPointer<vtkImageData> read_image(const std::filesystem::path& path)
+{
+    vtkSmartPointer<vtkAlgorithm> reader;
+    const std::string ext = lower_extension(path);
+    if (std::filesystem::is_directory(path))
+    {
+        auto dicom = vtkSmartPointer<vtkDICOMImageReader>::New();
+        dicom->SetDirectoryName(path.c_str());
+        // keep the slice rows in file order, the same order the NRRD loader uses
+        dicom->FileLowerLeftOn();
+        reader = dicom;
+    }
+    else if (ext == ".vti")
+    {
+        auto xml = vtkSmartPointer<vtkXMLImageDataReader>::New();
+        if (!xml->CanReadFile(path.c_str())) return nullptr;
+        xml->SetFileName(path.c_str());
+        reader = xml;
+    }
+    else if (ext == ".mha" || ext == ".mhd")
+    {
+        auto meta = vtkSmartPointer<vtkMetaImageReader>::New();
+        if (!meta->CanReadFile(path.c_str())) return nullptr;
+        meta->SetFileName(path.c_str());
+        reader = meta;
+    }
+    else
+    {
+        return nullptr;
+    }
+    reader->Update();
+    if (reader->GetErrorCode() != 0) return nullptr;
+    // the image outlives the reader, it only keeps the arrays alive
+    return vtkImageData::SafeDownCast(reader->GetOutputDataObject(0));
+}
+} // namespace
+
+bool is_importable_volume(const std::string& path)
+{
+    const std::filesystem::path resolved = resolve(path);
+    if (std::filesystem::is_directory(resolved)) return true;
+    const std::string ext = lower_extension(resolved);
+    return ext == ".vti" || ext == ".mha" || ext == ".mhd";
+}
+
+int import_volume(const std::string& path, Volume& volume)
+{
+    Timer<float> timer;
+    const std::filesystem::path resolved = resolve(path);
+    vtkSmartPointer<vtkImageData> image = read_image(resolved);
+    if (!image)
+    {
+        std::cerr << "Failed to read volume through VTK: " << resolved << std::endl;
+        return 1;
+    }
+    vtkSmartPointer<vtkDataArray> scalars = image->GetPointData()->GetScalars();
+    int dims[3];
+    image->GetDimensions(dims);
+    if (!scalars || dims[0] <= 0 || dims[1] <= 0 || dims[2] <= 0)
+    {
+        std::cerr << "No scalar volume in " << resolved << std::endl;
+        return 1;
+    }
+    if (scalars->GetNumberOfComponents() != 1)
+    {
+        std::cerr << "Expected one scalar component in " << resolved << ", found " << scalars->GetNumberOfComponents() << std::endl;
+        return 1;
+    }
+
+    volume.name = (resolved.has_filename() ? resolved.stem() : resolved.parent_path().filename()).string();
+    volume.resolution = glm::uvec3(dims[0], dims[1], dims[2]);
+    volume.layout = VoxelLayout::Linear;
+    volume.stats.reset();
+    const size_t count = size_t(dims[0]) * dims[1] * dims[2];
+    if (size_t(scalars->GetNumberOfTuples()) != count)
+    {
+        std::cerr << "Scalar count " << scalars->GetNumberOfTuples() << " does not match the dimensions of " << resolved << std::endl;
+        return 1;
+    }
+
+    // point data is x fastest like Volume::data
+    if (scalars->GetDataType() == VTK_UNSIGNED_CHAR)
+    {
+        auto owner = std::make_shared<vtkSmartPointer<vtkDataArray>>(scalars);
+        volume.data.adopt(static_cast<uint8_t*>(scalars->GetVoidPointer(0)), count, owner);
+    }
+    else
+    {
+        double range[2];
+        scalars->GetRange(range, 0);
+        volume.data.resize(count);
+        switch (scalars->GetDataType())
+        {
+            vtkTemplateMacro(quantize(static_cast<const VTK_TT*>(scalars->GetVoidPointer(0)), count, range[0], range[1], volume.data.data()));
+            default:
+                std::cerr << "Unsupported scalar type " << scalars->GetDataTypeAsString() << " in " << resolved << std::endl;
+                return 1;
+        }
+        std::cout << "Rescaled " << scalars->GetDataTypeAsString() << " values " << range[0] << " - " << range[1] << " into uint8" << std::endl;
+    }
+    std::cout << CLR_GREEN << "[TIMING] import " << resolved.filename().string() << ": " << timer.elapsed<std::milli>() << " ms" << CLR_RESET << std::endl;
+    std::cout << "Imported " << volume.name << ": " << dims[0] << "x" << dims[1] << "x" << dims[2] << std::endl;
+    return 0;
+}
@@ -0,0 +1,108 @@
+#include "volume_layout.hpp"
+
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace
+{
+uint32_t ceil_log2(uint32_t n)
+{
+    uint32_t bits = 0;
+    while ((uint64_t(1) << bits) < n) bits++;
+    return bits;
+}
+} // namespace
+
+VoxelAddressing::VoxelAddressing(VoxelLayout layout, glm::uvec3 resolution)
+    : x_offset(resolution.x), y_offset(resolution.y), z_offset(resolution.z)
+{
+    const uint32_t X = resolution.x, Y = resolution.y, Z = resolution.z;
+    if (layout == VoxelLayout::Bricked)
+    {
+        const size_t bricks_x = (X + BRICK_SIZE - 1) / BRICK_SIZE;
+        const size_t bricks_y = (Y + BRICK_SIZE - 1) / BRICK_SIZE;
+        const size_t bricks_z = (Z + BRICK_SIZE - 1) / BRICK_SIZE;
+        const size_t brick = size_t(BRICK_SIZE) * BRICK_SIZE * BRICK_SIZE;
+        for (uint32_t x = 0; x < X; ++x) x_offset[x] = (x / BRICK_SIZE) * brick + x % BRICK_SIZE;
+        for (uint32_t y = 0; y < Y; ++y) y_offset[y] = (y / BRICK_SIZE) * bricks_x * brick + (y % BRICK_SIZE) * BRICK_SIZE;
+        for (uint32_t z = 0; z < Z; ++z) z_offset[z] = (z / BRICK_SIZE) * bricks_x * bricks_y * brick + (z % BRICK_SIZE) * BRICK_SIZE * BRICK_SIZE;
+        storage = bricks_x * bricks_y * bricks_z * brick;
+    }
+    else if (layout == VoxelLayout::Morton)
+    {
+        // hand out the output bits level by level, x before y before z
+        const uint32_t bits[3] = {ceil_log2(X), ceil_log2(Y), ceil_log2(Z)};
+        std::vector<size_t>* tables[3] = {&x_offset, &y_offset, &z_offset};
+        uint32_t out_bit = 0;
+        for (uint32_t level = 0; level < std::max({bits[0], bits[1], bits[2]}); ++level)
+        {
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                if (level >= bits[axis]) continue;
+                std::vector<size_t>& table = *tables[axis];
+                for (size_t c = 0; c < table.size(); ++c)
+                {
+                    if (c >> level & 1) table[c] |= size_t(1) << out_bit;
+                }
+                out_bit++;
+            }
+        }
+        storage = size_t(1) << out_bit;
+    }
+    else
+    {
+        for (uint32_t x = 0; x < X; ++x) x_offset[x] = x;
+        for (uint32_t y = 0; y < Y; ++y) y_offset[y] = size_t(y) * X;
+        for (uint32_t z = 0; z < Z; ++z) z_offset[z] = size_t(z) * X * Y;
+        storage = size_t(X) * Y * Z;
+    }
+}
+
+Volume relayout_volume(const Volume& volume, VoxelLayout layout)
+{
+    if (volume.layout == layout) return volume;
+    const VoxelAddressing src(volume);
+    const VoxelAddressing dst(layout, volume.resolution);
+
+    Volume out;
+    out.name = volume.name;
+    out.resolution = volume.resolution;
+    out.layout = layout;
+    out.data.resize(dst.storage_size());
+    out.stats = volume.stats;
+
+    // one row per iteration, the linear side is read or written contiguously
+    const int64_t rows = int64_t(volume.resolution.y) * volume.resolution.z;
+    #pragma omp parallel for schedule(static)
+    for (int64_t r = 0; r < rows; ++r)
+    {
+        const uint32_t y = uint32_t(r % volume.resolution.y), z = uint32_t(r / volume.resolution.y);
+        for (uint32_t x = 0; x < volume.resolution.x; ++x)
+        {
+            out.data[dst(x, y, z)] = volume.data[src(x, y, z)];
+        }
+    }
+    return out;
+}
+
+bool parse_voxel_layout(const std::string& name, VoxelLayout& layout)
+{
+    if (name == "linear") layout = VoxelLayout::Linear;
+    else if (name == "bricked") layout = VoxelLayout::Bricked;
+    else if (name == "morton") layout = VoxelLayout::Morton;
+    else return false;
+    return true;
+}
+
+std::string voxel_layout_name(VoxelLayout layout)
+{
+    switch (layout)
+    {
+        case VoxelLayout::Bricked: return "bricked";
+        case VoxelLayout::Morton: return "morton";
+        default: return "linear";
+    }
+}
@@ -0,0 +1,89 @@
+#include "volume_loader.hpp"
+#include "volume_compression.hpp"
+#include "util/timer.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+
+ProgressiveVolumeLoader::~ProgressiveVolumeLoader()
+{
+    cancel();
+    wait();
+}
+
+int ProgressiveVolumeLoader::start(const std::string& header_filename, uint32_t chunk_slices)
+{
+    cancel();
+    wait();
+    loaded.store(0);
+    error.store(false);
+    cancelled.store(false);
+    if (read_nrrd_header("data/volume/" + header_filename, header) != 0) return 1;
+    if (header.timesteps > 1)
+    {
+        std::cerr << header_filename << " holds " << header.timesteps << " timesteps, open it as a series." << std::endl;
+        return 1;
+    }
+    volume = Volume();
+    volume.name = header_filename.substr(0, header_filename.find_last_of('.'));
+    volume.resolution = header.resolution;
+    // zero until loaded, the renderer shows empty space there
+    volume.data.resize(size_t(header.resolution.x) * header.resolution.y * header.resolution.z);
+    thread = std::thread(&ProgressiveVolumeLoader::read_chunks, this, std::max(chunk_slices, 1u));
+    return 0;
+}
+
+void ProgressiveVolumeLoader::wait()
+{
+    if (thread.joinable()) thread.join();
+}
+
+void ProgressiveVolumeLoader::read_chunks(uint32_t chunk_slices)
+{
+    Timer<float> timer;
+    const uint32_t Z = volume.resolution.z;
+    const size_t slice = size_t(volume.resolution.x) * volume.resolution.y;
+    if (header.encoding == VolumeEncoding::Gzip)
+    {
+        if (inflate_file(header.data_file, volume.data.data(), volume.data.size()) != 0)
+        {
+            error.store(true, std::memory_order_release);
+            return;
+        }
+        loaded.store(Z, std::memory_order_release);
+    }
+    else
+    {
+        const int fd = open(header.data_file.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            std::cerr << "Failed to open raw data file: " << header.data_file << std::endl;
+            error.store(true, std::memory_order_release);
+            return;
+        }
+        for (uint32_t z = 0; z < Z && !cancelled.load(std::memory_order_acquire); z += chunk_slices)
+        {
+            const size_t begin = size_t(z) * slice;
+            const size_t size = size_t(std::min(chunk_slices, Z - z)) * slice;
+            size_t done = 0;
+            while (done < size)
+            {
+                const ssize_t n = pread(fd, volume.data.data() + begin + done, size - done, off_t(begin + done));
+                if (n <= 0) break;
+                done += size_t(n);
+            }
+            if (done != size)
+            {
+                std::cerr << "Failed to read slices " << z << " - " << z + size / slice << " of " << header.data_file << std::endl;
+                error.store(true, std::memory_order_release);
+                break;
+            }
+            // publishes the chunk to the readers of loaded_slices()
+            loaded.store(z + uint32_t(size / slice), std::memory_order_release);
+        }
+        close(fd);
+    }
+    if (!failed() && done()) std::cout << CLR_GREEN << "[TIMING] progressive load " << volume.name << ": " << timer.elapsed<std::milli>() << " ms" << CLR_RESET << std::endl;
+}
@@ -0,0 +1,220 @@
+#include "volume_series.hpp"
+#include "volume_compression.hpp"
+#include "volume_stats.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+
+int VolumeSeries::open(const std::vector<std::string>& header_filenames, uint32_t ring_size, uint32_t io_threads, GradientOperator op)
+{
+    close();
+    gradient_operator = op;
+    if (header_filenames.empty())
+    {
+        std::cerr << "A series needs at least one header." << std::endl;
+        return 1;
+    }
+    const std::string volume_folder = "data/volume/";
+    for (const std::string& filename : header_filenames)
+    {
+        NrrdHeader header;
+        if (read_nrrd_header(volume_folder + filename, header) != 0) return 1;
+        if (sources.empty()) resolution = header.resolution;
+        if (header.resolution != resolution)
+        {
+            std::cerr << "Timestep " << filename << " does not match the resolution of the first timestep." << std::endl;
+            sources.clear();
+            return 1;
+        }
+        if (header.timesteps > 1 && (header.encoding != VolumeEncoding::Raw || header_filenames.size() > 1))
+        {
+            // the gzip blocks do not line up with the timesteps, every step would inflate the whole file
+            std::cerr << "A 4D header must be raw encoded and the only header of the series: " << filename << std::endl;
+            sources.clear();
+            return 1;
+        }
+        const size_t step_size = size_t(resolution.x) * resolution.y * resolution.z;
+        for (uint32_t t = 0; t < header.timesteps; ++t) sources.push_back({header.data_file, header.encoding, size_t(t) * step_size});
+    }
+    name = header_filenames.front().substr(0, header_filenames.front().find_last_of('.'));
+
+    slots.assign(std::clamp(ring_size, 1u, size()), Slot{});
+    failed_steps.assign(size(), false);
+    stopping = false;
+    for (uint32_t i = 0; i < std::max(io_threads, 1u); ++i) workers.emplace_back(&VolumeSeries::decode_loop, this);
+    std::cout << "Opened series " << name << ": " << size() << " timesteps of " << resolution.x << "x" << resolution.y << "x" << resolution.z
+              << ", ring of " << slots.size() << std::endl;
+    return 0;
+}
+
+void VolumeSeries::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        queue.clear();
+    }
+    work_available.notify_all();
+    step_ready.notify_all();
+    for (std::thread& worker : workers) worker.join();
+    workers.clear();
+    slots.clear();
+    in_flight.clear();
+    failed_steps.clear();
+    sources.clear();
+}
+
+std::shared_ptr<const SeriesStep> VolumeSeries::try_get(uint32_t t)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (t >= size()) return nullptr;
+    request(t);
+    Slot* slot = find_slot(t);
+    return slot ? slot->data : nullptr;
+}
+
+std::shared_ptr<const SeriesStep> VolumeSeries::get(uint32_t t)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (t >= size() || failed_steps[t]) return nullptr;
+    request(t);
+    std::shared_ptr<const SeriesStep> step;
+    step_ready.wait(lock, [&]
+    {
+        Slot* slot = find_slot(t);
+        if (slot) step = slot->data;
+        // a failed decode frees the slot, there is nothing left to wait for
+        return stopping || step || !slot;
+    });
+    return step;
+}
+
+uint32_t VolumeSeries::ready_count()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return uint32_t(std::count_if(slots.begin(), slots.end(), [](const Slot& slot) { return slot.data != nullptr; }));
+}
+
+bool VolumeSeries::failed(uint32_t t)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return t < failed_steps.size() && failed_steps[t];
+}
+
+VolumeSeries::Slot* VolumeSeries::find_slot(uint32_t t)
+{
+    for (Slot& slot : slots)
+    {
+        if (slot.step == int64_t(t)) return &slot;
+    }
+    return nullptr;
+}
+
+void VolumeSeries::request(uint32_t t)
+{
+    // failed steps take no slot, the ring holds the next steps that can still be decoded
+    std::vector<uint32_t> wanted;
+    wanted.reserve(slots.size());
+    for (uint32_t k = 0; k < size() && wanted.size() < slots.size(); ++k)
+    {
+        const uint32_t s = (t + k) % size();
+        if (!failed_steps[s]) wanted.push_back(s);
+    }
+
+    // evict the steps behind the playback position, their users keep the data alive
+    for (Slot& slot : slots)
+    {
+        if (slot.step >= 0 && std::find(wanted.begin(), wanted.end(), uint32_t(slot.step)) == wanted.end()) slot = Slot{};
+    }
+    queue.clear();
+    for (uint32_t s : wanted)
+    {
+        Slot* slot = find_slot(s);
+        if (!slot)
+        {
+            slot = &*std::find_if(slots.begin(), slots.end(), [](const Slot& free) { return free.step < 0; });
+            slot->step = s;
+        }
+        if (!slot->data && std::find(in_flight.begin(), in_flight.end(), s) == in_flight.end()) queue.push_back(s);
+    }
+    if (!queue.empty()) work_available.notify_all();
+}
+
+void VolumeSeries::decode_loop()
+{
+    while (true)
+    {
+        uint32_t t;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            work_available.wait(lock, [&] { return stopping || !queue.empty(); });
+            if (stopping) return;
+            t = queue.front();
+            queue.pop_front();
+            in_flight.push_back(t);
+        }
+
+        auto step = std::make_shared<SeriesStep>();
+        const bool ok = decode(t, *step) == 0;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            in_flight.erase(std::find(in_flight.begin(), in_flight.end(), t));
+            // the step may have been evicted while it decoded
+            if (Slot* slot = find_slot(t))
+            {
+                if (ok) slot->data = std::move(step);
+                else *slot = Slot{};
+            }
+            if (!ok)
+            {
+                failed_steps[t] = true;
+                std::cerr << "Timestep " << t << " of " << name << " failed to decode, playback skips it." << std::endl;
+            }
+        }
+        step_ready.notify_all();
+    }
+}
+
+int VolumeSeries::decode(uint32_t t, SeriesStep& step) const
+{
+    const Source& source = sources[t];
+    const size_t step_size = size_t(resolution.x) * resolution.y * resolution.z;
+    step.index = t;
+    step.volume.name = name + "_t" + std::to_string(t);
+    step.volume.resolution = resolution;
+    step.volume.data.resize(step_size);
+    if (source.encoding == VolumeEncoding::Gzip)
+    {
+        if (inflate_file(source.data_file, step.volume.data.data(), step_size) != 0) return 1;
+    }
+    else
+    {
+        // positioned reads, the decode threads share nothing but the page cache
+        const int fd = ::open(source.data_file.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            std::cerr << "Failed to open raw data file: " << source.data_file << std::endl;
+            return 1;
+        }
+        size_t done = 0;
+        while (done < step_size)
+        {
+            const ssize_t n = pread(fd, step.volume.data.data() + done, step_size - done, off_t(source.offset + done));
+            if (n <= 0) break;
+            done += size_t(n);
+        }
+        ::close(fd);
+        if (done != step_size)
+        {
+            std::cerr << "Failed to read timestep " << t << " from " << source.data_file << std::endl;
+            return 1;
+        }
+    }
+    step.gradient = compute_gradient_volume(step.volume, gradient_operator);
+    volume_stats(step.volume);
+    volume_stats(step.gradient);
+    return 0;
+}
@@ -0,0 +1,67 @@
+#include "volume_stats.hpp"
+
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+VolumeStats compute_volume_stats(const uint8_t* data, size_t size, size_t padding)
+{
+    VolumeStats stats;
+    if (size == 0) return stats;
+
+    // four interleaved sub-histograms per thread, so runs of equal voxels don't serialize on one counter
+    const int64_t quads = int64_t(size / 4);
+    #pragma omp parallel
+    {
+        std::array<uint64_t, 4 * 256> local{};
+        #pragma omp for schedule(static) nowait
+        for (int64_t i = 0; i < quads; ++i)
+        {
+            const uint8_t* p = data + 4 * size_t(i);
+            local[p[0]]++;
+            local[256 + p[1]]++;
+            local[512 + p[2]]++;
+            local[768 + p[3]]++;
+        }
+        #pragma omp critical(volume_stats_merge)
+        {
+            for (size_t v = 0; v < 256; ++v)
+            {
+                stats.histogram[v] += local[v] + local[256 + v] + local[512 + v] + local[768 + v];
+            }
+        }
+    }
+    for (size_t i = 4 * size_t(quads); i < size; ++i) stats.histogram[data[i]]++;
+    stats.histogram[0] -= std::min(padding, stats.histogram[0]);
+    size -= padding;
+    if (size == 0) return VolumeStats{};
+
+    // exact integer sums, 255^2 * size fits into 64 bit for any volume that fits into memory
+    uint64_t sum = 0, sum_sq = 0;
+    for (uint64_t v = 0; v < 256; ++v)
+    {
+        sum += v * stats.histogram[v];
+        sum_sq += v * v * stats.histogram[v];
+    }
+    const auto first = std::find_if(stats.histogram.begin(), stats.histogram.end(), [](uint64_t n){ return n != 0; });
+    const auto last = std::find_if(stats.histogram.rbegin(), stats.histogram.rend(), [](uint64_t n){ return n != 0; });
+    stats.min = uint8_t(first - stats.histogram.begin());
+    stats.max = uint8_t(255 - (last - stats.histogram.rbegin()));
+    stats.mean = double(sum) / double(size);
+    stats.variance = std::max(0.0, double(sum_sq) / double(size) - stats.mean * stats.mean);
+    stats.nonzero = size - stats.histogram[0];
+    return stats;
+}
+
+const VolumeStats& volume_stats(const Volume& volume)
+{
+    if (!volume.stats)
+    {
+        const size_t voxels = size_t(volume.resolution.x) * volume.resolution.y * volume.resolution.z;
+        const size_t padding = volume.data.size() > voxels ? volume.data.size() - voxels : 0;
+        volume.stats = std::make_shared<const VolumeStats>(compute_volume_stats(volume.data.data(), volume.data.size(), padding));
+    }
+    return *volume.stats;
+}
@@ -2,16 +2,19 @@
 #include <vulkan/vulkan_enums.hpp>
 #include "stb/stb_image.h"
 #include "transfer_function.hpp"
+#include "diagram_distance.hpp"
+#include "volume_stats.hpp"
 #include <fstream>
 #include <iostream>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include "stb/stb_image_write.h"
 #include <iomanip>
+#include <filesystem>
 
 namespace ve
 {
-WorkContext::WorkContext(const VulkanMainContext& vmc, VulkanCommandContext& vcc, std::vector<PersistencePair> raw_pairs, std::vector<int> raw_filt, std::vector<PersistencePair> raw_grad_pairs, std::vector<int> raw_grad_filt) : vmc(vmc), vcc(vcc), raw_persistence_pairs(std::move(raw_pairs)), scalar_filtration(std::move(raw_filt)), raw_gradient_pairs(std::move(raw_grad_pairs)), gradient_filtration(std::move(raw_grad_filt)), storage(vmc, vcc), swapchain(vmc, vcc, storage), renderer(vmc, storage), ray_marcher(vmc, storage), persistence_texture_resource(vmc, storage), ui(vmc) {}
+WorkContext::WorkContext(const VulkanMainContext& vmc, VulkanCommandContext& vcc, std::shared_ptr<const PairStore> scalar_pairs, std::shared_ptr<const PairStore> gradient_pairs) : vmc(vmc), vcc(vcc), scalar_store(std::move(scalar_pairs)), gradient_store(std::move(gradient_pairs)), storage(vmc, vcc), swapchain(vmc, vcc, storage), renderer(vmc, storage), ray_marcher(vmc, storage), persistence_texture_resource(vmc, storage), ui(vmc) {}
 
 void WorkContext::fillTF2DFromVolume(const Volume& vol)
 {
@@ -42,26 +45,42 @@ void WorkContext::fillTF2DFromVolume(const Volume& vol)
   }
 }
 
-void WorkContext::construct(AppState& app_state, const Volume& volume)
+std::vector<std::vector<int>> WorkContext::collect_grads_by_scalar(const Volume& volume, const Volume& gradient)
 {
-  vcc.add_graphics_buffers(frames_in_flight);
-  vcc.add_compute_buffers(2);
-  vcc.add_transfer_buffers(1);
-  renderer.setup_storage(app_state);
-  gradient_volume = compute_gradient_volume(volume);
-  grads_by_scalar.clear();
-  grads_by_scalar.resize(AppState::TF2D_BINS);
+  std::vector<std::vector<int>> grads_by_scalar(AppState::TF2D_BINS);
   for (size_t vid = 0; vid < volume.data.size(); ++vid)
   {
     int s = int(volume.data[vid]);
-    int g = int(gradient_volume.data[vid]);
+    int g = int(gradient.data[vid]);
     if (s >= 0 && s < AppState::TF2D_BINS && g >= 0 && g < AppState::TF2D_BINS)
     {
       grads_by_scalar[s].push_back(g);
     }
   }
-  ray_marcher.setup_storage(app_state, volume, gradient_volume);
-  app_state.max_gradient = *std::max_element(gradient_volume.data.cbegin(), gradient_volume.data.cend());
+  return grads_by_scalar;
+}
+
+void WorkContext::construct(AppState& app_state, const Volume& volume, bool volume_complete)
+{
+  vcc.add_graphics_buffers(frames_in_flight);
+  vcc.add_compute_buffers(2);
+  vcc.add_transfer_buffers(1);
+  renderer.setup_storage(app_state);
+  if (volume_complete)
+  {
+    gradient_volume = compute_gradient_volume(volume, app_state.gradient_operator);
+    grads_by_scalar = collect_grads_by_scalar(volume, gradient_volume);
+  }
+  else
+  {
+    // nothing is read from a volume that is still loading, complete_volume fills in the rest
+    gradient_volume = Volume();
+    gradient_volume.resolution = volume.resolution;
+    gradient_volume.data.resize(volume.data.size());
+  }
+  // a loading volume starts out as empty space on the GPU, the zero gradient has its size
+  ray_marcher.setup_storage(app_state, volume_complete ? volume : gradient_volume, gradient_volume);
+  app_state.max_gradient = volume_stats(gradient_volume).max;
   swapchain.construct(false);
   app_state.set_window_extent(swapchain.get_extent());
   for (uint32_t i = 0; i < frames_in_flight; ++i)
@@ -80,51 +99,25 @@ void WorkContext::construct(AppState& app_state, const Volume& volume)
   std::cout << "[TIMING] set_transfer_fucntion_UI: " << t11 << " ms\n";
 
   scalar_volume = &volume;
-  ui.set_volume(scalar_volume);
+  ui.set_volume(volume_complete ? scalar_volume : nullptr);
   auto t10 = timer.restart<ms>();
     std::cout << "[TIMING] set_volume_UI: " << t10 << " ms\n";
 
-  // compute and set scalar persistence pairs
-  std::vector<int> filt_vals;
-  //persistence_pairs = calculate_persistence_pairs(volume, filt_vals, app_state.filtration_mode);
-  persistence_pairs.clear();
-  for (auto &p : raw_persistence_pairs)
-  {
-    uint32_t b = scalar_filtration[p.birth];
-    uint32_t d = scalar_filtration[p.death];
-    persistence_pairs.emplace_back(b, d);
-  }
+  // the display diagrams are aggregated once in the pair stores
+  if (volume_complete) set_persistence_diagram(scalar_store, volume);
+  ui.set_persistence_diagram(&scalar_diagram());
   auto t1 = timer.restart<ms>();
-  std::cout << "[TIMING] calculate_persistence_pairs_scalar: " << t1 << " ms\n";
+  std::cout << "[TIMING] set scalar persistence diagram: " << t1 << " ms (" << scalar_diagram().total_pairs() << " pairs, " << scalar_diagram().size() << " unique points)\n";
 
-  ui.set_persistence_pairs(&persistence_pairs);
-  auto t2 = timer.restart<ms>();
-    std::cout << "[TIMING] set_scalar_persistence_pairs_UI: " << t2 << " ms\n";
-
-  set_persistence_pairs(persistence_pairs, volume);
-  auto t3 = timer.restart<ms>();
-  std::cout << "[TIMING] set_persistence_pairs: " << t3 << " ms\n";
-
-  // compute and set gradient persistence pairs
-  
-  std::vector<int> grad_filt_vals;
-  //auto raw_grad_pairs = calculate_persistence_pairs(gradient_volume, grad_filt_vals, app_state.filtration_mode);
-  auto t4 = timer.restart<ms>();
-  std::cout << "[TIMING] calculate_persistence_pairs_gradient: " << t4 << " ms\n";
-
-  gradient_persistence_pairs.clear();
-  for (auto &p : raw_gradient_pairs)
-  {
-    uint32_t b = gradient_filtration[p.birth];
-    uint32_t d = gradient_filtration[p.death];
-    gradient_persistence_pairs.emplace_back(b, d);
-  }
-  ui.set_gradient_persistence_pairs(&gradient_persistence_pairs);
+  set_gradient_persistence_diagram(gradient_store);
   auto t5 = timer.restart<ms>();
-  std::cout << "[TIMING] set_gradient_persistence_pairs_UI: " << t5 << " ms\n";
+  std::cout << "[TIMING] set gradient persistence diagram: " << t5 << " ms (" << gradient_diagram().total_pairs() << " pairs, " << gradient_diagram().size() << " unique points)\n";
 
-  merge_tree = build_merge_tree_with_tolerance(persistence_pairs, 5u);
+  filtration_mode = app_state.filtration_mode;
+  if (volume_complete) rebuild_merge_tree(0);
   ui.set_merge_tree(&merge_tree);
+  ui.set_branch_decomposition(&branch_decomposition);
+  ui.set_branch_segmentation(&branch_segmentation);
 
   ui.set_gradient_volume(&gradient_volume);
 
@@ -144,36 +137,44 @@ void WorkContext::construct(AppState& app_state, const Volume& volume)
     if (mode == 0)
     {
       // scalar mode
-      ui.set_persistence_pairs(&persistence_pairs);
-      ui.set_gradient_persistence_pairs(nullptr);
+      ui.set_persistence_diagram(&scalar_diagram());
+      ui.set_gradient_persistence_diagram(nullptr);
 
-      if (scalar_volume && !persistence_pairs.empty())
+      global_max_persistence = std::max(1u, scalar_diagram().max_persistence());
+      if (scalar_volume && !scalar_diagram().empty())
       {
-        set_persistence_pairs(persistence_pairs, *scalar_volume);
+        transfer_function.update(scalar_diagram(), *scalar_volume, tf_data);
       }
     }
     else
     {
       // gradient mode
-      ui.set_persistence_pairs(nullptr);
-      ui.set_gradient_persistence_pairs(&gradient_persistence_pairs);
+      ui.set_persistence_diagram(nullptr);
+      ui.set_gradient_persistence_diagram(&gradient_diagram());
 
-      global_max_persistence = 1;
-      for (auto &p : gradient_persistence_pairs)
-      {
-        uint32_t pers = (p.death > p.birth ? (p.death - p.birth) : 0);
-        global_max_persistence = std::max(global_max_persistence, pers);
-      }
-       if (&gradient_volume && !gradient_persistence_pairs.empty())
+      global_max_persistence = std::max(1u, gradient_diagram().max_persistence());
+      if (!gradient_diagram().empty())
       {
-        transfer_function.update(gradient_persistence_pairs, gradient_volume, tf_data);
+        transfer_function.update(gradient_diagram(), gradient_volume, tf_data);
       }
     }
-    merge_tree = build_merge_tree_with_tolerance((mode == 0 ? persistence_pairs : gradient_persistence_pairs), 5u);
-    ui.mark_merge_tree_dirty();
+    rebuild_merge_tree(mode);
     ui.clear_selection();
   });
 
+  ui.set_on_merge_tree_source_changed([this](int source, uint32_t tolerance)
+  {
+    merge_tree_source = source;
+    merge_tree_tolerance = tolerance;
+    rebuild_merge_tree(ui.get_pd_mode());
+  });
+
+  ui.set_on_tf_source_changed([this](int source)
+  {
+    tf_source = source;
+    update_transfer_function(ui.get_pd_mode());
+  });
+
   ui.set_on_highlight_selected([this](const std::vector<std::pair<PersistencePair,float>>& hits, int ramp_index)
   {
     this->volume_highlight_persistence_pairs(hits, ramp_index);
@@ -280,7 +281,7 @@ void WorkContext::construct(AppState& app_state, const Volume& volume)
     ImU32 green = IM_COL32(0,255,0,200);
 
     bool gradMode = (ui.get_pd_mode() == 1);
-    const auto &pairs = gradMode ? gradient_persistence_pairs : persistence_pairs;
+    const auto &pairs = gradMode ? gradient_diagram().points() : scalar_diagram().points();
 
     auto p = pairs[featIdx];
     int b = std::clamp<int>(p.birth, 0, AppState::TF2D_BINS-1);
@@ -376,7 +377,7 @@ void WorkContext::construct(AppState& app_state, const Volume& volume)
     click_colors = ui.persistence_bin_colors;
     last_tf2d_bins = ui.persistence_bins;
 
-    PersistencePair per = (gradMode ? gradient_persistence_pairs[featIdx] : persistence_pairs[featIdx]);
+    PersistencePair per = (gradMode ? gradient_diagram().points()[featIdx] : scalar_diagram().points()[featIdx]);
     std::vector<std::pair<PersistencePair,float>> single{{per, 1.0f}};
     this->volume_highlight_persistence_pairs(single, ui.get_selected_ramp());
   });
@@ -399,7 +400,7 @@ void WorkContext::construct(AppState& app_state, const Volume& volume)
     {
       int idx = featIdxs[fi];
       // record this pair for the 3D volume
-      const auto& pairs = gradMode ? gradient_persistence_pairs : persistence_pairs;
+      const auto& pairs = gradMode ? gradient_diagram().points() : scalar_diagram().points();
       PersistencePair p = pairs[idx];
       forVolume.emplace_back(p, 1.0f);
       
@@ -522,6 +523,18 @@ void WorkContext::construct(AppState& app_state, const Volume& volume)
     ui.last_metrics_valid = true;
   });
 
+  ui.set_on_diagram_distance([this](float q)
+  {
+    Timer<float> local_timer;
+    const double bottleneck = bottleneck_distance(scalar_diagram(), gradient_diagram());
+    const double wasserstein = wasserstein_distance(scalar_diagram(), gradient_diagram(), q);
+    ui.last_distance_ms    = local_timer.elapsed<std::milli>();
+    ui.last_bottleneck     = float(bottleneck);
+    ui.last_wasserstein    = float(wasserstein);
+    ui.last_distance_valid = wasserstein >= 0.0;
+    std::cout << CLR_GREEN << "[TIMING] diagram distances: " << ui.last_distance_ms << " ms" << CLR_RESET << std::endl;
+  });
+
   ui.set_on_range_applied([this](const std::vector<PersistencePair>& sel)
   {
     if (sel.empty()) return;
@@ -546,19 +559,26 @@ void WorkContext::construct(AppState& app_state, const Volume& volume)
     this->volume_highlight_persistence_pairs(hits, ramp);
   });
 
-  export_persistence_pairs_to_csv(persistence_pairs, gradient_persistence_pairs, "scalar_pairs.csv", "gradient_pairs.csv");
-    // scalar volume
-    std::ofstream outS("volume_data/scalar_volume.bin", std::ios::binary);
-    outS.write(reinterpret_cast<const char*>(scalar_volume->data.data()), scalar_volume->data.size() * sizeof(scalar_volume->data[0]));
-
-    // gradient volume
-    std::ofstream outG("volume_data/gradient_volume.bin", std::ios::binary);
-    outG.write(reinterpret_cast<const char*>(gradient_volume.data.data()), gradient_volume.data.size() * sizeof(gradient_volume.data[0]));
+  // a loading volume is still being written by the loader, complete_volume exports it once it is whole
+  if (volume_complete) export_volume_data();
 
   // load static persistence diagram texture (for reference)
   load_persistence_diagram_texture("output_plots/persistence_diagram.png");
 }
 
+// the pairs as csv and the raw scalar and gradient voxels for the python scripts
+void WorkContext::export_volume_data() const
+{
+  export_persistence_pairs_to_csv(scalar_diagram(), gradient_diagram(), "scalar_pairs.csv", "gradient_pairs.csv");
+  // scalar volume
+  std::ofstream outS("volume_data/scalar_volume.bin", std::ios::binary);
+  outS.write(reinterpret_cast<const char*>(scalar_volume->data.data()), scalar_volume->data.size() * sizeof(scalar_volume->data[0]));
+
+  // gradient volume
+  std::ofstream outG("volume_data/gradient_volume.bin", std::ios::binary);
+  outG.write(reinterpret_cast<const char*>(gradient_volume.data.data()), gradient_volume.data.size() * sizeof(gradient_volume.data[0]));
+}
+
 void WorkContext::destruct()
 {
   vmc.logical_device.get().waitIdle();
@@ -589,6 +609,30 @@ void WorkContext::draw_frame(AppState &app_state)
     for (int i = 0; i < DeviceTimer::TIMER_COUNT; i++) app_state.device_timings[i] = device_timers[0].get_result_by_idx(i);
   }
 
+  if (app_state.apply_target_level || app_state.apply_persistence_threshold)
+  {
+    highlight_merge_tree_level(app_state.target_level, uint32_t(std::max(app_state.persistence_threshold, 0)));
+    app_state.apply_target_level = false;
+    app_state.apply_persistence_threshold = false;
+  }
+
+  if (segmentation_changed)
+  {
+    app_state.segmented_branch = -1;
+    segmentation_changed = false;
+  }
+  if (app_state.apply_segmented_branch)
+  {
+    if (!update_segment_mask(app_state.segmented_branch)) app_state.segmented_branch = -1;
+    app_state.apply_segmented_branch = false;
+  }
+  if (volume_series) advance_series(app_state);
+  if (volume_loader)
+  {
+    app_state.loaded_slices = volume_loader->loaded_slices();
+    app_state.load_progress = volume_loader->progress();
+  }
+
   vk::ResultValue<uint32_t> image_idx = vmc.logical_device.get().acquireNextImageKHR(swapchain.get(), uint64_t(-1), syncs[0].get_semaphore(Synchronization::S_IMAGE_AVAILABLE));
   VE_CHECK(image_idx.result, "Failed to acquire next image!");
 
@@ -621,7 +665,7 @@ void WorkContext::render(uint32_t image_idx, AppState& app_state, uint32_t read_
   if (pending_reproject_idx >= 0)
   {
   // rebuild tf_data right now for that one feature
-  PersistencePair p = (ui.get_pd_mode()==1 ? gradient_persistence_pairs[pending_reproject_idx] : persistence_pairs[pending_reproject_idx]);
+  PersistencePair p = (ui.get_pd_mode()==1 ? gradient_diagram().points()[pending_reproject_idx] : scalar_diagram().points()[pending_reproject_idx]);
   std::vector<std::pair<PersistencePair,float>> single{{p,1.0f}};
   volume_highlight_persistence_pairs(single, ui.get_selected_ramp());
   pending_reproject_idx = -1;
@@ -629,6 +673,19 @@ void WorkContext::render(uint32_t image_idx, AppState& app_state, uint32_t read_
   
   auto &buf = storage.get_buffer_by_name("transfer_function");
   buf.update_data(tf_data);
+  if (segment_mask_dirty)
+  {
+    storage.get_buffer_by_name("segment_mask").update_data(segment_mask);
+    segment_mask_dirty = false;
+  }
+  if (volume_loader) upload_slices(app_state.loaded_slices);
+  if (series_upload)
+  {
+    // the decode threads keep working on the following steps meanwhile
+    storage.get_buffer_by_name("volume").update_data_bytes(series_current->volume.data.data(), series_current->volume.data.size());
+    storage.get_buffer_by_name("gradient_volume").update_data_bytes(series_current->gradient.data.data(), series_current->gradient.data.size());
+    series_upload = false;
+  }
   vmc.logical_device.get().waitIdle();
 
   vk::CommandBuffer &cb = vcc.get_one_time_transfer_buffer();
@@ -689,25 +746,20 @@ void WorkContext::render(uint32_t image_idx, AppState& app_state, uint32_t read_
   VE_CHECK(vmc.get_present_queue().presentKHR(present_info), "Failed to present image!");
 }
 
-void WorkContext::set_persistence_pairs(std::vector<PersistencePair> pairs, const Volume& volume)
+void WorkContext::set_persistence_diagram(std::shared_ptr<const PairStore> pairs, const Volume& volume)
 {
-  persistence_pairs = std::move(pairs);
+  scalar_store = std::move(pairs);
 
   // compute the global max persistence, later used in isolate/volumeHighlight
-  global_max_persistence = 1;
-  for (auto &p : persistence_pairs)
-  {
-    uint32_t pers = (p.death > p.birth ? p.death - p.birth : 0);
-    global_max_persistence = std::max(global_max_persistence, pers);
-  }
+  global_max_persistence = std::max(1u, scalar_diagram().max_persistence());
 
-  transfer_function.update(persistence_pairs, volume, tf_data);
+  transfer_function.update(scalar_diagram(), volume, tf_data);
 }
 
-void WorkContext::set_gradient_persistence_pairs(const std::vector<PersistencePair>& pairs)
+void WorkContext::set_gradient_persistence_diagram(std::shared_ptr<const PairStore> pairs)
 {
-  gradient_persistence_pairs = pairs;
-  ui.set_gradient_persistence_pairs(&gradient_persistence_pairs);
+  gradient_store = std::move(pairs);
+  ui.set_gradient_persistence_diagram(&gradient_diagram());
 }
 
 void WorkContext::load_persistence_diagram_texture(const std::string &filePath)
@@ -1020,7 +1072,7 @@ void WorkContext::highlight_onlyB(const PersistencePair&, const PersistencePair&
           tf_data[g * AppState::TF2D_BINS + s] = col;
 }
 
-void WorkContext::export_persistence_pairs_to_csv(const std::vector<PersistencePair>& scalar_pairs, const std::vector<PersistencePair>& gradient_pairs, const std::string& scalar_filename, const std::string& gradient_filename) const
+void WorkContext::export_persistence_pairs_to_csv(const PersistenceDiagram& scalar_pairs, const PersistenceDiagram& gradient_pairs, const std::string& scalar_filename, const std::string& gradient_filename) const
 {
     // ensure output directory exists
     if (mkdir("volume_data", 0755) != 0 && errno != EEXIST)
@@ -1045,9 +1097,9 @@ void WorkContext::export_persistence_pairs_to_csv(const std::vector<PersistenceP
         }
 
        auto t0 = local_timer.restart<ms>();
-       out_scalar << "birth,death\n";
-       for (const auto& p : scalar_pairs)
-        out_scalar << p.birth << "," << p.death << "\n"; 
+       out_scalar << "birth,death,multiplicity\n";
+       for (size_t i = 0; i < scalar_pairs.size(); ++i)
+        out_scalar << scalar_pairs[i].birth << "," << scalar_pairs[i].death << "," << scalar_pairs.multiplicity()[i] << "\n";
         auto t1 = local_timer.restart<ms>();
         std::cout << CLR_GREEN << "[TIMING] Scalar export: " << t1 << " ms" << std::endl << CLR_RESET;
     }
@@ -1062,10 +1114,10 @@ void WorkContext::export_persistence_pairs_to_csv(const std::vector<PersistenceP
         }
 
         auto t2 = local_timer.restart<ms>();
-        out_grad << "birth,death";
-        for (const auto& p : gradient_pairs)
+        out_grad << "birth,death,multiplicity\n";
+        for (size_t i = 0; i < gradient_pairs.size(); ++i)
         {
-            out_grad << p.birth << "," << p.death << "";
+            out_grad << gradient_pairs[i].birth << "," << gradient_pairs[i].death << "," << gradient_pairs.multiplicity()[i] << "\n";
         }
         auto t3 = local_timer.restart<ms>();
         std::cout << CLR_GREEN << "[TIMING] Gradient export: " << t3 << " ms" << std::endl << CLR_RESET;
@@ -1113,13 +1165,256 @@ void WorkContext::reset_custom_colors()
   int ramp = ui.get_selected_ramp();
 
   std::vector<std::pair<PersistencePair, float>> all_hits;
-  all_hits.reserve(persistence_pairs.size());
-  for (const auto &p : persistence_pairs)
+  all_hits.reserve(scalar_diagram().points().size());
+  for (const auto &p : scalar_diagram().points())
       all_hits.emplace_back(p, 1.0f);
 
   volume_highlight_persistence_pairs(all_hits, ramp);
 }
 
+MergeTreeSettings WorkContext::merge_tree_settings(int mode) const
+{
+  return {merge_tree_source, merge_tree_tolerance, filtration_mode, volume_cache_prefix(*scalar_volume) + (mode == 0 ? "" : "_grad")};
+}
+
+MergeTreeBuild WorkContext::build_merge_tree(const Volume& volume, const std::vector<PersistencePair>& pairs, const MergeTreeSettings& settings)
+{
+  MergeTreeBuild build;
+  Timer<float> sweep_timer;
+  const std::string mode_name = settings.filtration_mode == FiltrationMode::LowerStar ? "lower" : "upper";
+  if (settings.source == 0)
+  {
+    // the tree and its arc labels are cached together per volume and filtration mode, keyed by the voxels
+    const MergeTreeType type = merge_tree_type(settings.filtration_mode);
+    const uint64_t key = augmented_merge_tree_key(volume, type);
+    const std::string cache_path = settings.cache_prefix + "_sweep_" + mode_name;
+    const std::string tree_path = cache_path + "_tree.bin", arcs_path = cache_path + "_arcs.bin";
+    if (std::filesystem::exists(tree_path) && std::filesystem::exists(arcs_path) && build.tree.load(tree_path, key) == 0
+        && load_augmented_merge_tree(arcs_path, build.augmented, key) == 0 && build.tree.size() == build.augmented.size())
+    {
+      std::cout << CLR_GREEN << "[TIMING] merge tree sweep from cache: " << sweep_timer.elapsed<ms>() << " ms (" << build.augmented.size() << " nodes)" << CLR_RESET << std::endl;
+    }
+    else
+    {
+      build.augmented = compute_merge_tree(volume, type);
+      build.tree = to_merge_tree(build.augmented);
+      std::cout << CLR_GREEN << "[TIMING] merge tree sweep: " << sweep_timer.elapsed<ms>() << " ms (" << build.augmented.size() << " nodes)" << CLR_RESET << std::endl;
+      std::filesystem::create_directories(std::filesystem::path(cache_path).parent_path());
+      if (build.tree.save(tree_path, key) != 0 || save_augmented_merge_tree(build.augmented, arcs_path, key) != 0)
+        std::cerr << "Failed to cache the merge tree sweep." << std::endl;
+    }
+  }
+  else
+  {
+    // cached per volume, diagram, filtration mode and tolerance; the key catches pairs that changed since
+    const uint64_t key = merge_tree_key(pairs, settings.tolerance);
+    const std::string cache_path = settings.cache_prefix + "_tree_" + mode_name + "_tol" + std::to_string(settings.tolerance) + ".bin";
+    if (std::filesystem::exists(cache_path) && build.tree.load(cache_path, key) == 0)
+    {
+      std::cout << CLR_GREEN << "[TIMING] merge tree from cache: " << sweep_timer.elapsed<ms>() << " ms" << CLR_RESET << std::endl;
+    }
+    else
+    {
+      build.tree = build_merge_tree_with_tolerance(pairs, settings.tolerance);
+      std::cout << CLR_GREEN << "[TIMING] merge tree from pairs: " << sweep_timer.elapsed<ms>() << " ms" << CLR_RESET << std::endl;
+      std::filesystem::create_directories(std::filesystem::path(cache_path).parent_path());
+      if (build.tree.save(cache_path, key) != 0) std::cerr << "Failed to cache the merge tree." << std::endl;
+    }
+  }
+  sweep_timer.restart<ms>();
+  build.decomposition = BranchDecomposition(build.tree);
+  std::cout << CLR_GREEN << "[TIMING] branch decomposition: " << sweep_timer.elapsed<ms>() << " ms (" << build.decomposition.get_branches().size() << " branches)" << CLR_RESET << std::endl;
+  if (settings.source == 0)
+  {
+    sweep_timer.restart<ms>();
+    build.segmentation = segment_branches(volume, build.augmented, build.decomposition);
+    std::cout << CLR_GREEN << "[TIMING] branch segmentation: " << sweep_timer.elapsed<ms>() << " ms" << CLR_RESET << std::endl;
+  }
+  return build;
+}
+
+// mode 0 = scalar volume, 1 = gradient volume
+void WorkContext::rebuild_merge_tree(int mode)
+{
+  // the sweep would read a volume that is still loading
+  if (volume_loader) return;
+  const Volume& volume = mode == 0 ? *scalar_volume : gradient_volume;
+  const std::vector<PersistencePair>& pairs = mode == 0 ? scalar_diagram().points() : gradient_diagram().points();
+  apply_merge_tree(build_merge_tree(volume, pairs, merge_tree_settings(mode)), mode);
+}
+
+// the ui keeps pointers to the members, the build is moved into them
+void WorkContext::apply_merge_tree(MergeTreeBuild&& build, int mode)
+{
+  merge_tree = std::move(build.tree);
+  augmented_merge_tree = std::move(build.augmented);
+  branch_decomposition = std::move(build.decomposition);
+  branch_segmentation = std::move(build.segmentation);
+  // branch ids of an active segmentation refer to the old tree
+  segmentation_changed = true;
+  ui.mark_merge_tree_dirty();
+  if (tf_source == 1) update_transfer_function(mode);
+}
+
+// mode 0 = scalar volume, 1 = gradient volume
+void WorkContext::update_transfer_function(int mode)
+{
+  const Volume& volume = mode == 0 ? *scalar_volume : gradient_volume;
+  const PersistenceDiagram& diagram = mode == 0 ? scalar_diagram() : gradient_diagram();
+  if (tf_source == 1 && !branch_decomposition.get_branches().empty())
+  {
+    transfer_function.update(branch_decomposition, branch_segmentation, volume, tf_data);
+  }
+  else if (!diagram.empty())
+  {
+    transfer_function.update(diagram, volume, tf_data);
+  }
+}
+
+void WorkContext::set_volume_loader(const ProgressiveVolumeLoader* loader, AppState& app_state)
+{
+  // without a loader the slices read so far are all that is drawn
+  if (!loader)
+  {
+    if (volume_loader)
+    {
+      vmc.logical_device.get().waitIdle();
+      upload_slices(volume_loader->loaded_slices());
+    }
+    volume_loader = nullptr;
+    app_state.loaded_slices = uploaded_slices;
+    return;
+  }
+  volume_loader = loader;
+  uploaded_slices = 0;
+  app_state.loaded_slices = 0;
+  app_state.load_progress = 0.0f;
+}
+
+void WorkContext::prepare_completion(const Volume& volume, VolumeCompletion& completion)
+{
+  // the stats of a loading volume are never read, the renderer only touches them after complete_volume
+  volume.stats.reset();
+  volume_stats(volume);
+  volume_stats(completion.gradient_volume);
+  completion.grads_by_scalar = collect_grads_by_scalar(volume, completion.gradient_volume);
+  completion.merge_tree = build_merge_tree(volume, completion.scalar_pairs->display_diagram().points(), completion.merge_tree_settings);
+}
+
+void WorkContext::complete_volume(AppState& app_state, VolumeCompletion&& completion)
+{
+  Timer<float> complete_timer;
+  const Volume& volume = *scalar_volume;
+  gradient_volume = std::move(completion.gradient_volume);
+  grads_by_scalar = std::move(completion.grads_by_scalar);
+  app_state.max_gradient = volume_stats(gradient_volume).max;
+  // the slices that arrived after the last frame and the gradient go up now, render stops uploading once
+  // the loader is gone
+  vmc.logical_device.get().waitIdle();
+  upload_slices(volume.resolution.z);
+  storage.get_buffer_by_name("gradient_volume").update_data_bytes(gradient_volume.data.data(), gradient_volume.data.size());
+  volume_loader = nullptr;
+  app_state.loaded_slices = ~0u;
+  app_state.load_progress = 1.0f;
+
+  ui.set_volume(scalar_volume);
+  set_persistence_diagram(std::move(completion.scalar_pairs), volume);
+  ui.set_persistence_diagram(&scalar_diagram());
+  set_gradient_persistence_diagram(std::move(completion.gradient_pairs));
+  // the merge tree options may have changed in the ui while the completion was prepared
+  if (completion.merge_tree_settings == merge_tree_settings(0)) apply_merge_tree(std::move(completion.merge_tree), 0);
+  else rebuild_merge_tree(0);
+  export_volume_data();
+  std::cout << CLR_GREEN << "[TIMING] complete volume: " << complete_timer.elapsed<ms>() << " ms" << CLR_RESET << std::endl;
+}
+
+// only whole slices below end are final
+void WorkContext::upload_slices(uint32_t end)
+{
+  end = std::min(end, scalar_volume->resolution.z);
+  if (end <= uploaded_slices) return;
+  const size_t slice = size_t(scalar_volume->resolution.x) * scalar_volume->resolution.y;
+  storage.get_buffer_by_name("volume").update_data_bytes(scalar_volume->data.data() + uploaded_slices * slice, (end - uploaded_slices) * slice, uploaded_slices * slice);
+  uploaded_slices = end;
+}
+
+void WorkContext::set_volume_series(VolumeSeries* series, AppState& app_state)
+{
+  volume_series = series;
+  app_state.series_steps = series ? int(series->size()) : 0;
+  app_state.series_step = 0;
+  series_pending = series ? 0 : -1;
+  series_clock.restart();
+}
+
+// a step that is still decoding is not waited for, the current one stays on screen until it is ready
+void WorkContext::advance_series(AppState& app_state)
+{
+  if (app_state.apply_series_step)
+  {
+    series_pending = app_state.series_step;
+    app_state.apply_series_step = false;
+  }
+  else if (app_state.series_playing && series_pending < 0 && series_clock.elapsed<ms>() >= 1000.0f / app_state.series_fps)
+  {
+    series_pending = (app_state.series_step + 1) % app_state.series_steps;
+  }
+  if (series_pending >= 0 && volume_series->failed(uint32_t(series_pending)))
+  {
+    // playback moves on to the next step that decodes and stops once none is left, while paused the
+    // current step stays on screen
+    int next = -1;
+    for (int k = 1; app_state.series_playing && next < 0 && k < app_state.series_steps; ++k)
+    {
+      const int t = (series_pending + k) % app_state.series_steps;
+      if (!volume_series->failed(uint32_t(t))) next = t;
+    }
+    if (next < 0)
+    {
+      app_state.series_playing = false;
+      if (series_current) app_state.series_step = int(series_current->index);
+    }
+    series_pending = next;
+  }
+  if (series_pending >= 0)
+  {
+    if (std::shared_ptr<const SeriesStep> step = volume_series->try_get(uint32_t(series_pending)))
+    {
+      series_current = std::move(step);
+      series_upload = true;
+      series_pending = -1;
+      app_state.series_step = int(series_current->index);
+      app_state.max_gradient = volume_stats(series_current->gradient).max;
+      series_clock.restart();
+    }
+  }
+  app_state.series_ready = int(volume_series->ready_count());
+}
+
+// false if there is nothing to restrict the rendering to, the ray marcher then shows the whole volume
+bool WorkContext::update_segment_mask(int branch)
+{
+  if (branch < 0 || branch_segmentation.empty() || size_t(branch) >= branch_segmentation.regions.size()) return false;
+  Timer<float> mask_timer;
+  const uint32_t selected = uint32_t(branch);
+  segment_mask = branch_mask(branch_segmentation, branch_decomposition, std::span<const uint32_t>(&selected, 1));
+  segment_mask_dirty = true;
+  std::cout << CLR_GREEN << "[TIMING] segment mask: " << mask_timer.elapsed<ms>() << " ms" << CLR_RESET << std::endl;
+  return true;
+}
+
+// every node stands for the value range between its own and its parent's value
+void WorkContext::highlight_merge_tree_level(int level, uint32_t min_persistence)
+{
+  std::vector<std::pair<PersistencePair, float>> hits;
+  for (uint32_t node : merge_tree.nodes_at_level(level, min_persistence))
+  {
+    const uint32_t a = merge_tree.birth(node), b = merge_tree.death(node);
+    hits.emplace_back(PersistencePair(std::min(a, b), std::max(a, b)), 1.0f);
+  }
+  volume_highlight_persistence_pairs(hits, ui.get_selected_ramp());
+}
+
 void WorkContext::reproject_and_compare()
 {
   // build two independent bin‐masks: